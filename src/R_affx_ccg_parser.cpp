@@ -0,0 +1,529 @@
+#include "GenericFileReader.h"
+#include "GenericData.h"
+#include "DataSet.h"
+#include "ParameterNameValueType.h"
+#include "R_affx_constants.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace affymetrix_calvin_io;
+using namespace affymetrix_calvin_parameter;
+
+#include <Rdefines.h>
+
+#define SET_NAMED_ELT(lst, index, val, nameLst, nameVal) \
+  SET_ELEMENT(lst, index, val); \
+  SET_STRING_ELT(nameLst, index, mkChar(nameVal))
+
+/*
+ * Strings are converted as by rawToString() of readCcg(), i.e. only
+ * the lower byte of each (Unicode) character is kept and NUL
+ * characters are dropped.
+ */
+static string
+R_affx_ccg_string(const wstring &wstr)
+{
+  string str;
+  str.reserve(wstr.size());
+  for (size_t i = 0; i < wstr.size(); i++) {
+    char c = (char) (wstr[i] & 0xFF);
+    if (c != '\0')
+      str += c;
+  }
+  return str;
+}
+
+static string
+R_affx_ccg_string(const unsigned char *raw, size_t n, size_t step)
+{
+  string str;
+  str.reserve(n / step);
+  for (size_t i = step - 1; i < n; i += step) {
+    if (raw[i] != '\0')
+      str += (char) raw[i];
+  }
+  return str;
+}
+
+/*
+ * Decodes the big endian values of a parameter.
+ */
+static SEXP
+R_affx_ccg_int_values(const unsigned char *raw, u_int32_t n, int size,
+                      bool isSigned)
+{
+  int count = n / size, i, k;
+  SEXP vals = NEW_INTEGER(count);
+  for (i = 0; i < count; i++, raw += size) {
+    u_int32_t x = 0;
+    for (k = 0; k < size; k++)
+      x = (x << 8) | raw[k];
+    if (size == 1)
+      INTEGER(vals)[i] = isSigned ? (int) (int8_t) x : (int) x;
+    else if (size == 2)
+      INTEGER(vals)[i] = isSigned ? (int) (int16_t) x : (int) x;
+    else
+      INTEGER(vals)[i] = (int) (int32_t) x;
+  }
+  return vals;
+}
+
+/*
+ * The value of a parameter, converted according to its MIME type as
+ * by readWVT() of readCcg(), with attribute 'mimeType'.
+ */
+static SEXP
+R_affx_ccg_parameter_value(const ParameterNameValueType &param)
+{
+  MIMEValue mimeValue = param.GetMIMEValue();
+  u_int32_t n = 0;
+  const unsigned char *raw = (const unsigned char *) mimeValue.GetValue(n);
+  string type = R_affx_ccg_string(param.GetMIMEType());
+  SEXP val;
+  int i;
+
+  if (type == "text/ascii") {
+    PROTECT(val = mkString(R_affx_ccg_string(raw, n, 1).c_str()));
+  } else if (type == "text/plain") {
+    PROTECT(val = mkString(R_affx_ccg_string(raw, n, 2).c_str()));
+  } else if (type == "text/x-calvin-integer-8") {
+    PROTECT(val = R_affx_ccg_int_values(raw, n, 1, true));
+  } else if (type == "text/x-calvin-unsigned-integer-8") {
+    PROTECT(val = R_affx_ccg_int_values(raw, n, 1, false));
+  } else if (type == "text/x-calvin-integer-16") {
+    PROTECT(val = R_affx_ccg_int_values(raw, n, 2, true));
+  } else if (type == "text/x-calvin-unsigned-integer-16") {
+    PROTECT(val = R_affx_ccg_int_values(raw, n, 2, false));
+  } else if (type == "text/x-calvin-integer-32" ||
+             type == "text/x-calvin-unsigned-integer-32") {
+    /* As readCcg(), unsigned 4-byte integers are read as signed. */
+    PROTECT(val = R_affx_ccg_int_values(raw, n, 4, true));
+  } else if (type == "text/x-calvin-float") {
+    PROTECT(val = NEW_NUMERIC(n / 4));
+    for (i = 0; i < (int) (n / 4); i++) {
+      u_int32_t x = ((u_int32_t) raw[4*i] << 24) | ((u_int32_t) raw[4*i+1] << 16) |
+        ((u_int32_t) raw[4*i+2] << 8) | (u_int32_t) raw[4*i+3];
+      float f;
+      memcpy(&f, &x, sizeof(f));
+      REAL(val)[i] = f;
+    }
+  } else {
+    PROTECT(val = NEW_RAW(n));
+    if (n > 0)
+      memcpy(RAW(val), raw, n);
+  }
+  setAttrib(val, install("mimeType"), mkString(type.c_str()));
+  UNPROTECT(1);
+  return val;
+}
+
+template<typename Iterator> static SEXP
+R_affx_ccg_parameters(Iterator begin, Iterator end)
+{
+  SEXP params, nms;
+  int n = (int) (end - begin), i;
+
+  PROTECT(params = NEW_LIST(n));
+  PROTECT(nms = NEW_CHARACTER(n));
+  for (i = 0; begin != end; ++begin, i++) {
+    SET_NAMED_ELT(params, i, R_affx_ccg_parameter_value(*begin), nms,
+                  R_affx_ccg_string(begin->GetName()).c_str());
+  }
+  SET_NAMES(params, nms);
+  UNPROTECT(2);
+  return params;
+}
+
+/*
+ * File positions are reported as stored in the file, i.e. as by
+ * readCcg() that reads the unsigned 4-byte integers as signed.
+ */
+static SEXP
+R_affx_ccg_file_pos(u_int64_t pos)
+{
+  return ScalarInteger((int) (int32_t) (u_int32_t) pos);
+}
+
+static SEXP
+R_affx_ccg_data_header(GenericDataHeader &hdr)
+{
+  SEXP lst, nms, parents;
+  ParameterNameValueTypeIt begin, end;
+  int nparents = hdr.GetParentCnt(), i;
+
+  PROTECT(lst = NEW_LIST(6));
+  PROTECT(nms = NEW_CHARACTER(6));
+  SET_NAMED_ELT(lst, 0, mkString(hdr.GetFileTypeId().c_str()), nms, "dataTypeId");
+  SET_NAMED_ELT(lst, 1, mkString(hdr.GetFileId().c_str()), nms, "fileId");
+  SET_NAMED_ELT(lst, 2, mkString(R_affx_ccg_string(hdr.GetFileCreationTime()).c_str()),
+                nms, "timestamp");
+  SET_NAMED_ELT(lst, 3, mkString(R_affx_ccg_string(hdr.GetLocale()).c_str()),
+                nms, "locale");
+  hdr.GetNameValIterators(begin, end);
+  SET_NAMED_ELT(lst, 4, R_affx_ccg_parameters(begin, end), nms, "parameters");
+
+  PROTECT(parents = NEW_LIST(nparents));
+  for (i = 0; i < nparents; i++) {
+    GenericDataHeader parent = hdr.GetParent(i);
+    SET_VECTOR_ELT(parents, i, R_affx_ccg_data_header(parent));
+  }
+  SET_NAMED_ELT(lst, 5, parents, nms, "parents");
+  SET_NAMES(lst, nms);
+  UNPROTECT(3);
+  return lst;
+}
+
+template<typename T> static int32_t
+R_affx_ccg_int_column(DataSet *ds, int col, int nrows, int *values)
+{
+  vector<T> buffer(nrows);
+  int32_t n = ds->GetDataRaw(col, 0, nrows, &buffer[0]);
+  for (int32_t i = 0; i < n; i++)
+    values[i] = (int) buffer[i];
+  return n;
+}
+
+/*
+ * Reads all columns of a data set in bulk into a data frame.  Unread
+ * values are NA.  On failure, 'msg' is set and the columns read so far
+ * are returned.
+ */
+static SEXP
+R_affx_ccg_table(DataSet *ds, const DataSetHeader &dsh, string &msg)
+{
+  SEXP table, nms, vals, rownames;
+  int nrows = dsh.GetRowCnt(), ncols = dsh.GetColumnCnt(), col, i, n;
+
+  PROTECT(table = NEW_LIST(ncols));
+  PROTECT(nms = NEW_CHARACTER(ncols));
+  for (col = 0; col < ncols; col++) {
+    ColumnInfo info = dsh.GetColumnInfo(col);
+    DataSetColumnTypes type = info.GetColumnType();
+    SET_STRING_ELT(nms, col, mkChar(R_affx_ccg_string(info.GetName()).c_str()));
+    n = 0;
+    if (type == FloatColType) {
+      PROTECT(vals = NEW_NUMERIC(nrows));
+    } else if (type == ASCIICharColType || type == UnicodeCharColType) {
+      PROTECT(vals = NEW_CHARACTER(nrows));
+    } else {
+      PROTECT(vals = NEW_INTEGER(nrows));
+    }
+    try {
+      if (nrows > 0) {
+        switch (type) {
+        case ByteColType:
+          n = R_affx_ccg_int_column<int8_t>(ds, col, nrows, INTEGER(vals));
+          break;
+        case UByteColType:
+          n = R_affx_ccg_int_column<u_int8_t>(ds, col, nrows, INTEGER(vals));
+          break;
+        case ShortColType:
+          n = R_affx_ccg_int_column<int16_t>(ds, col, nrows, INTEGER(vals));
+          break;
+        case UShortColType:
+          n = R_affx_ccg_int_column<u_int16_t>(ds, col, nrows, INTEGER(vals));
+          break;
+        case IntColType:
+          n = ds->GetDataRaw(col, 0, nrows, (int32_t *) INTEGER(vals));
+          break;
+        case UIntColType:
+          /* As readCcg(), unsigned 4-byte integers are read as signed. */
+          n = ds->GetDataRaw(col, 0, nrows, (u_int32_t *) INTEGER(vals));
+          break;
+        case FloatColType:
+          {
+            vector<float> buffer(nrows);
+            n = ds->GetDataRaw(col, 0, nrows, &buffer[0]);
+            for (i = 0; i < n; i++)
+              REAL(vals)[i] = buffer[i];
+          }
+          break;
+        case ASCIICharColType:
+          {
+            vector<string> buffer(nrows);
+            n = ds->GetDataRaw(col, 0, nrows, &buffer[0]);
+            for (i = 0; i < n; i++)
+              SET_STRING_ELT(vals, i, mkChar(R_affx_ccg_string(
+                (const unsigned char *) buffer[i].data(), buffer[i].size(), 1).c_str()));
+          }
+          break;
+        case UnicodeCharColType:
+          {
+            vector<wstring> buffer(nrows);
+            n = ds->GetDataRaw(col, 0, nrows, &buffer[0]);
+            for (i = 0; i < n; i++)
+              SET_STRING_ELT(vals, i, mkChar(R_affx_ccg_string(buffer[i]).c_str()));
+          }
+          break;
+        }
+      }
+    } catch (...) {
+      msg = "could not read column '" + R_affx_ccg_string(info.GetName()) +
+        "' of data set '" + R_affx_ccg_string(dsh.GetName()) + "'";
+    }
+    if (type == FloatColType) {
+      for (i = n; i < nrows; i++)
+        REAL(vals)[i] = NA_REAL;
+    } else if (type == ASCIICharColType || type == UnicodeCharColType) {
+      for (i = n; i < nrows; i++)
+        SET_STRING_ELT(vals, i, NA_STRING);
+    } else {
+      for (i = n; i < nrows; i++)
+        INTEGER(vals)[i] = NA_INTEGER;
+    }
+    SET_VECTOR_ELT(table, col, vals);
+    UNPROTECT(1);
+    if (msg.size() > 0)
+      break;
+  }
+  SET_NAMES(table, nms);
+
+  PROTECT(rownames = NEW_INTEGER(2));
+  INTEGER(rownames)[0] = NA_INTEGER;
+  INTEGER(rownames)[1] = -nrows;
+  setAttrib(table, R_RowNamesSymbol, rownames);
+  setAttrib(table, R_ClassSymbol, mkString("data.frame"));
+  UNPROTECT(3);
+  return table;
+}
+
+static SEXP
+R_affx_ccg_data_set(GenericData &data, int group, int set,
+                    const DataSetHeader &dsh, string &msg)
+{
+  SEXP lst, nms, table = R_NilValue;
+  ParameterNameValueTypeConstIt begin, end;
+  DataSet *ds = NULL;
+
+  PROTECT(lst = NEW_LIST(5));
+  PROTECT(nms = NEW_CHARACTER(5));
+  SET_NAMED_ELT(lst, 0, R_affx_ccg_file_pos(dsh.GetDataStartFilePos()), nms,
+                "elementsStart");
+  SET_NAMED_ELT(lst, 1, R_affx_ccg_file_pos(dsh.GetNextSetFilePos()), nms,
+                "nextDataSetStart");
+  SET_NAMED_ELT(lst, 2, mkString(R_affx_ccg_string(dsh.GetName()).c_str()),
+                nms, "name");
+  dsh.GetNameValIterators(begin, end);
+  SET_NAMED_ELT(lst, 3, R_affx_ccg_parameters(begin, end), nms, "parameters");
+
+  try {
+    ds = data.DataSet(group, set);
+    if (ds->Open() == false) {
+      ds->Delete();
+      ds = NULL;
+    }
+  } catch (...) {
+    ds = NULL;
+  }
+  if (ds == NULL) {
+    msg = "could not open data set '" + R_affx_ccg_string(dsh.GetName()) + "'";
+  } else {
+    table = R_affx_ccg_table(ds, dsh, msg);
+    ds->Delete();
+  }
+  SET_NAMED_ELT(lst, 4, table, nms, "table");
+  SET_NAMES(lst, nms);
+  UNPROTECT(2);
+  return lst;
+}
+
+/*
+ * Gets the filter of the data sets of a data group.  The filter is a
+ * list with one element per data group to be read, named by the data
+ * group.  An element is either NULL, for all data sets, or the names
+ * of the data sets to be read.  If there is no filter, all data groups
+ * are read.
+ */
+static bool
+R_affx_ccg_filter_group(SEXP filter, const string &name, SEXP *sets)
+{
+  *sets = R_NilValue;
+  if (isNull(filter))
+    return true;
+  SEXP nms = GET_NAMES(filter);
+  for (int i = 0; i < length(filter) && !isNull(nms); i++) {
+    if (name == CHAR(STRING_ELT(nms, i))) {
+      *sets = VECTOR_ELT(filter, i);
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+R_affx_ccg_filter_set(SEXP sets, const string &name)
+{
+  if (isNull(sets))
+    return true;
+  for (int i = 0; i < length(sets); i++) {
+    if (STRING_ELT(sets, i) != NA_STRING && name == CHAR(STRING_ELT(sets, i)))
+      return true;
+  }
+  return false;
+}
+
+static SEXP
+R_affx_ccg_data_groups(GenericData &data, SEXP filter, string &msg)
+{
+  SEXP groups, gnms, group, hdr, hnms, sets, snms, setFilter;
+  FileHeader &fh = data.Header();
+  int ngroups = fh.GetDataGroupCnt(), nread = 0, g, s, k;
+  vector<int> read;
+
+  for (g = 0; g < ngroups; g++) {
+    string name = R_affx_ccg_string(fh.GetDataGroup(g).GetName());
+    if (R_affx_ccg_filter_group(filter, name, &setFilter))
+      read.push_back(g);
+  }
+  nread = (int) read.size();
+
+  PROTECT(groups = NEW_LIST(nread));
+  PROTECT(gnms = NEW_CHARACTER(nread));
+  for (k = 0; k < nread && msg.size() == 0; k++) {
+    g = read[k];
+    DataGroupHeader &dgh = fh.GetDataGroup(g);
+    string name = R_affx_ccg_string(dgh.GetName());
+    int nsets = dgh.GetDataSetCnt(), nsetsRead = 0;
+    R_affx_ccg_filter_group(filter, name, &setFilter);
+
+    PROTECT(hdr = NEW_LIST(4));
+    PROTECT(hnms = NEW_CHARACTER(4));
+    SET_NAMED_ELT(hdr, 0, R_affx_ccg_file_pos(dgh.GetNextGroupPos()), hnms,
+                  "nextGroupStart");
+    SET_NAMED_ELT(hdr, 1, R_affx_ccg_file_pos(dgh.GetDataSetPos()), hnms,
+                  "dataSetStart");
+    SET_NAMED_ELT(hdr, 2, ScalarInteger(nsets), hnms, "nbrOfDataSets");
+    SET_NAMED_ELT(hdr, 3, mkString(name.c_str()), hnms, "name");
+    SET_NAMES(hdr, hnms);
+
+    for (s = 0; s < nsets; s++) {
+      if (R_affx_ccg_filter_set(setFilter, R_affx_ccg_string(dgh.GetDataSet(s).GetName())))
+        nsetsRead++;
+    }
+    PROTECT(sets = NEW_LIST(nsetsRead));
+    PROTECT(snms = NEW_CHARACTER(nsetsRead));
+    for (s = 0, nsetsRead = 0; s < nsets && msg.size() == 0; s++) {
+      const DataSetHeader &dsh = dgh.GetDataSet(s);
+      string setName = R_affx_ccg_string(dsh.GetName());
+      if (!R_affx_ccg_filter_set(setFilter, setName))
+        continue;
+      SET_NAMED_ELT(sets, nsetsRead, R_affx_ccg_data_set(data, g, s, dsh, msg),
+                    snms, setName.c_str());
+      nsetsRead++;
+    }
+    SET_NAMES(sets, snms);
+
+    PROTECT(group = NEW_LIST(2));
+    SET_VECTOR_ELT(group, 0, hdr);
+    SET_VECTOR_ELT(group, 1, sets);
+    PROTECT(hnms = NEW_CHARACTER(2));
+    SET_STRING_ELT(hnms, 0, mkChar("header"));
+    SET_STRING_ELT(hnms, 1, mkChar("dataSets"));
+    SET_NAMES(group, hnms);
+    SET_NAMED_ELT(groups, k, group, gnms, name.c_str());
+    UNPROTECT(6);
+  }
+  if (nread > 0)
+    SET_NAMES(groups, gnms);
+  UNPROTECT(2);
+  return groups;
+}
+
+/*
+ * Reads a Command Console generic (Calvin) file into the structure
+ * returned by readCcg().  Any error message is returned in 'msg'.
+ */
+static SEXP
+R_affx_ccg_file(const char *fileName, bool readFileHeader,
+                bool readDataHeader, bool readDataGroups, SEXP filter,
+                string &msg)
+{
+  SEXP ccg, nms, fhdr;
+  GenericData data;
+  GenericFileReader reader;
+
+  try {
+    reader.SetFilename(fileName);
+    reader.ReadHeader(data);
+  } catch (...) {
+    msg = string("could not read the header of CCG file: ") + fileName;
+    return R_NilValue;
+  }
+  FileHeader &fh = data.Header();
+
+  PROTECT(ccg = NEW_LIST(3));
+  PROTECT(nms = NEW_CHARACTER(3));
+  SET_STRING_ELT(nms, 0, mkChar("fileHeader"));
+  SET_STRING_ELT(nms, 1, mkChar("genericDataHeader"));
+  SET_STRING_ELT(nms, 2, mkChar("dataGroups"));
+  SET_NAMES(ccg, nms);
+
+  if (readFileHeader) {
+    PROTECT(fhdr = NEW_LIST(3));
+    PROTECT(nms = NEW_CHARACTER(3));
+    SET_NAMED_ELT(fhdr, 0, ScalarInteger(fh.GetVersion()), nms, "version");
+    SET_NAMED_ELT(fhdr, 1, ScalarInteger(fh.GetNumDataGroups()), nms,
+                  "nbrOfDataGroups");
+    SET_NAMED_ELT(fhdr, 2, R_affx_ccg_file_pos(fh.GetFirstDataGroupFilePos()),
+                  nms, "dataGroupStart");
+    SET_NAMES(fhdr, nms);
+    SET_VECTOR_ELT(ccg, 0, fhdr);
+    UNPROTECT(2);
+  }
+
+  if (readDataHeader)
+    SET_VECTOR_ELT(ccg, 1, R_affx_ccg_data_header(*fh.GetGenericDataHdr()));
+
+  if (readDataGroups)
+    SET_VECTOR_ELT(ccg, 2, R_affx_ccg_data_groups(data, filter, msg));
+
+  UNPROTECT(2);
+  return ccg;
+}
+
+extern "C" {
+
+  /*
+   * Reads a Command Console generic (Calvin) file.  The data sets are
+   * read column by column in bulk.  Elements that are not read are NULL.
+   */
+  SEXP R_affx_get_ccg_file(SEXP fname, SEXP readFileHeader,
+                           SEXP readDataHeader, SEXP readDataGroups,
+                           SEXP dataFilter, SEXP verbose)
+  {
+    SEXP ccg;
+    char msg[1024];
+    int i_verboseFlag = asInteger(verbose);
+
+    if (!isString(fname) || length(fname) != 1)
+      error("Argument 'fname' must be a single file name.");
+    if (!isNull(dataFilter) && !isNewList(dataFilter))
+      error("Argument 'dataFilter' must be NULL or a list.");
+
+    const char *fileName = CHAR(STRING_ELT(fname, 0));
+    if (i_verboseFlag >= R_AFFX_VERBOSE) {
+      Rprintf("Reading CCG file: %s\n", fileName);
+    }
+
+    {
+      string reason;
+      ccg = R_affx_ccg_file(fileName,
+                            asLogical(readFileHeader) == TRUE,
+                            asLogical(readDataHeader) == TRUE,
+                            asLogical(readDataGroups) == TRUE,
+                            dataFilter, reason);
+      snprintf(msg, sizeof(msg), "%s", reason.c_str());
+    }
+    if (msg[0] != '\0')
+      error("%s", msg);
+
+    if (i_verboseFlag >= R_AFFX_VERBOSE) {
+      Rprintf("Finished reading CCG file.\n");
+    }
+    return ccg;
+  }
+
+}
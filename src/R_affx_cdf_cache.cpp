@@ -0,0 +1,324 @@
+#include "R_affx_cdf_cache.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace affymetrix_fusion_io;
+using namespace affymetrix_calvin_utilities;
+
+/* Identifies a cell index cache file and its format version. */
+static const char R_AFFX_CDF_CACHE_MAGIC[8] = { 'A','F','F','X','C','C','I','\0' };
+#define R_AFFX_CDF_CACHE_VERSION 1
+#define R_AFFX_CDF_CACHE_BYTE_ORDER 0x01020304
+
+/* The header of a cache file.  It is followed by the arrays
+   unitGroupStart[nbrOfUnits+1], groupCellStart[nbrOfGroups+1],
+   cellIndices[nbrOfCells], unitNameStart[nbrOfUnits+1],
+   groupNameStart[nbrOfGroups+1] and names[nbrOfNameBytes], each
+   padded to a multiple of eight bytes. */
+struct RAffxCdfCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t cdfSize;
+  int64_t cdfMtime;
+  uint64_t cdfChecksum;
+  int32_t nbrOfUnits;
+  int32_t nbrOfGroups;
+  int32_t nbrOfCells;
+  int32_t nbrOfNameBytes;
+};
+
+static size_t R_affx_cdf_cache_padded(size_t nbrOfBytes)
+{
+  return (nbrOfBytes + 7) & ~((size_t) 7);
+}
+
+/* Fills in the key fields of a header from the CDF file. */
+static bool R_affx_cdf_cache_key(const char *cdfFileName, RAffxCdfCacheHeader &header)
+{
+  RAffxCacheKey key;
+  if (!FileUtils::GetFileKey(cdfFileName, key))
+    return false;
+  header.cdfSize = key.size;
+  header.cdfMtime = key.mtime;
+  header.cdfChecksum = key.checksum;
+  return true;
+}
+
+/* The size of a cache file with the given header. */
+static size_t R_affx_cdf_cache_size(const RAffxCdfCacheHeader &header)
+{
+  size_t nu = (size_t) header.nbrOfUnits + 1;
+  size_t ng = (size_t) header.nbrOfGroups + 1;
+  return R_affx_cdf_cache_padded(sizeof(RAffxCdfCacheHeader)) +
+    2*R_affx_cdf_cache_padded(nu*sizeof(int32_t)) +
+    2*R_affx_cdf_cache_padded(ng*sizeof(int32_t)) +
+    R_affx_cdf_cache_padded((size_t) header.nbrOfCells*sizeof(int32_t)) +
+    R_affx_cdf_cache_padded((size_t) header.nbrOfNameBytes);
+}
+
+
+RAffxCdfCellIndexCache::RAffxCdfCellIndexCache() :
+  m_NumUnits(0), m_NumGroups(0), m_NumCells(0), m_NumNameBytes(0),
+  m_UnitGroupStart(NULL), m_GroupCellStart(NULL), m_CellIndices(NULL),
+  m_UnitNameStart(NULL), m_GroupNameStart(NULL), m_Names(NULL),
+  m_Map(NULL), m_MapLen(0)
+{
+}
+
+RAffxCdfCellIndexCache::~RAffxCdfCellIndexCache()
+{
+  Clear();
+}
+
+string RAffxCdfCellIndexCache::GetCacheFileName(const char *cdfFileName)
+{
+  return string(cdfFileName) + ".cellidx";
+}
+
+void RAffxCdfCellIndexCache::Clear()
+{
+  if (m_Map != NULL) {
+#ifdef _MSC_VER
+    delete[] (char *) m_Map;
+#else
+    munmap(m_Map, m_MapLen);
+#endif
+    m_Map = NULL;
+    m_MapLen = 0;
+  }
+  m_Offsets.clear();
+  m_NameData.clear();
+  m_NumUnits = m_NumGroups = m_NumCells = m_NumNameBytes = 0;
+  m_UnitGroupStart = m_GroupCellStart = m_CellIndices = NULL;
+  m_UnitNameStart = m_GroupNameStart = NULL;
+  m_Names = NULL;
+}
+
+bool RAffxCdfCellIndexCache::Map(const char *cacheFileName, const char *cdfFileName)
+{
+  Clear();
+
+  RAffxCdfCacheHeader key;
+  if (!R_affx_cdf_cache_key(cdfFileName, key))
+    return false;
+
+  struct stat st;
+  if (stat(cacheFileName, &st) != 0 || (size_t) st.st_size < sizeof(RAffxCdfCacheHeader))
+    return false;
+  size_t len = (size_t) st.st_size;
+  if ((uint64_t) len != (uint64_t) st.st_size)
+    return false;
+
+#ifdef _MSC_VER
+  /* Read the whole file on Windows. */
+  FILE *fp = fopen(cacheFileName, "rb");
+  if (fp == NULL)
+    return false;
+  char *buffer = new char[len];
+  size_t n = fread(buffer, 1, len, fp);
+  fclose(fp);
+  if (n != len) {
+    delete[] buffer;
+    return false;
+  }
+  void *map = buffer;
+#else
+  int fd = open(cacheFileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+  void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+#endif
+  m_Map = map;
+  m_MapLen = len;
+
+  /* Validate the header against the CDF file. */
+  const RAffxCdfCacheHeader *header = (const RAffxCdfCacheHeader *) m_Map;
+  if (memcmp(header->magic, R_AFFX_CDF_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != R_AFFX_CDF_CACHE_VERSION ||
+      header->byteOrder != R_AFFX_CDF_CACHE_BYTE_ORDER ||
+      header->cdfSize != key.cdfSize ||
+      header->cdfMtime != key.cdfMtime ||
+      header->cdfChecksum != key.cdfChecksum ||
+      header->nbrOfUnits < 0 || header->nbrOfGroups < 0 ||
+      header->nbrOfCells < 0 || header->nbrOfNameBytes < 0 ||
+      R_affx_cdf_cache_size(*header) != len) {
+    Clear();
+    return false;
+  }
+
+  m_NumUnits = header->nbrOfUnits;
+  m_NumGroups = header->nbrOfGroups;
+  m_NumCells = header->nbrOfCells;
+  m_NumNameBytes = header->nbrOfNameBytes;
+
+  const char *p = (const char *) m_Map + R_affx_cdf_cache_padded(sizeof(RAffxCdfCacheHeader));
+  m_UnitGroupStart = (const int32_t *) p;
+  p += R_affx_cdf_cache_padded((m_NumUnits + 1)*sizeof(int32_t));
+  m_GroupCellStart = (const int32_t *) p;
+  p += R_affx_cdf_cache_padded((m_NumGroups + 1)*sizeof(int32_t));
+  m_CellIndices = (const int32_t *) p;
+  p += R_affx_cdf_cache_padded((size_t) m_NumCells*sizeof(int32_t));
+  m_UnitNameStart = (const int32_t *) p;
+  p += R_affx_cdf_cache_padded((m_NumUnits + 1)*sizeof(int32_t));
+  m_GroupNameStart = (const int32_t *) p;
+  p += R_affx_cdf_cache_padded((m_NumGroups + 1)*sizeof(int32_t));
+  m_Names = p;
+
+  /* The offsets must be increasing and within the data, so that the
+     table can be used without further checks. */
+  bool ok = (m_UnitGroupStart[0] == 0 && m_GroupCellStart[0] == 0 &&
+             m_UnitNameStart[0] == 0);
+  for (int uu = 0; uu < m_NumUnits && ok; uu++) {
+    ok = (m_UnitGroupStart[uu] <= m_UnitGroupStart[uu + 1] &&
+          m_UnitNameStart[uu] <= m_UnitNameStart[uu + 1]);
+  }
+  ok = ok && (m_UnitGroupStart[m_NumUnits] == m_NumGroups &&
+              m_UnitNameStart[m_NumUnits] == m_GroupNameStart[0]);
+  for (int gg = 0; gg < m_NumGroups && ok; gg++) {
+    ok = (m_GroupCellStart[gg] <= m_GroupCellStart[gg + 1] &&
+          m_GroupNameStart[gg] <= m_GroupNameStart[gg + 1]);
+  }
+  ok = ok && (m_GroupCellStart[m_NumGroups] == m_NumCells &&
+              m_GroupNameStart[m_NumGroups] == m_NumNameBytes);
+  if (!ok) {
+    Clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool RAffxCdfCellIndexCache::Build(FusionCDFData &cdf)
+{
+  Clear();
+
+  FusionCDFFileHeader cdfHeader = cdf.GetHeader();
+  int nbrOfUnits = cdfHeader.GetNumProbeSets();
+  int ncol = cdfHeader.GetCols();
+  if (nbrOfUnits < 0)
+    return false;
+
+  /* The table is built with 64-bit counts to detect overflow. */
+  vector<int32_t> unitGroupStart(nbrOfUnits + 1);
+  vector<int32_t> unitNameStart(nbrOfUnits + 1);
+  vector<int32_t> groupCellStart(1, 0);
+  vector<int32_t> groupNameStart(1, 0);
+  vector<int32_t> cellIndices;
+  vector<char> unitNames, groupNames;
+  int64_t nbrOfGroups = 0, nbrOfCells = 0;
+
+  FusionCDFProbeSetInformation probeset;
+  FusionCDFProbeGroupInformation group;
+  FusionCDFProbeInformation probe;
+  string name;
+  for (int uu = 0; uu < nbrOfUnits; uu++) {
+    cdf.GetProbeSetInformation(uu, probeset);
+
+    name = cdf.GetProbeSetName(uu);
+    unitGroupStart[uu] = (int32_t) nbrOfGroups;
+    unitNameStart[uu] = (int32_t) unitNames.size();
+    unitNames.insert(unitNames.end(), name.begin(), name.end());
+
+    int ngroups = probeset.GetNumGroups();
+    for (int gg = 0; gg < ngroups; gg++) {
+      probeset.GetGroupInformation(gg, group);
+      int ncells = group.GetNumCells();
+      for (int cc = 0; cc < ncells; cc++) {
+        group.GetCell(cc, probe);
+        /* Cell indices are one-based in R. */
+        cellIndices.push_back(probe.GetY()*ncol + probe.GetX() + 1);
+      }
+      name = group.GetName();
+      groupNames.insert(groupNames.end(), name.begin(), name.end());
+      nbrOfCells += ncells;
+      nbrOfGroups++;
+      if (nbrOfCells > INT_MAX || nbrOfGroups >= INT_MAX ||
+          unitNames.size() + groupNames.size() > (size_t) INT_MAX)
+        return false;
+      groupCellStart.push_back((int32_t) nbrOfCells);
+      groupNameStart.push_back((int32_t) groupNames.size());
+    }
+  }
+  unitGroupStart[nbrOfUnits] = (int32_t) nbrOfGroups;
+  unitNameStart[nbrOfUnits] = (int32_t) unitNames.size();
+
+  /* The group names follow the unit names. */
+  for (size_t gg = 0; gg < groupNameStart.size(); gg++)
+    groupNameStart[gg] += (int32_t) unitNames.size();
+  unitNames.insert(unitNames.end(), groupNames.begin(), groupNames.end());
+
+  /* Keep all offset arrays in one block. */
+  m_NumUnits = nbrOfUnits;
+  m_NumGroups = (int) nbrOfGroups;
+  m_NumCells = (int) nbrOfCells;
+  m_NumNameBytes = (int) unitNames.size();
+  m_Offsets.reserve(2*(unitGroupStart.size() + groupCellStart.size()) + cellIndices.size());
+  m_Offsets.insert(m_Offsets.end(), unitGroupStart.begin(), unitGroupStart.end());
+  m_Offsets.insert(m_Offsets.end(), groupCellStart.begin(), groupCellStart.end());
+  m_Offsets.insert(m_Offsets.end(), cellIndices.begin(), cellIndices.end());
+  m_Offsets.insert(m_Offsets.end(), unitNameStart.begin(), unitNameStart.end());
+  m_Offsets.insert(m_Offsets.end(), groupNameStart.begin(), groupNameStart.end());
+  m_NameData.swap(unitNames);
+
+  m_UnitGroupStart = &m_Offsets[0];
+  m_GroupCellStart = m_UnitGroupStart + (m_NumUnits + 1);
+  m_CellIndices = m_GroupCellStart + (m_NumGroups + 1);
+  m_UnitNameStart = m_CellIndices + m_NumCells;
+  m_GroupNameStart = m_UnitNameStart + (m_NumUnits + 1);
+  m_Names = m_NameData.empty() ? "" : &m_NameData[0];
+
+  return true;
+}
+
+bool RAffxCdfCellIndexCache::Write(const char *cacheFileName, const char *cdfFileName) const
+{
+  if (m_UnitGroupStart == NULL)
+    return false;
+
+  RAffxCdfCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, R_AFFX_CDF_CACHE_MAGIC, sizeof(header.magic));
+  header.version = R_AFFX_CDF_CACHE_VERSION;
+  header.byteOrder = R_AFFX_CDF_CACHE_BYTE_ORDER;
+  if (!R_affx_cdf_cache_key(cdfFileName, header))
+    return false;
+  header.nbrOfUnits = m_NumUnits;
+  header.nbrOfGroups = m_NumGroups;
+  header.nbrOfCells = m_NumCells;
+  header.nbrOfNameBytes = m_NumNameBytes;
+
+  string tmpFileName;
+  FILE *fp = FileUtils::OpenTempFile(cacheFileName, tmpFileName);
+  if (fp == NULL)
+    return false;
+
+  static const char padding[8] = { 0 };
+  const void *sections[7] = { &header, m_UnitGroupStart, m_GroupCellStart,
+    m_CellIndices, m_UnitNameStart, m_GroupNameStart, m_Names };
+  size_t sizes[7] = { sizeof(header),
+    (m_NumUnits + 1)*sizeof(int32_t), (m_NumGroups + 1)*sizeof(int32_t),
+    (size_t) m_NumCells*sizeof(int32_t), (m_NumUnits + 1)*sizeof(int32_t),
+    (m_NumGroups + 1)*sizeof(int32_t), (size_t) m_NumNameBytes };
+  bool ok = true;
+  for (int kk = 0; kk < 7 && ok; kk++) {
+    size_t pad = R_affx_cdf_cache_padded(sizes[kk]) - sizes[kk];
+    ok = (fwrite(sections[kk], 1, sizes[kk], fp) == sizes[kk]) &&
+         (fwrite(padding, 1, pad, fp) == pad);
+  }
+  return FileUtils::CommitTempFile(fp, ok, tmpFileName, cacheFileName);
+}
@@ -0,0 +1,106 @@
+#ifndef R_AFFX_CDF_CACHE_H
+#define R_AFFX_CDF_CACHE_H
+
+#include "FusionCDFData.h"
+#include "FileUtils.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The key of the file a cache file was created from, which the
+ * cache files of this package hold.  See FileUtils::GetFileKey().
+ */
+typedef affymetrix_calvin_utilities::FileKey RAffxCacheKey;
+
+/**
+ * @brief The one-based cell indices of all units in a CDF file, stored
+ * as flat (CSR) arrays: unit -> groups -> cells.
+ *
+ * The table can be written to a cache file next to the CDF file and
+ * later be memory mapped from it, which avoids parsing the CDF again.
+ * A cache file is only used if the size, the modification time and a
+ * checksum of the header of the CDF file are the same as when the cache
+ * was written.  Cache files use the native byte order of the machine.
+ */
+class RAffxCdfCellIndexCache {
+
+  public:
+    RAffxCdfCellIndexCache();
+    ~RAffxCdfCellIndexCache();
+
+    /**
+     * Gets the name of the cache file of a CDF file.
+     */
+    static std::string GetCacheFileName(const char *cdfFileName);
+
+    /**
+     * Maps a cache file, after validating it against its CDF file.
+     * @return True if the cache file exists and is up to date.
+     */
+    bool Map(const char *cacheFileName, const char *cdfFileName);
+
+    /**
+     * Builds the table from all units of a CDF file that was read.
+     * @return False if the CDF file is too large for the table.
+     */
+    bool Build(affymetrix_fusion_io::FusionCDFData &cdf);
+
+    /**
+     * Writes the table built for a CDF file to a cache file.  The file is
+     * written under a temporary name and then renamed.
+     * @return True if successful.
+     */
+    bool Write(const char *cacheFileName, const char *cdfFileName) const;
+
+    /** Unmaps the cache file and clears the table. */
+    void Clear();
+
+    int GetNumUnits() const { return m_NumUnits; }
+    int GetNumGroups() const { return m_NumGroups; }
+    int GetNumCells() const { return m_NumCells; }
+
+    /** The groups of unit u are [UnitGroupStart(u), UnitGroupStart(u+1)). */
+    const int32_t *UnitGroupStart() const { return m_UnitGroupStart; }
+
+    /** The cells of group g are [GroupCellStart(g), GroupCellStart(g+1)). */
+    const int32_t *GroupCellStart() const { return m_GroupCellStart; }
+
+    /** The one-based cell indices of all groups. */
+    const int32_t *CellIndices() const { return m_CellIndices; }
+
+    /** The name of unit u is [UnitNameStart(u), UnitNameStart(u+1)) in Names(). */
+    const int32_t *UnitNameStart() const { return m_UnitNameStart; }
+
+    /** The name of group g is [GroupNameStart(g), GroupNameStart(g+1)) in Names(). */
+    const int32_t *GroupNameStart() const { return m_GroupNameStart; }
+
+    /** The characters of all unit and group names. */
+    const char *Names() const { return m_Names; }
+
+  private:
+    int m_NumUnits;
+    int m_NumGroups;
+    int m_NumCells;
+    int m_NumNameBytes;
+
+    const int32_t *m_UnitGroupStart;
+    const int32_t *m_GroupCellStart;
+    const int32_t *m_CellIndices;
+    const int32_t *m_UnitNameStart;
+    const int32_t *m_GroupNameStart;
+    const char *m_Names;
+
+    /* The storage of a table that was built, which the pointers refer to. */
+    std::vector<int32_t> m_Offsets;
+    std::vector<char> m_NameData;
+
+    /* The mapped (or, on Windows, read) cache file. */
+    void *m_Map;
+    size_t m_MapLen;
+
+    RAffxCdfCellIndexCache(const RAffxCdfCellIndexCache &);
+    RAffxCdfCellIndexCache &operator=(const RAffxCdfCellIndexCache &);
+};
+
+#endif /* R_AFFX_CDF_CACHE_H */
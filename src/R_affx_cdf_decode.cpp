@@ -0,0 +1,248 @@
+#include "R_affx_cdf_decode.h"
+#include "R_affx_cdf_extras.h"
+#include "FusionCDFData.h"
+
+#include <climits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define R_NO_REMAP
+#include <Rinternals.h>
+
+using namespace std;
+using namespace affymetrix_fusion_io;
+
+/* The units are handed out to the threads in chunks of this many units. */
+#define R_AFFX_CDF_DECODE_CHUNK 64
+
+RAffxCdfUnitSlots::RAffxCdfUnitSlots() :
+  unitNames(NULL), unitTypes(NULL), unitDirections(NULL),
+  groupCellStart(NULL), groupNames(NULL), groupDirections(NULL),
+  x(NULL), y(NULL), indices(NULL), pbase(NULL), tbase(NULL),
+  expos(NULL), indexpos(NULL), codes(NULL)
+{
+}
+
+RAffxCdfUnitDecoder::RAffxCdfUnitDecoder(const char *cdfFileName, int nbrOfThreads) :
+  m_FileName(cdfFileName), m_NbrOfThreads(nbrOfThreads < 1 ? 1 : nbrOfThreads)
+{
+}
+
+string RAffxCdfUnitDecoder::Count(SEXP units, int nbrOfUnits)
+{
+  bool readAll = (Rf_length(units) == 0);
+
+  /* Unit indices are zero-based in Fusion SDK. */
+  m_Units.resize(nbrOfUnits);
+  for (int uu = 0; uu < nbrOfUnits; uu++)
+    m_Units[uu] = readAll ? uu : INTEGER(units)[uu] - 1;
+  m_UnitGroupStart.assign(nbrOfUnits + 1, 0);
+  m_UnitCellStart.assign(nbrOfUnits + 1, 0);
+
+  string err = Run(NULL);
+  if (!err.empty())
+    return err;
+
+  /* The counts of each unit are turned into offsets. */
+  long long nbrOfGroups = 0, nbrOfCells = 0;
+  for (size_t uu = 1; uu < m_UnitGroupStart.size(); uu++) {
+    nbrOfGroups += m_UnitGroupStart[uu];
+    nbrOfCells += m_UnitCellStart[uu];
+    if (nbrOfGroups >= INT_MAX || nbrOfCells > INT_MAX)
+      return "The CDF units have too many groups or cells to be decoded.";
+    m_UnitGroupStart[uu] = (int) nbrOfGroups;
+    m_UnitCellStart[uu] = (int) nbrOfCells;
+  }
+  return "";
+}
+
+string RAffxCdfUnitDecoder::Fill(const RAffxCdfUnitSlots &slots)
+{
+  string err = Run(&slots);
+  if (err.empty() && slots.groupCellStart != NULL)
+    slots.groupCellStart[GetNumGroups()] = GetNumCells();
+  return err;
+}
+
+string RAffxCdfUnitDecoder::Decode(SEXP units, int nbrOfUnits, int fields,
+                                   RAffxCdfUnitTable &table)
+{
+  string err = Count(units, nbrOfUnits);
+  if (!err.empty())
+    return err;
+
+  int nbrOfGroups = GetNumGroups();
+  int nbrOfCells = GetNumCells();
+  RAffxCdfUnitSlots slots;
+
+  table.unitGroupStart = m_UnitGroupStart;
+  table.groupCellStart.resize(nbrOfGroups + 1);
+  table.unitNames.resize(nbrOfUnits);
+  table.groupNames.resize(nbrOfGroups);
+  slots.groupCellStart = &table.groupCellStart[0];
+  slots.unitNames = table.unitNames.empty() ? NULL : &table.unitNames[0];
+  slots.groupNames = table.groupNames.empty() ? NULL : &table.groupNames[0];
+
+/* Sizes a table field and points its slot to it, if it is decoded. */
+#define R_AFFX_CDF_DECODE_FIELD(flag, field, n) \
+  if ((fields & flag) && n > 0) { \
+    table.field.resize(n); \
+    slots.field = &table.field[0]; \
+  }
+
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_TYPE, unitTypes, nbrOfUnits);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_DIRECTION, unitDirections, nbrOfUnits);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_DIRECTION, groupDirections, nbrOfGroups);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_XY, x, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_XY, y, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_INDICES, indices, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_BASES, pbase, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_BASES, tbase, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_EXPOS, expos, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_INDEXPOS, indexpos, nbrOfCells);
+  R_AFFX_CDF_DECODE_FIELD(R_AFFX_CDF_DECODE_CODES, codes, nbrOfCells);
+
+#undef R_AFFX_CDF_DECODE_FIELD
+
+  return Fill(slots);
+}
+
+/* Counts the groups and cells of a unit, or writes its fields to the
+   slots of the unit if 'slots' is not NULL. */
+static string R_affx_decode_cdf_unit(FusionCDFData &cdf, int unitIdx,
+                                     FusionCDFProbeSetInformation &probeset,
+                                     int ncol, const RAffxCdfUnitSlots *slots,
+                                     int &groupIdx, int groupEnd,
+                                     int &cellIdx, int cellEnd, int uu)
+{
+  FusionCDFProbeGroupInformation group;
+  FusionCDFProbeInformation probe;
+
+  cdf.GetProbeSetInformation(unitIdx, probeset);
+  int ngroups = probeset.GetNumGroups();
+
+  if (slots == NULL) {
+    groupIdx = ngroups;
+    cellIdx = 0;
+    for (int igroup = 0; igroup < ngroups; igroup++) {
+      probeset.GetGroupInformation(igroup, group);
+      cellIdx += group.GetNumCells();
+    }
+    return "";
+  }
+
+  if (ngroups != groupEnd - groupIdx)
+    return "The CDF file changed while it was read.";
+
+  if (slots->unitNames != NULL)
+    slots->unitNames[uu] = cdf.GetProbeSetName(unitIdx);
+  if (slots->unitTypes != NULL)
+    slots->unitTypes[uu] = probeset.GetProbeSetType();
+  if (slots->unitDirections != NULL)
+    slots->unitDirections[uu] = probeset.GetDirection();
+
+  for (int igroup = 0; igroup < ngroups; igroup++, groupIdx++) {
+    probeset.GetGroupInformation(igroup, group);
+    int ncells = group.GetNumCells();
+    if (ncells > cellEnd - cellIdx)
+      return "The CDF file changed while it was read.";
+
+    if (slots->groupCellStart != NULL)
+      slots->groupCellStart[groupIdx] = cellIdx;
+    if (slots->groupNames != NULL)
+      slots->groupNames[groupIdx] = group.GetName();
+    if (slots->groupDirections != NULL)
+      slots->groupDirections[groupIdx] = group.GetDirection();
+
+    for (int icell = 0; icell < ncells; icell++, cellIdx++) {
+      group.GetCell(icell, probe);
+      int x = probe.GetX();
+      int y = probe.GetY();
+      if (slots->x != NULL) {
+        slots->x[cellIdx] = x;
+        slots->y[cellIdx] = y;
+      }
+      /* Cell indices are one-based in R. */
+      if (slots->indices != NULL)
+        slots->indices[cellIdx] = y*ncol + x + 1;
+      if (slots->pbase != NULL) {
+        slots->pbase[cellIdx] = probe.GetPBase();
+        slots->tbase[cellIdx] = probe.GetTBase();
+      }
+      if (slots->expos != NULL)
+        slots->expos[cellIdx] = probe.GetExpos();
+      if (slots->indexpos != NULL)
+        slots->indexpos[cellIdx] = probe.GetListIndex();
+      if (slots->codes != NULL)
+        slots->codes[cellIdx] = R_affx_cdf_cell_code(probe.GetPBase(),
+                                                     probe.GetTBase());
+    }
+  }
+
+  if (cellIdx != cellEnd)
+    return "The CDF file changed while it was read.";
+  return "";
+}
+
+string RAffxCdfUnitDecoder::Run(const RAffxCdfUnitSlots *slots)
+{
+  int nbrOfUnits = (int) m_Units.size();
+  vector<string> errors(m_NbrOfThreads);
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(m_NbrOfThreads)
+#endif
+  {
+    int thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#endif
+    string &err = errors[thread];
+
+    /* Each thread has its own reader of the file. */
+    FusionCDFData cdf;
+    FusionCDFProbeSetInformation probeset;
+    int ncol = 0;
+    cdf.SetFileName(m_FileName.c_str());
+    try {
+      if (cdf.ReadByProbeSetIndex() == false)
+        err = "Failed to read the CDF file.";
+      else
+        ncol = cdf.GetHeader().GetCols();
+    } catch (...) {
+      err = "Failed to read the CDF file.";
+    }
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, R_AFFX_CDF_DECODE_CHUNK)
+#endif
+    for (int uu = 0; uu < nbrOfUnits; uu++) {
+      if (!err.empty())
+        continue;
+      try {
+        if (slots == NULL) {
+          err = R_affx_decode_cdf_unit(cdf, m_Units[uu], probeset, ncol, NULL,
+                                       m_UnitGroupStart[uu+1], 0,
+                                       m_UnitCellStart[uu+1], 0, uu);
+        } else {
+          int groupIdx = m_UnitGroupStart[uu];
+          int cellIdx = m_UnitCellStart[uu];
+          err = R_affx_decode_cdf_unit(cdf, m_Units[uu], probeset, ncol, slots,
+                                       groupIdx, m_UnitGroupStart[uu+1],
+                                       cellIdx, m_UnitCellStart[uu+1], uu);
+        }
+      } catch (...) {
+        err = "Failed to decode a unit of the CDF file.";
+      }
+    }
+  }
+
+  for (size_t ii = 0; ii < errors.size(); ii++) {
+    if (!errors[ii].empty())
+      return errors[ii];
+  }
+  return "";
+}
+
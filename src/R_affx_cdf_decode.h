@@ -0,0 +1,133 @@
+#ifndef R_AFFX_CDF_DECODE_H
+#define R_AFFX_CDF_DECODE_H
+
+#include <string>
+#include <vector>
+
+/* An R object, as declared by Rinternals.h. */
+typedef struct SEXPREC *SEXP;
+
+/* The fields of the units decoded by RAffxCdfUnitDecoder::Decode().
+   Unit and group names and the number of cells are always decoded. */
+#define R_AFFX_CDF_DECODE_XY         0x01
+#define R_AFFX_CDF_DECODE_INDICES    0x02
+#define R_AFFX_CDF_DECODE_BASES      0x04
+#define R_AFFX_CDF_DECODE_EXPOS      0x08
+#define R_AFFX_CDF_DECODE_INDEXPOS   0x10
+#define R_AFFX_CDF_DECODE_TYPE       0x20
+#define R_AFFX_CDF_DECODE_DIRECTION  0x40
+#define R_AFFX_CDF_DECODE_CODES      0x80
+
+/**
+ * @brief The destinations of the fields of the decoded units.  Unit
+ * fields are indexed by the position of the unit among the decoded
+ * units, group and cell fields by the position of the group and the
+ * cell among all groups and cells of those units.  Fields that are
+ * NULL are not decoded.
+ */
+struct RAffxCdfUnitSlots {
+  std::string *unitNames;
+  int *unitTypes;
+  int *unitDirections;
+  /* nbrOfGroups+1 elements; the cells of group g are [g, g+1). */
+  int *groupCellStart;
+  std::string *groupNames;
+  int *groupDirections;
+  int *x;
+  int *y;
+  /* One-based cell indices. */
+  int *indices;
+  char *pbase;
+  char *tbase;
+  int *expos;
+  int *indexpos;
+  /* Cell codes, cf. R_affx_cdf_cell_code(). */
+  unsigned char *codes;
+
+  RAffxCdfUnitSlots();
+};
+
+/**
+ * @brief The decoded units of a CDF file held in flat (CSR) arrays:
+ * unit -> groups -> cells.
+ */
+struct RAffxCdfUnitTable {
+  /* The groups of unit u are [unitGroupStart[u], unitGroupStart[u+1]). */
+  std::vector<int> unitGroupStart;
+  /* The cells of group g are [groupCellStart[g], groupCellStart[g+1]). */
+  std::vector<int> groupCellStart;
+  std::vector<std::string> unitNames;
+  std::vector<int> unitTypes;
+  std::vector<int> unitDirections;
+  std::vector<std::string> groupNames;
+  std::vector<int> groupDirections;
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<int> indices;
+  std::vector<char> pbase;
+  std::vector<char> tbase;
+  std::vector<int> expos;
+  std::vector<int> indexpos;
+  std::vector<unsigned char> codes;
+};
+
+/**
+ * @brief Decodes units of a CDF file using one or more threads.
+ *
+ * Each thread reads the file with its own FusionCDFData object and
+ * decodes a share of the units.  A first pass counts the groups and
+ * the cells of each unit, such that all output arrays can be allocated
+ * once, and a second pass writes each unit into its slots of these
+ * arrays.  The R API is not used, so the output may be R vectors that
+ * were allocated before.  Without OpenMP support, a single thread is
+ * used.
+ */
+class RAffxCdfUnitDecoder {
+
+  public:
+    RAffxCdfUnitDecoder(const char *cdfFileName, int nbrOfThreads);
+
+    /**
+     * Counts the groups and the cells of units.
+     * @param units An R integer vector of the one-based indices of the
+     *   units, which have already been validated, or an empty vector
+     *   for all units.
+     * @param nbrOfUnits The number of units to decode, i.e. the length
+     *   of 'units' or, if empty, the number of units in the file.
+     * @return An empty string if successful, otherwise an error message.
+     */
+    std::string Count(SEXP units, int nbrOfUnits);
+
+    /**
+     * Decodes the counted units into the given slots.
+     * @return An empty string if successful, otherwise an error message.
+     */
+    std::string Fill(const RAffxCdfUnitSlots &slots);
+
+    /**
+     * Counts and decodes units into a table.
+     * @param fields The fields to decode, cf. R_AFFX_CDF_DECODE_XY etc.
+     * @return An empty string if successful, otherwise an error message.
+     */
+    std::string Decode(SEXP units, int nbrOfUnits, int fields,
+                       RAffxCdfUnitTable &table);
+
+    int GetNumUnits() const { return (int) m_Units.size(); }
+    int GetNumGroups() const { return m_UnitGroupStart.empty() ? 0 : m_UnitGroupStart.back(); }
+    int GetNumCells() const { return m_UnitCellStart.empty() ? 0 : m_UnitCellStart.back(); }
+
+    /** The groups of unit u are [UnitGroupStart()[u], UnitGroupStart()[u+1]). */
+    const std::vector<int> &UnitGroupStart() const { return m_UnitGroupStart; }
+
+  private:
+    std::string Run(const RAffxCdfUnitSlots *slots);
+
+    std::string m_FileName;
+    int m_NbrOfThreads;
+    /* The zero-based indices of the units. */
+    std::vector<int> m_Units;
+    std::vector<int> m_UnitGroupStart;
+    std::vector<int> m_UnitCellStart;
+};
+
+#endif /* R_AFFX_CDF_DECODE_H */
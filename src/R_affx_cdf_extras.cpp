@@ -1,6 +1,9 @@
 #include "FusionCDFData.h"
 #include <iostream>
 #include "R_affx_constants.h"
+#include "R_affx_cdf_extras.h"
+#include "R_affx_cdf_decode.h"
+#include <vector>
 
 using namespace std;
 using namespace affymetrix_fusion_io;
@@ -10,13 +13,129 @@ using namespace affymetrix_fusion_io;
 #include <wchar.h>
 #include <wctype.h>
 
+/************************************************************************
+ *
+ * R_affx_cdf_decode_units()
+ *
+ * Decodes units using 'nbrOfThreads' threads, each reading the CDF
+ * file on its own, into a table.  Unit indices have already been
+ * validated.  Returns an error message, which is empty if successful.
+ *
+ ************************************************************************/
+static string R_affx_cdf_decode_units(const char *cdfFileName, SEXP units,
+                                      int nunits, int nbrOfThreads,
+                                      int fields, int i_verboseFlag,
+                                      RAffxCdfUnitTable &table)
+{
+  if (i_verboseFlag >= R_AFFX_VERBOSE) {
+    Rprintf("Decoding %d units using %d threads.\n", nunits, nbrOfThreads);
+  }
+
+  RAffxCdfUnitDecoder decoder(cdfFileName, nbrOfThreads);
+  return decoder.Decode(units, nunits, fields, table);
+}
+
+
+/************************************************************************
+ *
+ * R_affx_cdf_group_list()
+ *
+ * Creates the list structure of R_affx_cdf_nbrOfCellsPerUnitGroup()
+ * or, if 'isPm' is true, of R_affx_cdf_isPm() from decoded units.
+ *
+ ************************************************************************/
+static SEXP R_affx_cdf_group_list(const RAffxCdfUnitTable &table, bool isPm)
+{
+  SEXP names, probe_sets, r_groups, r_group_names, values;
+  int nunits = (int) table.unitNames.size();
+
+  PROTECT(probe_sets = NEW_LIST(nunits)); 
+  PROTECT(names = NEW_CHARACTER(nunits));
+
+  for (int ii = 0; ii < nunits; ii++) {
+    SET_STRING_ELT(names, ii, mkChar(table.unitNames[ii].c_str()));
+
+    int firstGroup = table.unitGroupStart[ii];
+    int ngroups = table.unitGroupStart[ii+1] - firstGroup;
+
+    PROTECT(r_groups = isPm ? NEW_LIST(ngroups) : NEW_INTEGER(ngroups));
+    PROTECT(r_group_names = NEW_CHARACTER(ngroups));
+
+    for (int igroup = 0; igroup < ngroups; igroup++) {
+      int gg = firstGroup + igroup;
+      int firstCell = table.groupCellStart[gg];
+      int ncells = table.groupCellStart[gg+1] - firstCell;
+
+      SET_STRING_ELT(r_group_names, igroup, mkChar(table.groupNames[gg].c_str()));
+
+      if (isPm) {
+        PROTECT(values = NEW_LOGICAL(ncells));
+        for (int icell = 0; icell < ncells; icell++) {
+          LOGICAL(values)[icell] =
+            (table.codes[firstCell + icell] & R_AFFX_CDF_CODE_PM) != 0;
+        }
+        SET_VECTOR_ELT(r_groups, igroup, values);
+        UNPROTECT(1);  /* 'values' */
+      } else {
+        INTEGER(r_groups)[igroup] = ncells;
+      }
+    }
+
+    setAttrib(r_groups, R_NamesSymbol, r_group_names);
+    SET_VECTOR_ELT(probe_sets, ii, r_groups);
+    UNPROTECT(2); /* 'r_group_names' and then 'r_groups' */
+  }
+
+  setAttrib(probe_sets, R_NamesSymbol, names);
+  UNPROTECT(2);  /* 'names' and then 'probe_sets' */
+
+  return probe_sets;
+}
+
+
+/************************************************************************
+ *
+ * R_affx_cdf_group_list_parallel()
+ *
+ * Decodes units using several threads and creates the list structure
+ * of R_affx_cdf_nbrOfCellsPerUnitGroup() or R_affx_cdf_isPm().
+ *
+ ************************************************************************/
+static SEXP R_affx_cdf_group_list_parallel(const char *cdfFileName,
+                                           SEXP units, int nunits,
+                                           int nbrOfThreads, bool isPm,
+                                           int i_verboseFlag)
+{
+  SEXP probe_sets = R_NilValue;
+  string err;
+
+  {
+    RAffxCdfUnitTable table;
+    err = R_affx_cdf_decode_units(cdfFileName, units, nunits, nbrOfThreads,
+                                  isPm ? R_AFFX_CDF_DECODE_CODES : 0,
+                                  i_verboseFlag, table);
+    if (err.empty()) {
+      PROTECT(probe_sets = R_affx_cdf_group_list(table, isPm));
+    }
+  }
+
+  if (!err.empty()) {
+    error("%s", err.c_str());
+  }
+
+  UNPROTECT(1); /* 'probe_sets' */
+  return probe_sets;
+}
+
+
 extern "C" {
   /************************************************************************
    *
    * R_affx_cdf_nbrOfCellsPerUnitGroup()
    *
    ************************************************************************/
-  SEXP R_affx_cdf_nbrOfCellsPerUnitGroup(SEXP fname, SEXP units, SEXP verbose) 
+  SEXP R_affx_cdf_nbrOfCellsPerUnitGroup(SEXP fname, SEXP units, SEXP verbose,
+                                         SEXP nbrOfThreads) 
   {
     FusionCDFData cdf;
     FusionCDFFileHeader header;
@@ -34,6 +153,7 @@ extern "C" {
     int iset = 0;
     const char* cdfFileName = CHAR(STRING_ELT(fname, 0));
     int i_verboseFlag = INTEGER(verbose)[0];
+    int i_nbrOfThreads = INTEGER(nbrOfThreads)[0];
 
     FusionCDFProbeSetInformation probeset;
 
@@ -70,6 +190,14 @@ extern "C" {
       }
     }
 
+    /* Decode the units using several threads? */
+    if (i_nbrOfThreads > 1) {
+      cdf.Close();
+      return R_affx_cdf_group_list_parallel(cdfFileName, units, nunits,
+                                            i_nbrOfThreads, false,
+                                            i_verboseFlag);
+    }
+
     /* Allocate R character vector and R list for the names and units */
     PROTECT(names = NEW_CHARACTER(nunits));
     PROTECT(probe_sets = NEW_LIST(nunits)); 
@@ -294,6 +422,61 @@ extern "C" {
 
 
 
+  /************************************************************************
+   *
+   * R_affx_cdf_base_codes
+   *
+   * The code of each base character: 4 plus 0, 1, 2 or 3 for A, C, G
+   * and T (in either case), and 0 for any other character.
+   *
+   ************************************************************************/
+  static const unsigned char R_affx_cdf_base_codes[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 4, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 4, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+  };
+
+
+  /************************************************************************
+   *
+   * R_affx_cdf_cell_code
+   *
+   * Returns the one-byte code of a cell with the given P and T bases,
+   * cf. R_AFFX_CDF_CODE_PM etc.
+   *
+   ************************************************************************/
+  unsigned char R_affx_cdf_cell_code(char p_base, char t_base)
+  {
+    unsigned char p = R_affx_cdf_base_codes[(unsigned char) p_base];
+    unsigned char t = R_affx_cdf_base_codes[(unsigned char) t_base];
+    unsigned char code = (p & 0x03) | ((t & 0x03) << 2);
+    if (p != 0) code |= R_AFFX_CDF_CODE_PBASE_KNOWN;
+    if (t != 0) code |= R_AFFX_CDF_CODE_TBASE_KNOWN;
+    if (p != 0 && t != 0) {
+      /* A+T and C+G are the only pairs of codes that sum to 3. */
+      if ((p & 0x03) + (t & 0x03) == 3) {
+        code |= R_AFFX_CDF_CODE_PM;
+      } else if (p == t) {
+        code |= R_AFFX_CDF_CODE_MM;
+      }
+    }
+    return code;
+  } /* R_affx_cdf_cell_code() */
+
+
   /************************************************************************
    *
    * R_affx_pt_base_is_pm
@@ -303,27 +486,7 @@ extern "C" {
    ************************************************************************/
   int R_affx_pt_base_is_pm(char p_base, char t_base)
   {
-    int is_pm = 0; /* 0 is false, 1 is true */
-    if (p_base == t_base) {
-      is_pm = 0;
-    } else {
-      if ((p_base == 'a' || p_base == 'A') &&
-          (t_base == 't' || t_base == 'T'))   {
-        is_pm = 1;
-      } else if ((p_base == 't' || p_base == 'T') &&
-                 (t_base == 'a' || t_base == 'A'))   {
-        is_pm = 1;
-      } else if ((p_base == 'c' || p_base == 'C') &&
-                 (t_base == 'g' || t_base == 'G'))   {
-        is_pm = 1;
-      } else if ((p_base == 'g' || p_base == 'G') &&
-                 (t_base == 'c' || t_base == 'C'))   {
-        is_pm = 1;
-      } else {
-        is_pm = 0;
-      }
-    }
-    return is_pm;
+    return (R_affx_cdf_cell_code(p_base, t_base) & R_AFFX_CDF_CODE_PM) != 0;
   } /* R_affx_pt_base_is_pm() */
 
 
@@ -332,7 +495,7 @@ extern "C" {
    * R_affx_cdf_isPm()
    *
    ************************************************************************/
-  SEXP R_affx_cdf_isPm(SEXP fname, SEXP units, SEXP verbose) 
+  SEXP R_affx_cdf_isPm(SEXP fname, SEXP units, SEXP verbose, SEXP nbrOfThreads) 
   {
     FusionCDFData cdf;
     FusionCDFFileHeader header;
@@ -351,6 +514,7 @@ extern "C" {
     int iset = 0;
     const char* cdfFileName = CHAR(STRING_ELT(fname, 0));
     int i_verboseFlag = INTEGER(verbose)[0];
+    int i_nbrOfThreads = INTEGER(nbrOfThreads)[0];
 
     /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      * Opens file
@@ -385,6 +549,14 @@ extern "C" {
       }
     }
 
+    /* Decode the units using several threads? */
+    if (i_nbrOfThreads > 1) {
+      cdf.Close();
+      return R_affx_cdf_group_list_parallel(cdfFileName, units, nunits,
+                                            i_nbrOfThreads, true,
+                                            i_verboseFlag);
+    }
+
     /* Allocate R character vector and R list for the names and units */
     PROTECT(probe_sets = NEW_LIST(nunits)); 
     PROTECT(names = NEW_CHARACTER(nunits));
@@ -481,6 +653,12 @@ extern "C" {
 
 /***************************************************************************
  * HISTORY:
+ * 2026-10-16
+ * o Added R_affx_cdf_cell_code(), which codes the bases and the PM/MM
+ *   role of a cell in one byte using a table of base codes.  Now
+ *   R_affx_pt_base_is_pm() uses it.
+ * o Added argument 'nbrOfThreads' to R_affx_cdf_nbrOfCellsPerUnitGroup()
+ *   and R_affx_cdf_isPm() for decoding the units using several threads.
  * 2007-03-05 
  * o Added argument 'truncateGroupNames' to R_affx_cdf_group_names().
  * 2006-11-27
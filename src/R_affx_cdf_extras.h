@@ -1,8 +1,23 @@
 #if !defined(R_AFFX_CDF_EXTRAS_H)
 #define R_AFFX_CDF_EXTRAS_H
+
+/*
+ * The bits of the one-byte cell codes of R_affx_cdf_cell_code().  The
+ * P and T bases are coded as A=0, C=1, G=2 and T=3, regardless of case.
+ * A cell is a perfect match (PM) if its bases are complementary and a
+ * mismatch (MM) if they are the same.
+ */
+#define R_AFFX_CDF_CODE_PBASE(code)   ((code) & 0x03)
+#define R_AFFX_CDF_CODE_TBASE(code)   (((code) >> 2) & 0x03)
+#define R_AFFX_CDF_CODE_PM            0x10
+#define R_AFFX_CDF_CODE_PBASE_KNOWN   0x20
+#define R_AFFX_CDF_CODE_TBASE_KNOWN   0x40
+#define R_AFFX_CDF_CODE_MM            0x80
+
 extern "C" {
     /* utility functions that can be used elsewhere in the code */
 int R_affx_pt_base_is_pm(char p_base, char t_base);
+unsigned char R_affx_cdf_cell_code(char p_base, char t_base);
 
 }
 #endif
@@ -1,7 +1,10 @@
 #include "FusionCDFData.h"
 #include <iostream>
+#include <climits>
 #include "R_affx_constants.h"
 #include "R_affx_cdf_extras.h"
+#include "R_affx_cdf_cache.h"
+#include "R_affx_cdf_decode.h"
 
 using namespace std;
 using namespace affymetrix_fusion_io;
@@ -1023,6 +1026,342 @@ extern "C" {
 
 
 
+  /************************************************************************
+   *
+   * R_affx_cdf_cell_index_list()
+   *
+   * Description:
+   * Creates the list structure of R_affx_get_cdf_cell_indices() from a
+   * cell index table.  Unit indices have already been validated.
+   *
+   ************************************************************************/
+  static SEXP R_affx_cdf_cell_index_list(const RAffxCdfCellIndexCache &table, SEXP units)
+  {
+    SEXP resUnits, unitNames, r_probe_set, r_probe_set_names,
+         r_group_list, r_group_names, indices, cell_list, cell_list_names;
+    const int32_t *unitGroupStart = table.UnitGroupStart();
+    const int32_t *groupCellStart = table.GroupCellStart();
+    const int32_t *cellIndices = table.CellIndices();
+    const int32_t *unitNameStart = table.UnitNameStart();
+    const int32_t *groupNameStart = table.GroupNameStart();
+    const char *names = table.Names();
+
+    bool readAll = (length(units) == 0);
+    int nbrOfUnits = readAll ? table.GetNumUnits() : length(units);
+
+    PROTECT(resUnits = NEW_LIST(nbrOfUnits));
+    PROTECT(unitNames = NEW_CHARACTER(nbrOfUnits));
+
+    /* Same field names for all groups and units */
+    PROTECT(cell_list_names = NEW_STRING(1));
+    SET_STRING_ELT(cell_list_names, 0, mkChar("indices"));
+    PROTECT(r_probe_set_names = NEW_STRING(1));
+    SET_STRING_ELT(r_probe_set_names, 0, mkChar("groups"));
+
+    for (int uu = 0; uu < nbrOfUnits; uu++) {
+      /* Make it possible to interrupt */
+      if(uu % 1000 == 999) R_CheckUserInterrupt();
+
+      /* Unit indices are zero-based in the table. */
+      int unitIdx = readAll ? uu : INTEGER(units)[uu] - 1;
+
+      SET_STRING_ELT(unitNames, uu, mkCharLen(names + unitNameStart[unitIdx],
+                     unitNameStart[unitIdx+1] - unitNameStart[unitIdx]));
+
+      int firstGroup = unitGroupStart[unitIdx];
+      int ngroups = unitGroupStart[unitIdx+1] - firstGroup;
+
+      PROTECT(r_probe_set = NEW_LIST(1));
+      PROTECT(r_group_list = NEW_LIST(ngroups));
+      PROTECT(r_group_names = NEW_CHARACTER(ngroups));
+
+      for (int igroup = 0; igroup < ngroups; igroup++) {
+        int gg = firstGroup + igroup;
+        int ncells = groupCellStart[gg+1] - groupCellStart[gg];
+
+        PROTECT(cell_list = NEW_LIST(1));
+        PROTECT(indices = NEW_INTEGER(ncells));
+        if (ncells > 0) {
+          memcpy(INTEGER(indices), cellIndices + groupCellStart[gg],
+                 ncells*sizeof(int));
+        }
+        SET_VECTOR_ELT(cell_list, 0, indices);
+        setAttrib(cell_list, R_NamesSymbol, cell_list_names);
+        SET_VECTOR_ELT(r_group_list, igroup, cell_list);
+        SET_STRING_ELT(r_group_names, igroup, mkCharLen(names + groupNameStart[gg],
+                       groupNameStart[gg+1] - groupNameStart[gg]));
+        UNPROTECT(2);  /* 'indices' and then 'cell_list' */
+      }
+
+      setAttrib(r_group_list, R_NamesSymbol, r_group_names);
+      SET_VECTOR_ELT(r_probe_set, 0, r_group_list);
+      setAttrib(r_probe_set, R_NamesSymbol, r_probe_set_names);
+      SET_VECTOR_ELT(resUnits, uu, r_probe_set);
+
+      /* 'r_group_names' and then 'r_group_list' and 'r_probe_set' */
+      UNPROTECT(3);
+    }
+
+    UNPROTECT(2);  /* 'r_probe_set_names' and then  'cell_list_names' */
+    setAttrib(resUnits, R_NamesSymbol, unitNames);
+    UNPROTECT(2); /* 'unitNames' and then 'resUnits' */
+
+    return resUnits;
+  } /* R_affx_cdf_cell_index_list() */
+
+
+
+  /************************************************************************
+   *
+   * R_affx_cdf_base_chars()
+   *
+   * Description:
+   * Returns a character vector with one single-character string for
+   * each byte value, such that the CHARSXP of each P and T base is
+   * created only once.
+   *
+   ************************************************************************/
+  static SEXP R_affx_cdf_base_chars()
+  {
+    SEXP bases;
+    char base[2] = "X";
+    PROTECT(bases = NEW_CHARACTER(256));
+    for (int kk = 1; kk < 256; kk++) {
+      base[0] = (char) kk;
+      SET_STRING_ELT(bases, kk, mkChar(base));
+    }
+    UNPROTECT(1);
+    return bases;
+  } /* R_affx_cdf_base_chars() */
+
+
+
+  /************************************************************************
+   *
+   * R_affx_cdf_unit_list()
+   *
+   * Description:
+   * Creates the list structure of R_affx_get_cdf_units() from units that
+   * were decoded by RAffxCdfUnitDecoder.
+   *
+   ************************************************************************/
+  static SEXP R_affx_cdf_unit_list(const RAffxCdfUnitTable &table,
+                                   int i_readXY, int i_readBases,
+                                   int i_readExpos, int i_readType,
+                                   int i_readDirection, int i_readIndices,
+                                   int i_readIsPm)
+  {
+    SEXP resUnits, unitNames, r_probe_set, r_probe_set_names, r_group_list,
+         r_group_names, cell_list, cell_list_names = R_NilValue,
+         bases = R_NilValue, isPmList = R_NilValue, r_ispm_groups, tmp;
+
+    int i_readGroups = i_readXY || i_readBases || i_readExpos || i_readIndices;
+    int nbrOfUnits = (int) table.unitNames.size();
+    int nbrOfUnitElements = i_readGroups + i_readType + i_readDirection;
+    int nbrOfGroupElements = 2*i_readXY + 2*i_readBases + i_readExpos 
+                                          + i_readIndices + i_readDirection;
+    int fieldIdx, rpsi;
+
+    PROTECT(resUnits = NEW_LIST(nbrOfUnits));
+    PROTECT(unitNames = NEW_CHARACTER(nbrOfUnits));
+
+    /* Same field names for all groups and units */
+    PROTECT(cell_list_names = NEW_STRING(nbrOfGroupElements));
+    fieldIdx = 0;
+    if (i_readXY) {
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("x"));
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("y"));
+    }
+    if (i_readIndices)
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("indices"));
+    if (i_readBases) {
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("pbase"));
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("tbase"));
+    }
+    if (i_readExpos)
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("expos"));
+    if (i_readDirection)
+      SET_STRING_ELT(cell_list_names, fieldIdx++, mkChar("direction"));
+
+    PROTECT(r_probe_set_names = NEW_STRING(nbrOfUnitElements));
+    rpsi = 0;
+    if (i_readType)
+      SET_STRING_ELT(r_probe_set_names, rpsi++, mkChar("type"));
+    if (i_readDirection)
+      SET_STRING_ELT(r_probe_set_names, rpsi++, mkChar("direction"));
+    if (i_readGroups)
+      SET_STRING_ELT(r_probe_set_names, rpsi++, mkChar("groups"));
+
+    PROTECT(bases = i_readBases ? R_affx_cdf_base_chars() : R_NilValue);
+    PROTECT(isPmList = i_readIsPm ? NEW_LIST(nbrOfUnits) : R_NilValue);
+
+/* Copies the cells of the current group from a table column. */
+#define R_AFFX_CDF_CELLS(column) \
+    PROTECT(tmp = NEW_INTEGER(ncells)); \
+    if (ncells > 0) \
+      memcpy(INTEGER(tmp), &table.column[cellIdx], ncells*sizeof(int)); \
+    SET_VECTOR_ELT(cell_list, fieldIdx++, tmp); \
+    UNPROTECT(1);
+
+    for (int uu = 0; uu < nbrOfUnits; uu++) {
+      SET_STRING_ELT(unitNames, uu, mkChar(table.unitNames[uu].c_str()));
+
+      PROTECT(r_probe_set = NEW_LIST(nbrOfUnitElements));
+      rpsi = 0;
+      if (i_readType)
+        SET_VECTOR_ELT(r_probe_set, rpsi++, ScalarInteger(table.unitTypes[uu]));
+      if (i_readDirection)
+        SET_VECTOR_ELT(r_probe_set, rpsi++, ScalarInteger(table.unitDirections[uu]));
+
+      if (i_readGroups) {
+        int firstGroup = table.unitGroupStart[uu];
+        int ngroups = table.unitGroupStart[uu+1] - firstGroup;
+
+        PROTECT(r_group_list = NEW_LIST(ngroups));
+        PROTECT(r_group_names = NEW_CHARACTER(ngroups));
+        PROTECT(r_ispm_groups = i_readIsPm ? NEW_LIST(ngroups) : R_NilValue);
+
+        for (int igroup = 0; igroup < ngroups; igroup++) {
+          int gg = firstGroup + igroup;
+          int cellIdx = table.groupCellStart[gg];
+          int ncells = table.groupCellStart[gg+1] - cellIdx;
+
+          PROTECT(cell_list = NEW_LIST(nbrOfGroupElements));
+          fieldIdx = 0;
+          if (i_readXY) {
+            R_AFFX_CDF_CELLS(x);
+            R_AFFX_CDF_CELLS(y);
+          }
+          if (i_readIndices) {
+            R_AFFX_CDF_CELLS(indices);
+          }
+          if (i_readBases) {
+            PROTECT(tmp = NEW_CHARACTER(ncells));
+            for (int icell = 0; icell < ncells; icell++) {
+              SET_STRING_ELT(tmp, icell, STRING_ELT(bases,
+                (unsigned char) table.pbase[cellIdx + icell]));
+            }
+            SET_VECTOR_ELT(cell_list, fieldIdx++, tmp);
+            UNPROTECT(1);
+            PROTECT(tmp = NEW_CHARACTER(ncells));
+            for (int icell = 0; icell < ncells; icell++) {
+              SET_STRING_ELT(tmp, icell, STRING_ELT(bases,
+                (unsigned char) table.tbase[cellIdx + icell]));
+            }
+            SET_VECTOR_ELT(cell_list, fieldIdx++, tmp);
+            UNPROTECT(1);
+          }
+          if (i_readExpos) {
+            R_AFFX_CDF_CELLS(expos);
+          }
+          if (i_readDirection) {
+            SET_VECTOR_ELT(cell_list, fieldIdx++,
+                           ScalarInteger(table.groupDirections[gg]));
+          }
+          if (i_readIsPm) {
+            PROTECT(tmp = NEW_LOGICAL(ncells));
+            for (int icell = 0; icell < ncells; icell++) {
+              LOGICAL(tmp)[icell] =
+                (table.codes[cellIdx + icell] & R_AFFX_CDF_CODE_PM) != 0;
+            }
+            SET_VECTOR_ELT(r_ispm_groups, igroup, tmp);
+            UNPROTECT(1);
+          }
+          setAttrib(cell_list, R_NamesSymbol, cell_list_names);
+          SET_VECTOR_ELT(r_group_list, igroup, cell_list);
+          SET_STRING_ELT(r_group_names, igroup,
+                         mkChar(table.groupNames[gg].c_str()));
+          UNPROTECT(1); /* 'cell_list' */
+        }
+
+        setAttrib(r_group_list, R_NamesSymbol, r_group_names);
+        SET_VECTOR_ELT(r_probe_set, rpsi, r_group_list);
+        if (i_readIsPm) {
+          setAttrib(r_ispm_groups, R_NamesSymbol, r_group_names);
+          SET_VECTOR_ELT(isPmList, uu, r_ispm_groups);
+        }
+        /* 'r_ispm_groups', 'r_group_names' and then 'r_group_list' */
+        UNPROTECT(3);
+      }
+
+      setAttrib(r_probe_set, R_NamesSymbol, r_probe_set_names);
+      SET_VECTOR_ELT(resUnits, uu, r_probe_set);
+      UNPROTECT(1); /* 'r_probe_set' */
+    }
+
+#undef R_AFFX_CDF_CELLS
+
+    if (i_readIsPm) {
+      setAttrib(isPmList, R_NamesSymbol, unitNames);
+      setAttrib(resUnits, install("isPm"), isPmList);
+    }
+
+    /* 'isPmList', 'bases', 'r_probe_set_names' and 'cell_list_names' */
+    UNPROTECT(4);
+    setAttrib(resUnits, R_NamesSymbol, unitNames);
+    UNPROTECT(2); /* 'unitNames' and then 'resUnits' */
+
+    return resUnits;
+  } /* R_affx_cdf_unit_list() */
+
+
+
+  /************************************************************************
+   *
+   * R_affx_get_cdf_units_parallel()
+   *
+   * Description:
+   * Decodes the units for R_affx_get_cdf_units() and
+   * R_affx_get_cdf_cell_indices() using 'nbrOfThreads' threads, each
+   * reading the CDF file on its own.  Unit indices have already been
+   * validated.
+   *
+   ************************************************************************/
+  static SEXP R_affx_get_cdf_units_parallel(const char *cdfFileName,
+                                            SEXP units, int nbrOfUnits,
+                                            int nbrOfThreads,
+                                            int i_readXY, int i_readBases,
+                                            int i_readExpos, int i_readType,
+                                            int i_readDirection,
+                                            int i_readIndices,
+                                            int i_readIsPm,
+                                            int i_verboseFlag)
+  {
+    SEXP resUnits = R_NilValue;
+    string err;
+    int fields = (i_readXY ? R_AFFX_CDF_DECODE_XY : 0) |
+                 (i_readIndices ? R_AFFX_CDF_DECODE_INDICES : 0) |
+                 (i_readBases ? R_AFFX_CDF_DECODE_BASES : 0) |
+                 (i_readExpos ? R_AFFX_CDF_DECODE_EXPOS : 0) |
+                 (i_readType ? R_AFFX_CDF_DECODE_TYPE : 0) |
+                 (i_readDirection ? R_AFFX_CDF_DECODE_DIRECTION : 0) |
+                 (i_readIsPm ? R_AFFX_CDF_DECODE_CODES : 0);
+
+    if (i_verboseFlag >= R_AFFX_VERBOSE) {
+      Rprintf("Decoding %d units using %d threads.\n", nbrOfUnits, nbrOfThreads);
+    }
+
+    {
+      RAffxCdfUnitTable table;
+      RAffxCdfUnitDecoder decoder(cdfFileName, nbrOfThreads);
+      err = decoder.Decode(units, nbrOfUnits, fields, table);
+      if (err.empty()) {
+        PROTECT(resUnits = R_affx_cdf_unit_list(table, i_readXY, i_readBases,
+                             i_readExpos, i_readType, i_readDirection,
+                             i_readIndices, i_readIsPm));
+      }
+    }
+
+    if (!err.empty()) {
+      error("%s", err.c_str());
+    }
+
+    UNPROTECT(1); /* 'resUnits' */
+    return resUnits;
+  } /* R_affx_get_cdf_units_parallel() */
+
+
+
   /************************************************************************
    *
    * R_affx_get_cdf_cell_indices()
@@ -1033,8 +1372,13 @@ extern "C" {
    * then it would be hard to differentiate that element from a unit; the
    * number of list elements should equal the number of units read.
    *
+   * If argument 'cache' is TRUE, the cell indices are read from a cache
+   * file next to the CDF file, which is first created if it does not
+   * exist or is out of date.
+   *
    ************************************************************************/
-  SEXP R_affx_get_cdf_cell_indices(SEXP fname, SEXP units, SEXP verbose) 
+  SEXP R_affx_get_cdf_cell_indices(SEXP fname, SEXP units, SEXP verbose,
+                                   SEXP cache, SEXP nbrOfThreads) 
   {
     FusionCDFData cdf;
     string str;
@@ -1066,6 +1410,48 @@ extern "C" {
      * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
     const char* cdfFileName   = CHAR(STRING_ELT(fname, 0));
     int i_verboseFlag   = INTEGER(verbose)[0];
+    int i_cache         = LOGICAL(cache)[0] == TRUE;
+    int i_nbrOfThreads  = INTEGER(nbrOfThreads)[0];
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Use the cell index cache?
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    if (i_cache) {
+      RAffxCdfCellIndexCache table;
+      string cacheFileName = RAffxCdfCellIndexCache::GetCacheFileName(cdfFileName);
+      if (table.Map(cacheFileName.c_str(), cdfFileName)) {
+        if (i_verboseFlag >= R_AFFX_VERBOSE) {
+          Rprintf("Reading cell indices from cache file: %s\n", cacheFileName.c_str());
+        }
+      } else {
+        cdf.SetFileName(cdfFileName);
+        if (i_verboseFlag >= R_AFFX_VERBOSE) {
+          Rprintf("Creating cell index cache file: %s\n", cacheFileName.c_str());
+        }
+        if (cdf.Read() == false) {
+          error("Failed to read the CDF file.");
+        }
+        /* If the cache cannot be written, the table is still used. */
+        if (table.Build(cdf) && !table.Write(cacheFileName.c_str(), cdfFileName) &&
+            i_verboseFlag >= R_AFFX_VERBOSE) {
+          Rprintf("Failed to write cell index cache file: %s\n", cacheFileName.c_str());
+        }
+        cdf.Close();
+      }
+
+      /* Otherwise the CDF file is too large for the table. */
+      if (table.UnitGroupStart() != NULL) {
+        maxNbrOfUnits = table.GetNumUnits();
+        for (int uu = 0; uu < length(units); uu++) {
+          unitIdx = INTEGER(units)[uu];
+          if (unitIdx < 1 || unitIdx > maxNbrOfUnits) {
+            table.Clear();
+            error("Argument 'units' contains an element out of range: %d", unitIdx);
+          }
+        }
+        return R_affx_cdf_cell_index_list(table, units);
+      }
+    }
 
     /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      * Opens file
@@ -1103,6 +1489,16 @@ extern "C" {
 
     ncol = header.GetCols();
 
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Decode the units using several threads?
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    if (i_nbrOfThreads > 1) {
+      cdf.Close();
+      return R_affx_get_cdf_units_parallel(cdfFileName, units, nbrOfUnits,
+                                           i_nbrOfThreads, 0, 0, 0, 0, 0, 1, 0,
+                                           i_verboseFlag);
+    }
+
     /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      * Allocate 'resUnits' list
      * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -1261,7 +1657,8 @@ extern "C" {
    ************************************************************************/
   SEXP R_affx_get_cdf_units(SEXP fname, SEXP units, SEXP readXY, SEXP readBases, 
                             SEXP readExpos, SEXP readType, SEXP readDirection, 
-                            SEXP readIndices, SEXP verbose)
+                            SEXP readIndices, SEXP readIsPm, SEXP verbose,
+                            SEXP nbrOfThreads)
   {
     FusionCDFData cdf;
     string str;
@@ -1286,8 +1683,12 @@ extern "C" {
       pbase = R_NilValue,
       tbase = R_NilValue,
       expos = R_NilValue,
+      isPm = R_NilValue,
       cell_list = R_NilValue,
       cell_list_names = R_NilValue,
+      /* PM flags of all cells, cf. R_affx_cdf_isPm() */
+      isPmList = R_NilValue,
+      r_ispm_groups = R_NilValue,
       tmp = R_NilValue; 
 
     bool readAll = true; 
@@ -1312,16 +1713,22 @@ extern "C" {
     int i_readDirection = INTEGER(readDirection)[0];
     int i_readIndices   = INTEGER(readIndices)[0];
     int i_verboseFlag   = INTEGER(verbose)[0];
+    int i_nbrOfThreads  = INTEGER(nbrOfThreads)[0];
 
     int i_readGroups = i_readXY || i_readBases || i_readExpos || i_readIndices;
 
+    /* The PM flags are returned as attribute 'isPm', which has the same
+       structure as the value of R_affx_cdf_isPm(). */
+    int i_readIsPm = INTEGER(readIsPm)[0] && i_readGroups;
+
 
     /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      * A special case?
      * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
     if (i_readIndices && !i_readXY && !i_readBases && !i_readExpos && 
-                                           !i_readType && !i_readDirection) {
-      return R_affx_get_cdf_cell_indices(fname, units, verbose);
+                         !i_readType && !i_readDirection && !i_readIsPm) {
+      return R_affx_get_cdf_cell_indices(fname, units, verbose,
+                                         ScalarLogical(FALSE), nbrOfThreads);
     }
 
 
@@ -1363,11 +1770,25 @@ extern "C" {
       ncol = header.GetCols();
     }
 
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Decode the units using several threads?
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    if (i_nbrOfThreads > 1) {
+      cdf.Close();
+      return R_affx_get_cdf_units_parallel(cdfFileName, units, nbrOfUnits,
+                                           i_nbrOfThreads, i_readXY,
+                                           i_readBases, i_readExpos,
+                                           i_readType, i_readDirection,
+                                           i_readIndices, i_readIsPm,
+                                           i_verboseFlag);
+    }
+
     /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
      * Allocate 'resUnits' list
      * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
     PROTECT(resUnits = NEW_LIST(nbrOfUnits)); 
     PROTECT(unitNames = NEW_CHARACTER(nbrOfUnits));
+    PROTECT(isPmList = i_readIsPm ? NEW_LIST(nbrOfUnits) : R_NilValue);
 
     int nbrOfUnitElements = i_readGroups + i_readType + i_readDirection;
     int nbrOfGroupElements = 2*i_readXY + 2*i_readBases + i_readExpos 
@@ -1501,6 +1922,7 @@ extern "C" {
      
         PROTECT(r_group_list = NEW_LIST(ngroups));
         PROTECT(r_group_names = NEW_CHARACTER(ngroups));
+        PROTECT(r_ispm_groups = i_readIsPm ? NEW_LIST(ngroups) : R_NilValue);
           
 
         /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -1545,6 +1967,11 @@ extern "C" {
             protectCount++;
           }
 
+          if (i_readIsPm) {
+            PROTECT(isPm = NEW_LOGICAL(ncells));
+            protectCount++;
+          }
+
           /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
            * For each cell in the current group...
            * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -1578,6 +2005,11 @@ extern "C" {
               INTEGER(expos)[icell] = probe.GetExpos();
             }
 
+            if (i_readIsPm) {
+              LOGICAL(isPm)[icell] = R_affx_pt_base_is_pm(probe.GetPBase(),
+                                                          probe.GetTBase());
+            }
+
             if (i_verboseFlag > R_AFFX_REALLY_VERBOSE) {
               Rprintf("cell: %2d, (x,y)=(%4d,%4d), (pbase,tbase)=(%c,%c), expos: %2d\n", icell, probe.GetX(), probe.GetY(), probe.GetPBase(), probe.GetTBase(), probe.GetExpos());
             }
@@ -1615,7 +2047,11 @@ extern "C" {
             SET_VECTOR_ELT(cell_list, fieldIdx++, tmp);
           }
 
-          /* Unprotect in reverse order, e.g. 'expos', ..., 'xvals' */
+          if (i_readIsPm) {
+            SET_VECTOR_ELT(r_ispm_groups, igroup, isPm);
+          }
+
+          /* Unprotect in reverse order, e.g. 'isPm', ..., 'xvals' */
           UNPROTECT(protectCount); 
           
           /** set the names of the new list, dont really know if I need 
@@ -1646,7 +2082,13 @@ extern "C" {
         /** add groups to current unit. **/
         SET_VECTOR_ELT(r_probe_set, rpsi, r_group_list);
 
-        UNPROTECT(2); /* 'r_group_names' and then 'r_group_list' */
+        if (i_readIsPm) {
+          setAttrib(r_ispm_groups, R_NamesSymbol, r_group_names);
+          SET_VECTOR_ELT(isPmList, uu, r_ispm_groups);
+        }
+
+        /* 'r_ispm_groups', 'r_group_names' and then 'r_group_list' */
+        UNPROTECT(3);
       } /* if (i_readGroups) */
  
 
@@ -1670,18 +2112,416 @@ extern "C" {
     /** set all unit names. **/
     setAttrib(resUnits, R_NamesSymbol, unitNames);
 
+    if (i_readIsPm) {
+      setAttrib(isPmList, R_NamesSymbol, unitNames);
+      setAttrib(resUnits, install("isPm"), isPmList);
+    }
+
     if (i_verboseFlag >= R_AFFX_REALLY_VERBOSE) {
       Rprintf("R_affx_get_cdf_units()...done\n");
     }
 
     /** unprotect return list. **/
-    UNPROTECT(2); /* 'unitNames' and then 'resUnits' */
+    UNPROTECT(3); /* 'isPmList', 'unitNames' and then 'resUnits' */
    
     return resUnits;
   } /* R_affx_get_cdf_units() */
 
 
 
+  /************************************************************************
+   *
+   * R_affx_get_cdf_flat()
+   *
+   * Description:
+   * This function returns the units of a CDF file as flat columns
+   * instead of as nested lists.  All cell fields are vectors over the
+   * cells of all units read, and the units and the groups are described
+   * by CSR-style offset vectors, i.e. the groups of the u:th unit are
+   * unitGroupOffsets[u]+1,...,unitGroupOffsets[u+1] and the cells of
+   * the g:th group are groupCellOffsets[g]+1,...,groupCellOffsets[g+1].
+   *
+   * The file is iterated over twice; the first pass counts the groups
+   * and the cells such that each column is allocated exactly once.
+   *
+   ************************************************************************/
+  SEXP R_affx_get_cdf_flat(SEXP fname, SEXP units, SEXP readXY,
+                           SEXP readBases, SEXP readExpos, SEXP readIndexpos,
+                           SEXP readType, SEXP readDirection,
+                           SEXP readIndices, SEXP readCellCodes,
+                           SEXP verbose, SEXP nbrOfThreads)
+  {
+    FusionCDFData cdf;
+    string str;
+
+    SEXP
+      res = R_NilValue,
+      resNames = R_NilValue,
+      /* Unit fields */
+      unitNames = R_NilValue,
+      unitTypes = R_NilValue,
+      unitDirections = R_NilValue,
+      unitGroupOffsets = R_NilValue,
+      /* Group fields */
+      groupNames = R_NilValue,
+      groupDirections = R_NilValue,
+      groupCellOffsets = R_NilValue,
+      /* Cell fields */
+      xvals = R_NilValue,
+      yvals = R_NilValue,
+      indices = R_NilValue,
+      pbase = R_NilValue,
+      tbase = R_NilValue,
+      expos = R_NilValue,
+      indexpos = R_NilValue,
+      cellCodes = R_NilValue,
+      bases = R_NilValue;
+
+    bool readAll = true;
+    int maxNbrOfUnits = 0, nbrOfUnits = 0, unitIdx = 0;
+    int ncol = 0;
+    double cellCount = 0;
+    int nbrOfGroups = 0, nbrOfCells = 0;
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Process arguments
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    const char* cdfFileName   = CHAR(STRING_ELT(fname, 0));
+    int i_readXY        = INTEGER(readXY)[0];
+    int i_readBases     = INTEGER(readBases)[0];
+    int i_readExpos     = INTEGER(readExpos)[0];
+    int i_readIndexpos  = INTEGER(readIndexpos)[0];
+    int i_readType      = INTEGER(readType)[0];
+    int i_readDirection = INTEGER(readDirection)[0];
+    int i_readIndices   = INTEGER(readIndices)[0];
+    int i_readCellCodes = INTEGER(readCellCodes)[0];
+    int i_verboseFlag   = INTEGER(verbose)[0];
+    int i_nbrOfThreads  = INTEGER(nbrOfThreads)[0];
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Opens file
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    cdf.SetFileName(cdfFileName);
+    if (i_verboseFlag >= R_AFFX_VERBOSE) {
+      Rprintf("Attempting to read CDF File: %s\n", cdf.GetFileName().c_str());
+    }
+
+    if (cdf.Read() == false) {
+      error("Failed to read the CDF file.");
+    }
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Get unit indices to be read
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    FusionCDFFileHeader header = cdf.GetHeader();
+    maxNbrOfUnits = header.GetNumProbeSets();
+    nbrOfUnits = length(units);
+    if (nbrOfUnits == 0) {
+      nbrOfUnits = maxNbrOfUnits;
+    } else {
+      readAll = false;
+      /* Validate argument 'units': */
+      for (int uu = 0; uu < nbrOfUnits; uu++) {
+        unitIdx = INTEGER(units)[uu];
+        /* Unit indices are zero-based in Fusion SDK. */
+        if (unitIdx < 1 || unitIdx > maxNbrOfUnits) {
+          error("Argument 'units' contains an element out of range: %d", unitIdx);
+        }
+      }
+    }
+
+    if (i_readIndices) {
+      ncol = header.GetCols();
+    }
+
+    FusionCDFProbeSetInformation probeset;
+    FusionCDFProbeGroupInformation group;
+    FusionCDFProbeInformation probe;
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+     * Pass 1: Count the groups and the cells
+     * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+    PROTECT(unitGroupOffsets = NEW_INTEGER(nbrOfUnits+1));
+    int *unitGroupOffsets_ptr = INTEGER(unitGroupOffsets);
+    unitGroupOffsets_ptr[0] = 0;
+    int nprotect = 1;
+
+    /* With several threads, each reads the CDF file on its own. */
+    if (i_nbrOfThreads > 1) {
+      cdf.Close();
+    }
+
+    /* The decoder and the buffers of the threads are released before
+       an error is signalled. */
+    {
+      RAffxCdfUnitDecoder decoder(cdfFileName, i_nbrOfThreads);
+
+      if (i_nbrOfThreads > 1) {
+        str = decoder.Count(units, nbrOfUnits);
+        if (str.empty()) {
+          for (int uu = 0; uu <= nbrOfUnits; uu++)
+            unitGroupOffsets_ptr[uu] = decoder.UnitGroupStart()[uu];
+          nbrOfGroups = decoder.GetNumGroups();
+          cellCount = decoder.GetNumCells();
+        }
+      } else {
+        for (int uu = 0; uu < nbrOfUnits; uu++) {
+          /* Make it possible to interrupt */
+          if(uu % 1000 == 999) R_CheckUserInterrupt();
+
+          /* Unit indices are zero-based in Fusion SDK. */
+          unitIdx = readAll ? uu : INTEGER(units)[uu] - 1;
+          cdf.GetProbeSetInformation(unitIdx, probeset);
+
+          int ngroups = probeset.GetNumGroups();
+          for (int igroup = 0; igroup < ngroups; igroup++) {
+            probeset.GetGroupInformation(igroup, group);
+            cellCount += group.GetNumCells();
+          }
+          nbrOfGroups += ngroups;
+          unitGroupOffsets_ptr[uu+1] = nbrOfGroups;
+        }
+      }
+
+      if (str.empty() && cellCount > INT_MAX) {
+        char s[256];
+        sprintf(s, "Too many cells to be returned as flat columns: %.0f", cellCount);
+        str = s;
+      }
+      nbrOfCells = (int) cellCount;
+
+      if (str.empty()) {
+        if (i_verboseFlag >= R_AFFX_VERBOSE) {
+          Rprintf("Number of units: %d, groups: %d, cells: %d\n", nbrOfUnits,
+                  nbrOfGroups, nbrOfCells);
+        }
+
+        /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+         * Allocate all columns
+         * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+        int nbrOfElements = 4 + i_readType + 2*i_readDirection
+                              + 2*i_readXY + i_readIndices + 2*i_readBases
+                              + i_readExpos + i_readIndexpos + i_readCellCodes;
+        PROTECT(res = NEW_LIST(nbrOfElements));
+        PROTECT(resNames = NEW_CHARACTER(nbrOfElements));
+        nprotect += 2;
+        int fieldIdx = 0;
+
+#define R_AFFX_FLAT_FIELD(var, name, alloc) \
+        var = alloc; \
+        SET_VECTOR_ELT(res, fieldIdx, var); \
+        SET_STRING_ELT(resNames, fieldIdx++, mkChar(name));
+
+        R_AFFX_FLAT_FIELD(unitNames, "unitNames", NEW_CHARACTER(nbrOfUnits));
+        if (i_readType) {
+          R_AFFX_FLAT_FIELD(unitTypes, "unitType", NEW_INTEGER(nbrOfUnits));
+        }
+        if (i_readDirection) {
+          R_AFFX_FLAT_FIELD(unitDirections, "unitDirection",
+                            NEW_INTEGER(nbrOfUnits));
+        }
+        SET_VECTOR_ELT(res, fieldIdx, unitGroupOffsets);
+        SET_STRING_ELT(resNames, fieldIdx++, mkChar("unitGroupOffsets"));
+
+        R_AFFX_FLAT_FIELD(groupNames, "groupNames", NEW_CHARACTER(nbrOfGroups));
+        if (i_readDirection) {
+          R_AFFX_FLAT_FIELD(groupDirections, "groupDirection",
+                            NEW_INTEGER(nbrOfGroups));
+        }
+        R_AFFX_FLAT_FIELD(groupCellOffsets, "groupCellOffsets",
+                          NEW_INTEGER(nbrOfGroups+1));
+
+        if (i_readXY) {
+          R_AFFX_FLAT_FIELD(xvals, "x", NEW_INTEGER(nbrOfCells));
+          R_AFFX_FLAT_FIELD(yvals, "y", NEW_INTEGER(nbrOfCells));
+        }
+        if (i_readIndices) {
+          R_AFFX_FLAT_FIELD(indices, "indices", NEW_INTEGER(nbrOfCells));
+        }
+        if (i_readBases) {
+          R_AFFX_FLAT_FIELD(pbase, "pbase", NEW_CHARACTER(nbrOfCells));
+          R_AFFX_FLAT_FIELD(tbase, "tbase", NEW_CHARACTER(nbrOfCells));
+        }
+        if (i_readExpos) {
+          R_AFFX_FLAT_FIELD(expos, "expos", NEW_INTEGER(nbrOfCells));
+        }
+        if (i_readIndexpos) {
+          R_AFFX_FLAT_FIELD(indexpos, "indexpos", NEW_INTEGER(nbrOfCells));
+        }
+        if (i_readCellCodes) {
+          R_AFFX_FLAT_FIELD(cellCodes, "cellCodes", allocVector(RAWSXP, nbrOfCells));
+        }
+
+#undef R_AFFX_FLAT_FIELD
+
+        setAttrib(res, R_NamesSymbol, resNames);
+
+        /* The bases are single characters; create each CHARSXP only once. */
+        if (i_readBases) {
+          PROTECT(bases = R_affx_cdf_base_chars());
+          nprotect++;
+        }
+      }
+
+      /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+       * Pass 2, with several threads: Fill in the columns
+       * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+      if (str.empty() && i_nbrOfThreads > 1) {
+        /* The threads write the numeric columns in place; the strings are
+           collected and set afterwards, since the R API is not thread safe. */
+        vector<string> unitNameSlots(nbrOfUnits), groupNameSlots(nbrOfGroups);
+        vector<char> pbaseSlots(i_readBases ? nbrOfCells : 0);
+        vector<char> tbaseSlots(i_readBases ? nbrOfCells : 0);
+        RAffxCdfUnitSlots slots;
+        if (nbrOfUnits > 0) slots.unitNames = &unitNameSlots[0];
+        if (nbrOfGroups > 0) slots.groupNames = &groupNameSlots[0];
+        slots.groupCellStart = INTEGER(groupCellOffsets);
+        if (i_readType) slots.unitTypes = INTEGER(unitTypes);
+        if (i_readDirection) {
+          slots.unitDirections = INTEGER(unitDirections);
+          slots.groupDirections = INTEGER(groupDirections);
+        }
+        if (i_readXY) {
+          slots.x = INTEGER(xvals);
+          slots.y = INTEGER(yvals);
+        }
+        if (i_readIndices) slots.indices = INTEGER(indices);
+        if (i_readBases && nbrOfCells > 0) {
+          slots.pbase = &pbaseSlots[0];
+          slots.tbase = &tbaseSlots[0];
+        }
+        if (i_readExpos) slots.expos = INTEGER(expos);
+        if (i_readIndexpos) slots.indexpos = INTEGER(indexpos);
+        if (i_readCellCodes) slots.codes = RAW(cellCodes);
+
+        str = decoder.Fill(slots);
+        if (str.empty()) {
+          for (int uu = 0; uu < nbrOfUnits; uu++)
+            SET_STRING_ELT(unitNames, uu, mkChar(unitNameSlots[uu].c_str()));
+          for (int gg = 0; gg < nbrOfGroups; gg++)
+            SET_STRING_ELT(groupNames, gg, mkChar(groupNameSlots[gg].c_str()));
+          if (i_readBases) {
+            for (int cc = 0; cc < nbrOfCells; cc++) {
+              SET_STRING_ELT(pbase, cc, STRING_ELT(bases, (unsigned char) pbaseSlots[cc]));
+              SET_STRING_ELT(tbase, cc, STRING_ELT(bases, (unsigned char) tbaseSlots[cc]));
+            }
+          }
+        }
+      }
+    }
+
+    if (!str.empty()) {
+      UNPROTECT(nprotect);
+      error("%s", str.c_str());
+    }
+
+    if (i_nbrOfThreads > 1) {
+      UNPROTECT(nprotect); /* 'bases', 'resNames', 'res' and 'unitGroupOffsets' */
+      return res;
+    }
+
+    /* Calvin CDF files are read sequentially, so start over. */
+    cdf.Close();
+    if (cdf.Read() == false) {
+      error("Failed to read the CDF file.");
+    }
+
+    int *groupCellOffsets_ptr = INTEGER(groupCellOffsets);
+    groupCellOffsets_ptr[0] = 0;
+    int gg = 0, cc = 0;
+
+    for (int uu = 0; uu < nbrOfUnits; uu++) {
+      /* Make it possible to interrupt */
+      if(uu % 1000 == 999) R_CheckUserInterrupt();
+
+      if (i_verboseFlag >= R_AFFX_VERBOSE) {
+        if (uu % 1000 == 0 || uu == nbrOfUnits-1) {
+          Rprintf("%d/%d, ", uu+1, nbrOfUnits);
+        }
+      }
+
+      /* Unit indices are zero-based in Fusion SDK. */
+      unitIdx = readAll ? uu : INTEGER(units)[uu] - 1;
+      cdf.GetProbeSetInformation(unitIdx, probeset);
+
+      str = cdf.GetProbeSetName(unitIdx);
+      SET_STRING_ELT(unitNames, uu, mkChar(str.c_str()));
+      if (i_readType) {
+        INTEGER(unitTypes)[uu] = probeset.GetProbeSetType();
+      }
+      if (i_readDirection) {
+        INTEGER(unitDirections)[uu] = probeset.GetDirection();
+      }
+
+      int ngroups = probeset.GetNumGroups();
+      for (int igroup = 0; igroup < ngroups; igroup++, gg++) {
+        probeset.GetGroupInformation(igroup, group);
+
+        str = group.GetName();
+        SET_STRING_ELT(groupNames, gg, mkChar(str.c_str()));
+        if (i_readDirection) {
+          INTEGER(groupDirections)[gg] = group.GetDirection();
+        }
+
+        int ncells = group.GetNumCells();
+        for (int icell = 0; icell < ncells; icell++, cc++) {
+          group.GetCell(icell, probe);
+
+          if (i_readXY || i_readIndices) {
+            int x = probe.GetX();
+            int y = probe.GetY();
+
+            if (i_readXY) {
+              INTEGER(xvals)[cc] = x;
+              INTEGER(yvals)[cc] = y;
+            }
+
+            if (i_readIndices) {
+              /* Cell indices are one-based in R. */
+              INTEGER(indices)[cc] = y*ncol + x + 1;
+            }
+          }
+
+          if (i_readBases) {
+            SET_STRING_ELT(pbase, cc,
+              STRING_ELT(bases, (unsigned char) probe.GetPBase()));
+            SET_STRING_ELT(tbase, cc,
+              STRING_ELT(bases, (unsigned char) probe.GetTBase()));
+          }
+
+          if (i_readExpos) {
+            INTEGER(expos)[cc] = probe.GetExpos();
+          }
+
+          if (i_readIndexpos) {
+            INTEGER(indexpos)[cc] = probe.GetListIndex();
+          }
+
+          if (i_readCellCodes) {
+            RAW(cellCodes)[cc] = R_affx_cdf_cell_code(probe.GetPBase(),
+                                                      probe.GetTBase());
+          }
+        } /* for (int icell ...) */
+
+        groupCellOffsets_ptr[gg+1] = cc;
+      } /* for (int igroup ...) */
+    } /* for (int uu ...) */
+
+    if (i_readBases) {
+      UNPROTECT(1); /* 'bases' */
+    }
+
+    if (i_verboseFlag >= R_AFFX_VERBOSE) {
+      Rprintf("R_affx_get_cdf_flat()...done\n");
+    }
+
+    UNPROTECT(3); /* 'resNames', 'res' and then 'unitGroupOffsets' */
+
+    return res;
+  } /* R_affx_get_cdf_flat() */
+
+
+
   /************************************************************************
    *
    * R_affx_get_cdf_unit_names()
@@ -1766,12 +2606,104 @@ extern "C" {
 
 
 
+  /************************************************************************
+   *
+   * R_affx_get_cdf_unit_indices()
+   *
+   * Description:
+   * Looks up units by their names in an index of the unit names, which
+   * is kept in a file next to the CDF file if 'cache' is TRUE.  Returns
+   * the one-based index of the unit with each name, or NA if there is
+   * none.  If 'prefix' is TRUE, returns instead a list with the indices
+   * of all units whose names start with each of the names.
+   *
+   ************************************************************************/
+  SEXP R_affx_get_cdf_unit_indices(SEXP fname, SEXP names, SEXP prefix,
+                                   SEXP cache, SEXP verbose)
+  {
+    SEXP res = R_NilValue, tmp;
+    bool ok;
+
+    const char* cdfFileName = CHAR(STRING_ELT(fname, 0));
+    int nbrOfNames      = length(names);
+    int i_prefix        = LOGICAL(prefix)[0] == TRUE;
+    int i_cache         = LOGICAL(cache)[0] == TRUE;
+    int i_verboseFlag   = INTEGER(verbose)[0];
+
+    {
+      FusionCDFData cdf;
+      /* Equal names give the first unit, as match() does */
+      affymetrix_calvin_utilities::StringIndex index(true);
+      vector<int32_t> indices;
+      string indexFileName;
+
+      if (i_cache) {
+        indexFileName = string(cdfFileName) + ".unitidx";
+      }
+
+      cdf.SetFileName(cdfFileName);
+      if (i_verboseFlag >= R_AFFX_VERBOSE) {
+        Rprintf("Getting the unit name index of CDF File: %s\n",
+                cdf.GetFileName().c_str());
+      }
+
+      ok = cdf.GetProbeSetNameIndex(index, indexFileName);
+      if (ok && i_prefix) {
+        PROTECT(res = NEW_LIST(nbrOfNames));
+        for (int ii = 0; ii < nbrOfNames; ii++) {
+          SEXP name = STRING_ELT(names, ii);
+          if (name == NA_STRING) {
+            indices.clear();
+          } else {
+            index.FindPrefix(CHAR(name), strlen(CHAR(name)), indices);
+          }
+          PROTECT(tmp = NEW_INTEGER(indices.size()));
+          /* Unit indices are one-based in R. */
+          for (size_t kk = 0; kk < indices.size(); kk++)
+            INTEGER(tmp)[kk] = indices[kk] + 1;
+          SET_VECTOR_ELT(res, ii, tmp);
+          UNPROTECT(1);
+        }
+      } else if (ok) {
+        PROTECT(res = NEW_INTEGER(nbrOfNames));
+        for (int ii = 0; ii < nbrOfNames; ii++) {
+          SEXP name = STRING_ELT(names, ii);
+          int idx = -1;
+          if (name != NA_STRING)
+            idx = index.Find(CHAR(name), strlen(CHAR(name)));
+          /* Unit indices are one-based in R. */
+          INTEGER(res)[ii] = (idx < 0) ? NA_INTEGER : idx + 1;
+        }
+      }
+    }
+
+    if (!ok) {
+      error("Failed to read the CDF file.");
+    }
+
+    UNPROTECT(1); /* 'res' */
+
+    return res;
+  } /* R_affx_get_cdf_unit_indices() */
+
+
+
 
 } /** end extern C **/
 
 
 /***************************************************************************
  * HISTORY:
+ * 2026-10-16
+ * o Added R_affx_get_cdf_unit_indices() looking up units by name or by
+ *   name prefix in an index of the unit names.
+ * o Added argument 'readIsPm' to R_affx_get_cdf_units(), which returns
+ *   the PM flags of the cells read as attribute 'isPm'.
+ * o Added argument 'readCellCodes' to R_affx_get_cdf_flat(), which
+ *   returns the one-byte code of each cell, cf. R_affx_cdf_cell_code().
+ * o Added R_affx_get_cdf_flat() returning the units as flat columns.
+ * o Added argument 'cache' to R_affx_get_cdf_cell_indices() for reading
+ *   the cell indices from a memory mapped cache file.
  * 2014-10-28
  * o BUG FIX: Argument 'unitIndices' to R_affx_get_cdf_file_qc()  and
      R_affx_get_cdf_file() could contain elements out of range [1,J].
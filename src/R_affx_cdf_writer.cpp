@@ -0,0 +1,456 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+using namespace std;
+
+#include <Rdefines.h>
+
+/* The output buffer is written to the file whenever it is this large. */
+#define CDF_WRITE_BUFFER_SIZE (4*1048576)
+
+/* The length of unit and group names in XDA CDF files */
+#define CDF_NAME_LENGTH 64
+
+static const char *R_affx_cdf_unit_types[] = {
+  "unknown", "expression", "genotyping", "resequencing", "tag",
+  "copynumber", "genotypingcontrol", "expressioncontrol", NULL
+};
+
+static const char *R_affx_cdf_directions[] = {
+  "nodirection", "sense", "antisense", "unknown", NULL
+};
+
+static const char *R_affx_cdf_qc_unit_types[] = {
+  "unknown", "checkerboardNegative", "checkerboardPositive",
+  "hybeNegative", "hybePositive", "textFeaturesNegative",
+  "textFeaturesPositive", "centralNegative", "centralPositive",
+  "geneExpNegative", "geneExpPositive", "cycleFidelityNegative",
+  "cycleFidelityPositive", "centralCrossNegative", "centralCrossPositive",
+  "crossHybeNegative", "crossHybePositive", "SpatialNormNegative",
+  "SpatialNormPositive", NULL
+};
+
+/* The element of a list with the given name, or R_NilValue. */
+static SEXP
+R_affx_cdf_field(SEXP list, const char *name)
+{
+  SEXP names = getAttrib(list, R_NamesSymbol);
+  if (isNull(names))
+    return R_NilValue;
+  for (int i = 0; i < length(list); i++) {
+    if (strcmp(CHAR(STRING_ELT(names, i)), name) == 0)
+      return VECTOR_ELT(list, i);
+  }
+  return R_NilValue;
+}
+
+/* Element 'i' of a numeric or logical vector, as as.integer() does. */
+static int
+R_affx_cdf_int(SEXP x, int i)
+{
+  double d;
+
+  switch (TYPEOF(x)) {
+  case INTSXP:
+    return INTEGER(x)[i];
+  case LGLSXP:
+    return LOGICAL(x)[i];
+  case REALSXP:
+    d = REAL(x)[i];
+    if (ISNAN(d) || d >= 2147483648.0 || d <= -2147483649.0)
+      return NA_INTEGER;
+    return (int) d;
+  default:
+    return NA_INTEGER;
+  }
+}
+
+/*
+ * A scalar field of a unit or a group, which is either an integer or
+ * one of the given labels, which are encoded by their position.
+ */
+static bool
+R_affx_cdf_scalar(SEXP list, const char *name, const char **labels,
+                  int *value, string &msg)
+{
+  SEXP x = R_affx_cdf_field(list, name);
+
+  if (length(x) < 1) {
+    msg = string("field '") + name + "' is missing";
+    return false;
+  }
+  if (isString(x)) {
+    const char *label = CHAR(STRING_ELT(x, 0));
+    for (int i = 0; labels != NULL && labels[i] != NULL; i++) {
+      if (strcmp(label, labels[i]) == 0) {
+        *value = i;
+        return true;
+      }
+    }
+    msg = string("unknown value of field '") + name + "': " + label;
+    return false;
+  }
+  if (!isNumeric(x) && !isLogical(x)) {
+    msg = string("field '") + name + "' is neither numeric nor a string";
+    return false;
+  }
+  *value = R_affx_cdf_int(x, 0);
+  return true;
+}
+
+/* Appends the lower 'size' bytes of 'value' in little-endian order. */
+static inline void
+R_affx_cdf_put(vector<char> &buf, uint32_t value, int size)
+{
+  for (int i = 0; i < size; i++)
+    buf.push_back((char) ((value >> (8*i)) & 0xFF));
+}
+
+/* Appends a string as 'size' bytes, truncated or padded with nuls. */
+static void
+R_affx_cdf_put_string(vector<char> &buf, const char *str, int size)
+{
+  int n = (str == NULL) ? 0 : (int) strlen(str);
+  if (n > size)
+    n = size;
+  buf.insert(buf.end(), str, str + n);
+  buf.insert(buf.end(), size - n, '\0');
+}
+
+/* The number of cells of a group, which is the length of its 'x' field. */
+static int
+R_affx_cdf_group_cells(SEXP group)
+{
+  return length(R_affx_cdf_field(group, "x"));
+}
+
+/* The number of bytes of a unit in an XDA CDF file. */
+static int64_t
+R_affx_cdf_unit_size(SEXP unit)
+{
+  SEXP groups = R_affx_cdf_field(unit, "groups");
+  int64_t size = 20;
+  for (int j = 0; j < length(groups); j++)
+    size += 18 + CDF_NAME_LENGTH + 14 * (int64_t) R_affx_cdf_group_cells(VECTOR_ELT(groups, j));
+  return size;
+}
+
+/* The number of bytes of a QC unit in an XDA CDF file. */
+static int64_t
+R_affx_cdf_qc_unit_size(SEXP qcunit)
+{
+  return 6 + 7 * (int64_t) length(R_affx_cdf_field(qcunit, "x"));
+}
+
+/*
+ * Appends a unit, as returned by readCdf(), in the XDA format: the unit
+ * header (20 bytes), followed by each group, which is a group header
+ * (18 bytes), the group name (64 bytes) and its cells (14 bytes each).
+ */
+static bool
+R_affx_encode_cdf_unit(SEXP unit, vector<char> &buf, string &msg)
+{
+  int unitType, unitDirection, natoms, ncells, unitNumber, ncellsPerAtom;
+  SEXP groups, groupNames;
+  int j, k;
+
+  if (!isNewList(unit)) {
+    msg = "unit is not a list";
+    return false;
+  }
+  if (!R_affx_cdf_scalar(unit, "unittype", R_affx_cdf_unit_types, &unitType, msg) ||
+      !R_affx_cdf_scalar(unit, "unitdirection", R_affx_cdf_directions, &unitDirection, msg) ||
+      !R_affx_cdf_scalar(unit, "natoms", NULL, &natoms, msg) ||
+      !R_affx_cdf_scalar(unit, "ncells", NULL, &ncells, msg) ||
+      !R_affx_cdf_scalar(unit, "unitnumber", NULL, &unitNumber, msg) ||
+      !R_affx_cdf_scalar(unit, "ncellsperatom", NULL, &ncellsPerAtom, msg))
+    return false;
+  groups = R_affx_cdf_field(unit, "groups");
+  groupNames = getAttrib(groups, R_NamesSymbol);
+
+  R_affx_cdf_put(buf, unitType, 2);
+  R_affx_cdf_put(buf, unitDirection, 1);
+  R_affx_cdf_put(buf, natoms, 4);
+  R_affx_cdf_put(buf, length(groups), 4);
+  R_affx_cdf_put(buf, ncells, 4);
+  R_affx_cdf_put(buf, unitNumber, 4);
+  R_affx_cdf_put(buf, ncellsPerAtom, 1);
+
+  for (j = 0; j < length(groups); j++) {
+    SEXP group = VECTOR_ELT(groups, j);
+    int groupNatoms, groupNcellsPerAtom, groupDirection;
+
+    if (!isNewList(group)) {
+      msg = "group is not a list";
+      return false;
+    }
+    if (!R_affx_cdf_scalar(group, "natoms", NULL, &groupNatoms, msg) ||
+        !R_affx_cdf_scalar(group, "ncellsperatom", NULL, &groupNcellsPerAtom, msg) ||
+        !R_affx_cdf_scalar(group, "groupdirection", R_affx_cdf_directions, &groupDirection, msg))
+      return false;
+
+    /* The cell fields, which must all have the same lengths */
+    const char *names[4] = { "indexpos", "x", "y", "atom" };
+    SEXP fields[4];
+    int n = R_affx_cdf_group_cells(group);
+    for (k = 0; k < 4; k++) {
+      fields[k] = R_affx_cdf_field(group, names[k]);
+      if (length(fields[k]) != n || (n > 0 && !isNumeric(fields[k]))) {
+        msg = string("field '") + names[k] + "' of a group is not numeric or has the wrong length";
+        return false;
+      }
+    }
+    SEXP pbase = R_affx_cdf_field(group, "pbase");
+    SEXP tbase = R_affx_cdf_field(group, "tbase");
+    if ((!isNull(pbase) && (!isString(pbase) || length(pbase) != n)) ||
+        (!isNull(tbase) && (!isString(tbase) || length(tbase) != n))) {
+      msg = "fields 'pbase' and 'tbase' of a group must be character vectors of the same length as 'x'";
+      return false;
+    }
+
+    R_affx_cdf_put(buf, groupNatoms, 4);
+    R_affx_cdf_put(buf, n, 4);
+    R_affx_cdf_put(buf, groupNcellsPerAtom, 1);
+    R_affx_cdf_put(buf, groupDirection, 1);
+    /* The start and stop, i.e. the first fields of the first and the
+       last cells, from which readers also derive them */
+    R_affx_cdf_put(buf, n > 0 ? R_affx_cdf_int(fields[0], 0) : 0, 4);
+    R_affx_cdf_put(buf, n > 0 ? R_affx_cdf_int(fields[0], n - 1) : 0, 4);
+    R_affx_cdf_put_string(buf, isNull(groupNames) ? NULL : CHAR(STRING_ELT(groupNames, j)),
+                          CDF_NAME_LENGTH);
+
+    for (k = 0; k < n; k++) {
+      R_affx_cdf_put(buf, R_affx_cdf_int(fields[0], k), 4);
+      R_affx_cdf_put(buf, R_affx_cdf_int(fields[1], k), 2);
+      R_affx_cdf_put(buf, R_affx_cdf_int(fields[2], k), 2);
+      R_affx_cdf_put(buf, R_affx_cdf_int(fields[3], k), 4);
+      buf.push_back(isNull(pbase) ? '\0' : CHAR(STRING_ELT(pbase, k))[0]);
+      buf.push_back(isNull(tbase) ? '\0' : CHAR(STRING_ELT(tbase, k))[0]);
+    }
+  }
+  return true;
+}
+
+/*
+ * Appends a QC unit, as returned by readCdfQc(), in the XDA format: the
+ * QC unit header (6 bytes) followed by its cells (7 bytes each).
+ */
+static bool
+R_affx_encode_cdf_qc_unit(SEXP qcunit, vector<char> &buf, string &msg)
+{
+  int type, ncells, k;
+
+  if (!isNewList(qcunit)) {
+    msg = "QC unit is not a list";
+    return false;
+  }
+  if (!R_affx_cdf_scalar(qcunit, "type", R_affx_cdf_qc_unit_types, &type, msg) ||
+      !R_affx_cdf_scalar(qcunit, "ncells", NULL, &ncells, msg))
+    return false;
+
+  const char *names[5] = { "x", "y", "length", "pm", "background" };
+  SEXP fields[5];
+  int n = length(R_affx_cdf_field(qcunit, "x"));
+  for (k = 0; k < 5; k++) {
+    fields[k] = R_affx_cdf_field(qcunit, names[k]);
+    if (length(fields[k]) != n || (n > 0 && !isNumeric(fields[k]) && !isLogical(fields[k]))) {
+      msg = string("field '") + names[k] + "' of a QC unit is not numeric or has the wrong length";
+      return false;
+    }
+  }
+
+  R_affx_cdf_put(buf, type, 2);
+  R_affx_cdf_put(buf, ncells, 4);
+  for (k = 0; k < n; k++) {
+    R_affx_cdf_put(buf, R_affx_cdf_int(fields[0], k), 2);
+    R_affx_cdf_put(buf, R_affx_cdf_int(fields[1], k), 2);
+    R_affx_cdf_put(buf, R_affx_cdf_int(fields[2], k), 1);
+    R_affx_cdf_put(buf, R_affx_cdf_int(fields[3], k), 1);
+    R_affx_cdf_put(buf, R_affx_cdf_int(fields[4], k), 1);
+  }
+  return true;
+}
+
+/* Writes and empties the buffer, if it is at least 'minSize' bytes. */
+static bool
+R_affx_cdf_flush(ofstream &out, vector<char> &buf, size_t minSize, string &msg)
+{
+  if (buf.empty() || buf.size() < minSize)
+    return true;
+  out.write(&buf[0], buf.size());
+  buf.clear();
+  if (!out) {
+    msg = "could not write to the file";
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Writes an XDA CDF file.  The file offsets of all units are computed
+ * from the sizes of the units in a first pass, and the file is then
+ * written sequentially with a few large writes.
+ */
+static bool
+R_affx_write_cdf(const char *fileName, int nrows, int ncols, const char *refSeq,
+                 SEXP unitNames, SEXP units, SEXP qcUnits, string &msg)
+{
+  int nbrOfUnits = length(units), nbrOfQcUnits = length(qcUnits);
+  int lrefSeq = (int) strlen(refSeq);
+  int ii;
+  vector<char> buf;
+  string reason;
+  char number[32];
+
+  /* The header, the unit names and the unit offsets come first */
+  int64_t offset = 24 + lrefSeq + (int64_t) CDF_NAME_LENGTH * nbrOfUnits +
+    4 * (int64_t) (nbrOfQcUnits + nbrOfUnits);
+  vector<uint32_t> qcStarts(nbrOfQcUnits), starts(nbrOfUnits);
+  for (ii = 0; ii < nbrOfQcUnits; ii++) {
+    qcStarts[ii] = (uint32_t) offset;
+    offset += R_affx_cdf_qc_unit_size(VECTOR_ELT(qcUnits, ii));
+    if (offset > (int64_t) UINT32_MAX) {
+      msg = "the units do not fit in an XDA CDF file, which is limited to 4 GB";
+      return false;
+    }
+  }
+  for (ii = 0; ii < nbrOfUnits; ii++) {
+    starts[ii] = (uint32_t) offset;
+    offset += R_affx_cdf_unit_size(VECTOR_ELT(units, ii));
+    if (offset > (int64_t) UINT32_MAX) {
+      msg = "the units do not fit in an XDA CDF file, which is limited to 4 GB";
+      return false;
+    }
+  }
+
+  ofstream out(fileName, ios::out | ios::binary | ios::trunc);
+  if (!out) {
+    msg = "could not create the file";
+    return false;
+  }
+
+  R_affx_cdf_put(buf, 67, 4);
+  R_affx_cdf_put(buf, 1, 4);
+  R_affx_cdf_put(buf, ncols, 2);
+  R_affx_cdf_put(buf, nrows, 2);
+  R_affx_cdf_put(buf, nbrOfUnits, 4);
+  R_affx_cdf_put(buf, nbrOfQcUnits, 4);
+  R_affx_cdf_put(buf, lrefSeq, 4);
+  buf.insert(buf.end(), refSeq, refSeq + lrefSeq);
+  for (ii = 0; ii < nbrOfUnits; ii++) {
+    R_affx_cdf_put_string(buf, isNull(unitNames) ? NULL : CHAR(STRING_ELT(unitNames, ii)),
+                          CDF_NAME_LENGTH);
+    if (!R_affx_cdf_flush(out, buf, CDF_WRITE_BUFFER_SIZE, msg))
+      return false;
+  }
+  for (ii = 0; ii < nbrOfQcUnits; ii++)
+    R_affx_cdf_put(buf, qcStarts[ii], 4);
+  for (ii = 0; ii < nbrOfUnits; ii++)
+    R_affx_cdf_put(buf, starts[ii], 4);
+
+  for (ii = 0; ii < nbrOfQcUnits; ii++) {
+    if (!R_affx_encode_cdf_qc_unit(VECTOR_ELT(qcUnits, ii), buf, reason)) {
+      snprintf(number, sizeof(number), "%d", ii + 1);
+      msg = string("QC unit #") + number + ": " + reason;
+      return false;
+    }
+    if (!R_affx_cdf_flush(out, buf, CDF_WRITE_BUFFER_SIZE, msg))
+      return false;
+  }
+  for (ii = 0; ii < nbrOfUnits; ii++) {
+    if (!R_affx_encode_cdf_unit(VECTOR_ELT(units, ii), buf, reason)) {
+      snprintf(number, sizeof(number), "%d", ii + 1);
+      msg = string("unit #") + number + ": " + reason;
+      return false;
+    }
+    if (!R_affx_cdf_flush(out, buf, CDF_WRITE_BUFFER_SIZE, msg))
+      return false;
+  }
+  if (!R_affx_cdf_flush(out, buf, 0, msg))
+    return false;
+
+  out.close();
+  if (out.fail()) {
+    msg = "could not write to the file";
+    return false;
+  }
+  return true;
+}
+
+extern "C" {
+
+  /*
+   * Writes an XDA CDF file with the given header fields, unit names,
+   * units and QC units, which are structured as the output of readCdf()
+   * and readCdfQc().
+   */
+  SEXP R_affx_write_cdf_file(SEXP fname, SEXP nrows, SEXP ncols, SEXP refSeq,
+                             SEXP unitNames, SEXP units, SEXP qcUnits)
+  {
+    char msg[1024];
+    bool ok;
+
+    if (!isString(fname) || length(fname) != 1)
+      error("Argument 'fname' must be a single file name.");
+    if (!isString(refSeq) || length(refSeq) != 1)
+      error("Argument 'refSeq' must be a single string.");
+    if (!isNewList(units) || !isNewList(qcUnits))
+      error("Arguments 'units' and 'qcUnits' must be lists.");
+    if (!isNull(unitNames) && (!isString(unitNames) || length(unitNames) != length(units)))
+      error("Argument 'unitNames' must be NULL or a character vector with one name per unit.");
+
+    {
+      string reason;
+      ok = R_affx_write_cdf(CHAR(STRING_ELT(fname, 0)), INTEGER_VALUE(nrows),
+                            INTEGER_VALUE(ncols), CHAR(STRING_ELT(refSeq, 0)),
+                            unitNames, units, qcUnits, reason);
+      snprintf(msg, sizeof(msg), "%s", reason.c_str());
+    }
+    if (!ok)
+      error("Failed to write CDF file '%s': %s", CHAR(STRING_ELT(fname, 0)), msg);
+    return R_NilValue;
+  }
+
+  /*
+   * Encodes units (or QC units, if 'qc' is TRUE) in the XDA CDF format
+   * into a raw vector, which can be written to a connection as is.
+   */
+  SEXP R_affx_encode_cdf_units(SEXP units, SEXP qc)
+  {
+    SEXP res;
+    bool isQc = (INTEGER(qc)[0] != 0);
+    char msg[1024];
+    bool ok = true;
+    int ii;
+
+    if (!isNewList(units))
+      error("Argument 'units' must be a list.");
+
+    {
+      vector<char> buf;
+      string reason;
+      for (ii = 0; ii < length(units) && ok; ii++) {
+        if (isQc)
+          ok = R_affx_encode_cdf_qc_unit(VECTOR_ELT(units, ii), buf, reason);
+        else
+          ok = R_affx_encode_cdf_unit(VECTOR_ELT(units, ii), buf, reason);
+      }
+      if (ok) {
+        PROTECT(res = allocVector(RAWSXP, buf.size()));
+        if (!buf.empty())
+          memcpy(RAW(res), &buf[0], buf.size());
+      } else {
+        snprintf(msg, sizeof(msg), "%s", reason.c_str());
+      }
+    }
+    if (!ok)
+      error("Failed to encode %s #%d: %s", isQc ? "QC unit" : "unit", ii, msg);
+    UNPROTECT(1);
+    return res;
+  }
+
+}
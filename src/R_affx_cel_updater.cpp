@@ -0,0 +1,348 @@
+#include "GenericFileReader.h"
+#include "GenericData.h"
+#include "CELData.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace affymetrix_calvin_io;
+
+#include <Rdefines.h>
+
+/*
+ * Neighboring cells are updated together if there are no more than
+ * this many bytes between them, which are read and written back as is.
+ */
+#define CEL_UPDATE_MAX_GAP 65536
+
+/* The largest number of bytes updated at once. */
+#define CEL_UPDATE_MAX_RUN (8*1048576)
+
+/*
+ * A field of the cells, e.g. the intensities, which is 'size' bytes
+ * at 'offset' into records of 'stride' bytes that start at file
+ * position 'start'.  The new values are either doubles or integers.
+ */
+struct RAffxCelField {
+  int64_t start;
+  int stride;
+  int offset;
+  int size;
+  bool isFloat;
+  bool bigEndian;
+  const double *doubles;
+  const int *ints;
+};
+
+static void
+R_affx_put_cel_value(const RAffxCelField &field, int k, char *p)
+{
+  u_int32_t x;
+  int i;
+
+  if (field.isFloat) {
+    float f = (float) field.doubles[k];
+    memcpy(&x, &f, sizeof(x));
+  } else {
+    /* As writeBin(), i.e. the lower bytes of the integer */
+    if (field.doubles != NULL) {
+      double d = field.doubles[k];
+      x = (d == d) ? (u_int32_t) (int) d : 0;
+    } else {
+      x = (u_int32_t) field.ints[k];
+    }
+  }
+  for (i = 0; i < field.size; i++) {
+    unsigned char b = (unsigned char) ((x >> (8*i)) & 0xFF);
+    p[field.bigEndian ? field.size - 1 - i : i] = b;
+  }
+}
+
+/*
+ * Updates the fields of the cells, which all have the same records.
+ * Consecutive cells in 'indices' are coalesced into runs, each of
+ * which is read (unless all of its bytes are updated), patched and
+ * written back at once.  'indices' need not be ordered; if a cell is
+ * updated more than once, the last value is stored.
+ */
+static bool
+R_affx_update_cel_fields(fstream &fs, const int *indices, int nbrOfIndices,
+                         const vector<RAffxCelField> &fields, string &msg)
+{
+  int64_t start = fields[0].start;
+  int stride = fields[0].stride, recordBytes = 0;
+  int i = 0, j, m, first, last, k;
+  size_t f;
+  vector<char> buffer;
+
+  for (f = 0; f < fields.size(); f++)
+    recordBytes += fields[f].size;
+
+  while (i < nbrOfIndices) {
+    first = last = (indices == NULL) ? i : indices[i] - 1;
+    bool duplicated = false;
+    for (j = i + 1; j < nbrOfIndices; j++) {
+      k = (indices == NULL) ? j : indices[j] - 1;
+      if (k < last ||
+          (int64_t) (k - last - 1) * stride > CEL_UPDATE_MAX_GAP ||
+          (int64_t) (k - first + 1) * stride > CEL_UPDATE_MAX_RUN)
+        break;
+      if (k == last)
+        duplicated = true;
+      last = k;
+    }
+
+    size_t nbrOfBytes = (size_t) (last - first + 1) * stride;
+    streamoff pos = (streamoff) (start + (int64_t) first * stride);
+    buffer.resize(nbrOfBytes);
+    if (duplicated || j - i != last - first + 1 || recordBytes != stride) {
+      fs.seekg(pos);
+      fs.read(&buffer[0], nbrOfBytes);
+      if (!fs || (size_t) fs.gcount() != nbrOfBytes) {
+        msg = "could not read the cell data";
+        return false;
+      }
+    }
+    for (m = i; m < j; m++) {
+      k = (indices == NULL) ? m : indices[m] - 1;
+      char *record = &buffer[(size_t) (k - first) * stride];
+      for (f = 0; f < fields.size(); f++)
+        R_affx_put_cel_value(fields[f], m, record + fields[f].offset);
+    }
+    fs.seekp(pos);
+    fs.write(&buffer[0], nbrOfBytes);
+    if (!fs) {
+      msg = "could not write the cell data";
+      return false;
+    }
+    i = j;
+  }
+  return true;
+}
+
+/*
+ * Locates the fields of a binary (XDA, v4) CEL file.  The cell
+ * entries follow the header; each is an intensity (float), a standard
+ * deviation (float) and a pixel count (short), all little endian.
+ */
+static bool
+R_affx_get_xda_cel_fields(fstream &fs, int nbrOfCells, RAffxCelField *fields,
+                          string &msg)
+{
+  unsigned char b[4];
+  int32_t value, total = 0, i;
+  int64_t pos = 0;
+
+  /* magic, version, cols, rows, total, header, algorithm, parameters,
+     cell margin, number of outliers, number of masked, subgrids */
+  for (i = 0; i < 12 && fs; i++) {
+    fs.seekg((streamoff) pos);
+    fs.read((char *) b, 4);
+    value = (int32_t) ((u_int32_t) b[0] | ((u_int32_t) b[1] << 8) |
+                       ((u_int32_t) b[2] << 16) | ((u_int32_t) b[3] << 24));
+    pos += 4;
+    if (i == 4)
+      total = value;
+    else if (i >= 5 && i <= 7)
+      pos += value;
+  }
+  if (!fs) {
+    msg = "could not read the header of the CEL file";
+    return false;
+  }
+  if (total != nbrOfCells) {
+    msg = "the number of cells in the CEL file header does not match";
+    return false;
+  }
+  for (i = 0; i < 3; i++) {
+    fields[i].start = pos;
+    fields[i].stride = 10;
+    fields[i].bigEndian = false;
+  }
+  fields[0].offset = 0;
+  fields[0].size = 4;
+  fields[0].isFloat = true;
+  fields[1].offset = 4;
+  fields[1].size = 4;
+  fields[1].isFloat = true;
+  fields[2].offset = 8;
+  fields[2].size = 2;
+  fields[2].isFloat = false;
+  return true;
+}
+
+/*
+ * Locates the fields of a Command Console (Calvin) CEL file, which are
+ * the single columns of the intensity, standard deviation and pixel
+ * data sets of the first data group, all big endian.
+ */
+static bool
+R_affx_get_calvin_cel_fields(const char *fileName, int nbrOfCells,
+                             RAffxCelField *fields, bool *hasField,
+                             string &msg)
+{
+  GenericData data;
+  GenericFileReader reader;
+  const wstring names[3] = { CelIntensityLabel, CelStdDevLabel, CelPixelLabel };
+
+  try {
+    reader.SetFilename(fileName);
+    reader.ReadHeader(data);
+    DataGroupHeader &dgh = data.Header().GetDataGroup(0);
+    for (int i = 0; i < 3; i++) {
+      DataSetHeader *dsh = dgh.FindDataSetHeader(names[i]);
+      hasField[i] = (dsh != NULL && dsh->GetColumnCnt() == 1);
+      if (!hasField[i])
+        continue;
+      if (dsh->GetRowCnt() != nbrOfCells) {
+        msg = "the number of cells in the CEL file does not match";
+        return false;
+      }
+      ColumnInfo info = dsh->GetColumnInfo(0);
+      switch (info.GetColumnType()) {
+      case FloatColType:
+        fields[i].isFloat = true;
+        break;
+      case ShortColType:
+      case UShortColType:
+        fields[i].isFloat = false;
+        break;
+      default:
+        msg = "unsupported column type of data set " +
+          string(i == 0 ? "Intensity" : (i == 1 ? "StdDev" : "Pixel"));
+        return false;
+      }
+      fields[i].start = (int64_t) dsh->GetDataStartFilePos();
+      fields[i].stride = dsh->GetRowSize();
+      fields[i].offset = 0;
+      fields[i].size = info.GetSize();
+      fields[i].bigEndian = true;
+    }
+  } catch (...) {
+    msg = "could not read the header of the CEL file";
+    return false;
+  }
+  return true;
+}
+
+static bool
+R_affx_update_cel(const char *fileName, int nbrOfCells, const int *indices,
+                  int nbrOfIndices, const double *intensities,
+                  const double *stdvs, const int *pixels, string &msg)
+{
+  RAffxCelField fields[3];
+  bool hasField[3] = { true, true, true };
+  bool isCalvin;
+  unsigned char magic;
+  int i;
+
+  for (i = 0; i < nbrOfIndices && indices != NULL; i++) {
+    if (indices[i] < 1 || indices[i] > nbrOfCells) {
+      msg = "cell index out of range";
+      return false;
+    }
+  }
+
+  fstream fs(fileName, ios::in | ios::out | ios::binary);
+  if (!fs) {
+    msg = "could not open the CEL file for updating";
+    return false;
+  }
+  fs.read((char *) &magic, 1);
+  isCalvin = (fs && magic == 59);
+  if (!fs || !(isCalvin || magic == 64)) {
+    msg = "only binary (XDA and Calvin) CEL files can be updated";
+    return false;
+  }
+
+  if (isCalvin) {
+    if (!R_affx_get_calvin_cel_fields(fileName, nbrOfCells, fields, hasField, msg))
+      return false;
+  } else {
+    if (!R_affx_get_xda_cel_fields(fs, nbrOfCells, fields, msg))
+      return false;
+  }
+  fields[0].doubles = intensities;
+  fields[0].ints = NULL;
+  fields[1].doubles = stdvs;
+  fields[1].ints = NULL;
+  fields[2].doubles = NULL;
+  fields[2].ints = pixels;
+
+  /* The fields to update, grouped by the records they are in */
+  vector<vector<RAffxCelField> > groups;
+  for (i = 0; i < 3; i++) {
+    if (fields[i].doubles == NULL && fields[i].ints == NULL)
+      continue;
+    if (!hasField[i]) {
+      msg = string("the CEL file has no ") +
+        (i == 0 ? "intensities" : (i == 1 ? "standard deviations" : "pixel counts"));
+      return false;
+    }
+    size_t g;
+    for (g = 0; g < groups.size(); g++) {
+      if (groups[g][0].start == fields[i].start && groups[g][0].stride == fields[i].stride)
+        break;
+    }
+    if (g == groups.size())
+      groups.push_back(vector<RAffxCelField>());
+    groups[g].push_back(fields[i]);
+  }
+
+  for (size_t g = 0; g < groups.size(); g++) {
+    if (!R_affx_update_cel_fields(fs, indices, nbrOfIndices, groups[g], msg))
+      return false;
+  }
+  fs.close();
+  if (fs.fail()) {
+    msg = "could not write the CEL file";
+    return false;
+  }
+  return true;
+}
+
+extern "C" {
+
+  /*
+   * Updates the intensities, standard deviations and/or pixel counts
+   * of cells of a binary (XDA or Calvin) CEL file in place.  The
+   * (one-based) cell indices are either NULL, for all cells, or an
+   * integer vector.  Fields that are NULL are not updated.
+   */
+  SEXP R_affx_update_cel_file(SEXP fname, SEXP nbrOfCells, SEXP indices,
+                              SEXP intensities, SEXP stdvs, SEXP pixels)
+  {
+    int nCells = INTEGER_VALUE(nbrOfCells), n;
+    char msg[1024];
+    bool ok;
+
+    if (!isString(fname) || length(fname) != 1)
+      error("Argument 'fname' must be a single file name.");
+    n = isNull(indices) ? nCells : length(indices);
+    if (!isNull(indices) && !isInteger(indices))
+      error("Argument 'indices' must be NULL or an integer vector.");
+    if (!isNull(intensities) && (!isReal(intensities) || length(intensities) != n))
+      error("Argument 'intensities' must be NULL or a double vector of length %d.", n);
+    if (!isNull(stdvs) && (!isReal(stdvs) || length(stdvs) != n))
+      error("Argument 'stdvs' must be NULL or a double vector of length %d.", n);
+    if (!isNull(pixels) && (!isInteger(pixels) || length(pixels) != n))
+      error("Argument 'pixels' must be NULL or an integer vector of length %d.", n);
+
+    {
+      string reason;
+      ok = R_affx_update_cel(CHAR(STRING_ELT(fname, 0)), nCells,
+                             isNull(indices) ? NULL : INTEGER(indices), n,
+                             isNull(intensities) ? NULL : REAL(intensities),
+                             isNull(stdvs) ? NULL : REAL(stdvs),
+                             isNull(pixels) ? NULL : INTEGER(pixels), reason);
+      snprintf(msg, sizeof(msg), "%s", reason.c_str());
+    }
+    if (!ok)
+      error("Failed to update CEL file '%s': %s", CHAR(STRING_ELT(fname, 0)), msg);
+    return R_NilValue;
+  }
+
+}
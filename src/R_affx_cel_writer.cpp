@@ -0,0 +1,380 @@
+#include "CELFileWriter.h"
+#include "CalvinCelFileWriter.h"
+#include "CELData.h"
+#include "GenericDataTypes.h"
+#include "AffymetrixParameterConsts.h"
+#include "CELAlgorithmParameterNames.h"
+#include "StringUtils.h"
+#include "FileUtils.h"
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace affxcel;
+using namespace affymetrix_calvin_io;
+using namespace affymetrix_calvin_parameter;
+using namespace affymetrix_calvin_utilities;
+
+#include <Rdefines.h>
+
+/*
+ * A CEL file that is being written, one chunk of cells at a time,
+ * either in the XDA (v4) or in the Command Console (Calvin) format.
+ * The cells are written to a temporary file, which is renamed to the
+ * CEL file only once all cells have been written.
+ */
+struct RAffxCelWriter {
+  string fileName;
+  string tmpFileName;
+  int nbrOfCells;
+  int nbrOfCellsWritten;
+  CCELFileWriter *xda;
+  CelFileData *calvinData;
+  CelFileWriter *calvin;
+  vector<float> floats;
+  vector<int16_t> shorts;
+};
+
+static void
+R_affx_free_cel_writer(RAffxCelWriter *w)
+{
+  if (w->xda != NULL) {
+    delete w->xda;
+    w->xda = NULL;
+  }
+  /* Deleting the Calvin writer closes the file */
+  if (w->calvin != NULL) {
+    delete w->calvin;
+    w->calvin = NULL;
+  }
+  if (w->calvinData != NULL) {
+    delete w->calvinData;
+    w->calvinData = NULL;
+  }
+}
+
+/* A writer that was never closed leaves no CEL file behind */
+static void
+R_affx_cel_writer_finalizer(SEXP ptr)
+{
+  RAffxCelWriter *w = (RAffxCelWriter *) R_ExternalPtrAddr(ptr);
+  if (w == NULL)
+    return;
+  if (w->xda != NULL)
+    w->xda->CloseXDABCel();
+  R_affx_free_cel_writer(w);
+  remove(w->tmpFileName.c_str());
+  delete w;
+  R_ClearExternalPtr(ptr);
+}
+
+static RAffxCelWriter *
+R_affx_get_cel_writer(SEXP ptr)
+{
+  RAffxCelWriter *w = NULL;
+  if (TYPEOF(ptr) == EXTPTRSXP)
+    w = (RAffxCelWriter *) R_ExternalPtrAddr(ptr);
+  if (w == NULL)
+    error("The CEL file writer is closed or invalid.");
+  return w;
+}
+
+static bool
+R_affx_open_xda_cel(RAffxCelWriter *w, const char *fileName, int rows,
+                    int cols, const char *chipType, const char *datHeader,
+                    const char *algorithm, SEXP paramTags, SEXP paramValues,
+                    int cellMargin, string &msg)
+{
+  CCELFileWriter *cel = new CCELFileWriter();
+  w->xda = cel;
+  cel->SetFileName(fileName);
+  cel->SetHeaderDimensions(rows, cols);
+  cel->SetAlgorithmName(algorithm);
+  for (int i = 0; i < length(paramTags); i++)
+    cel->SetAddAlgorithmParameter(CHAR(STRING_ELT(paramTags, i)),
+                                  CHAR(STRING_ELT(paramValues, i)));
+  cel->SetMargin(cellMargin);
+  cel->SetDatHeader(datHeader);
+  cel->SetChipType(chipType);
+  if (!cel->OpenXDABCel()) {
+    msg = cel->GetError();
+    return false;
+  }
+  return true;
+}
+
+static bool
+R_affx_open_calvin_cel(RAffxCelWriter *w, const char *fileName, int rows,
+                       int cols, const char *chipType, const char *datHeader,
+                       const char *algorithm, SEXP paramTags, SEXP paramValues,
+                       int cellMargin, string &msg)
+{
+  try {
+    CelFileData *data = new CelFileData(fileName);
+    w->calvinData = data;
+    data->SetRows(rows);
+    data->SetCols(cols);
+    data->SetArrayType(StringUtils::ConvertMBSToWCS(chipType));
+    data->SetAlgorithmName(StringUtils::ConvertMBSToWCS(algorithm));
+
+    ParameterNameValueType nvt;
+    for (int i = 0; i < length(paramTags); i++) {
+      wstring tag = StringUtils::ConvertMBSToWCS(CHAR(STRING_ELT(paramTags, i)));
+      if (tag == CELLMARGIN_PARAM_NAME)
+        continue;
+      nvt.SetName(tag);
+      nvt.SetValueText(StringUtils::ConvertMBSToWCS(CHAR(STRING_ELT(paramValues, i))));
+      data->AddAlgorithmParameter(nvt);
+    }
+    nvt.SetName(CELLMARGIN_PARAM_NAME);
+    nvt.SetValueInt32(cellMargin);
+    data->AddAlgorithmParameter(nvt);
+
+    /* The DAT header is a parameter of the scan acquisition parent header */
+    if (datHeader[0] != '\0') {
+      GenericDataHeader parent;
+      parent.SetFileTypeId(SCAN_ACQUISITION_DATA_TYPE);
+      nvt.SetName(DAT_HEADER_PARAM_NAME);
+      nvt.SetValueText(StringUtils::ConvertMBSToWCS(datHeader));
+      parent.AddNameValParam(nvt);
+      data->GetFileHeader()->GetGenericDataHdr()->AddParent(parent);
+    }
+
+    data->SetIntensityCount(w->nbrOfCells);
+    data->SetStdDevCount(w->nbrOfCells);
+    data->SetPixelCount(w->nbrOfCells);
+    data->SetOutlierCount(0);
+    data->SetMaskCount(0);
+    w->calvin = new CelFileWriter(*data);
+  } catch (...) {
+    msg = "could not create the file";
+    return false;
+  }
+  return true;
+}
+
+static bool
+R_affx_write_cel_cells(RAffxCelWriter *w, int n, SEXP intensities,
+                       SEXP stdvs, SEXP pixels, string &msg)
+{
+  const float *fi = NULL, *fs = NULL;
+  const int16_t *sp = NULL;
+  int i;
+
+  if (n == 0)
+    return true;
+
+  /* Values are converted to the types of the file, with NA pixel counts
+     as zeros, and written as one block per field */
+  w->floats.resize(2 * (size_t) n);
+  w->shorts.resize((size_t) n);
+  if (!isNull(intensities)) {
+    double *x = REAL(intensities);
+    for (i = 0; i < n; i++)
+      w->floats[i] = (float) x[i];
+    fi = &w->floats[0];
+  }
+  if (!isNull(stdvs)) {
+    double *x = REAL(stdvs);
+    for (i = 0; i < n; i++)
+      w->floats[n + i] = (float) x[i];
+    fs = &w->floats[n];
+  }
+  if (!isNull(pixels)) {
+    int *x = INTEGER(pixels);
+    for (i = 0; i < n; i++)
+      w->shorts[i] = (int16_t) (x[i] == NA_INTEGER ? 0 : x[i]);
+    sp = &w->shorts[0];
+  }
+
+  if (w->xda != NULL) {
+    if (!w->xda->WriteXDABEntries(fi, fs, sp, n)) {
+      msg = w->xda->GetError();
+      return false;
+    }
+    return true;
+  }
+
+  /* All data sets of a Calvin file are written for each chunk */
+  try {
+    if (fi == NULL || fs == NULL) {
+      for (i = 0; i < 2 * n; i++) {
+        if ((i < n && fi == NULL) || (i >= n && fs == NULL))
+          w->floats[i] = 0.0f;
+      }
+    }
+    if (sp == NULL) {
+      for (i = 0; i < n; i++)
+        w->shorts[i] = 0;
+    }
+    w->calvin->WriteIntensities(&w->floats[0], n);
+    w->calvin->WriteStdDevs(&w->floats[n], n);
+    w->calvin->WritePixels(&w->shorts[0], n);
+  } catch (...) {
+    msg = "could not write the cells";
+    return false;
+  }
+  return true;
+}
+
+extern "C" {
+
+  /*
+   * Creates a CEL file with the given header fields and returns a
+   * writer to which the cells are written in chunks.  Argument
+   * 'format' is either "xda" or "calvin".
+   */
+  SEXP R_affx_open_cel_writer(SEXP fname, SEXP format, SEXP rows, SEXP cols,
+                              SEXP chipType, SEXP datHeader, SEXP algorithm,
+                              SEXP paramTags, SEXP paramValues,
+                              SEXP cellMargin)
+  {
+    SEXP ptr;
+    char msg[1024];
+    bool ok;
+    int nrows = INTEGER_VALUE(rows), ncols = INTEGER_VALUE(cols);
+
+    if (!isString(fname) || length(fname) != 1)
+      error("Argument 'fname' must be a single file name.");
+    if (nrows < 1 || ncols < 1)
+      error("Number of rows and columns must be at least one: %d, %d", nrows, ncols);
+    if (nrows > INT_MAX / ncols)
+      error("Too many cells for a CEL file: %d rows times %d columns", nrows, ncols);
+    if (!isString(paramTags) || !isString(paramValues) ||
+        length(paramTags) != length(paramValues))
+      error("Arguments 'paramTags' and 'paramValues' must be character vectors of equal length.");
+
+    const char *fileName = CHAR(STRING_ELT(fname, 0));
+    bool isCalvin = (strcmp(CHAR(STRING_ELT(format, 0)), "calvin") == 0);
+
+    RAffxCelWriter *w = new RAffxCelWriter();
+    w->nbrOfCells = nrows * ncols;
+    w->nbrOfCellsWritten = 0;
+    w->xda = NULL;
+    w->calvinData = NULL;
+    w->calvin = NULL;
+    {
+      string reason;
+      w->fileName = fileName;
+      FILE *fp = FileUtils::OpenTempFile(fileName, w->tmpFileName);
+      if (fp == NULL) {
+        ok = false;
+        reason = "could not create the file";
+      } else {
+        fclose(fp);
+        if (isCalvin)
+          ok = R_affx_open_calvin_cel(w, w->tmpFileName.c_str(), nrows, ncols,
+                                      CHAR(STRING_ELT(chipType, 0)),
+                                      CHAR(STRING_ELT(datHeader, 0)),
+                                      CHAR(STRING_ELT(algorithm, 0)),
+                                      paramTags, paramValues,
+                                      INTEGER_VALUE(cellMargin), reason);
+        else
+          ok = R_affx_open_xda_cel(w, w->tmpFileName.c_str(), nrows, ncols,
+                                   CHAR(STRING_ELT(chipType, 0)),
+                                   CHAR(STRING_ELT(datHeader, 0)),
+                                   CHAR(STRING_ELT(algorithm, 0)),
+                                   paramTags, paramValues,
+                                   INTEGER_VALUE(cellMargin), reason);
+      }
+      snprintf(msg, sizeof(msg), "%s", reason.c_str());
+    }
+    if (!ok) {
+      R_affx_free_cel_writer(w);
+      remove(w->tmpFileName.c_str());
+      delete w;
+      error("Failed to create CEL file '%s': %s", fileName, msg);
+    }
+
+    PROTECT(ptr = R_MakeExternalPtr(w, R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(ptr, R_affx_cel_writer_finalizer, TRUE);
+    UNPROTECT(1);
+    return ptr;
+  }
+
+  /*
+   * Writes the next chunk of cells.  The intensities and standard
+   * deviations are NULL or double vectors, the pixel counts NULL or
+   * an integer vector, all of the same length; fields that are NULL
+   * are written as zeros.  Returns the number of cells written so far.
+   */
+  SEXP R_affx_write_cel_chunk(SEXP ptr, SEXP intensities, SEXP stdvs,
+                              SEXP pixels)
+  {
+    RAffxCelWriter *w = R_affx_get_cel_writer(ptr);
+    char msg[1024];
+    bool ok;
+    int n = -1;
+
+    if (!isNull(intensities)) {
+      if (!isReal(intensities))
+        error("Argument 'intensities' must be NULL or a double vector.");
+      n = length(intensities);
+    }
+    if (!isNull(stdvs)) {
+      if (!isReal(stdvs) || (n >= 0 && length(stdvs) != n))
+        error("Argument 'stdvs' must be NULL or a double vector of the same length as the other fields.");
+      n = length(stdvs);
+    }
+    if (!isNull(pixels)) {
+      if (!isInteger(pixels) || (n >= 0 && length(pixels) != n))
+        error("Argument 'pixels' must be NULL or an integer vector of the same length as the other fields.");
+      n = length(pixels);
+    }
+    if (n < 0)
+      error("At least one of 'intensities', 'stdvs' and 'pixels' must be given.");
+    if (n > w->nbrOfCells - w->nbrOfCellsWritten)
+      error("Cannot write %d more cells; only %d of the %d cells remain.",
+            n, w->nbrOfCells - w->nbrOfCellsWritten, w->nbrOfCells);
+
+    {
+      string reason;
+      ok = R_affx_write_cel_cells(w, n, intensities, stdvs, pixels, reason);
+      snprintf(msg, sizeof(msg), "%s", reason.c_str());
+    }
+    if (!ok)
+      error("Failed to write CEL file: %s", msg);
+    w->nbrOfCellsWritten += n;
+    return ScalarInteger(w->nbrOfCellsWritten);
+  }
+
+  /*
+   * Completes and closes the CEL file of a writer.  It is an error if
+   * not all cells have been written, in which case no CEL file is
+   * created.
+   */
+  SEXP R_affx_close_cel_writer(SEXP ptr)
+  {
+    RAffxCelWriter *w = R_affx_get_cel_writer(ptr);
+    char msg[1024];
+    bool ok = true;
+    int nbrOfCells = w->nbrOfCells, nbrOfCellsWritten = w->nbrOfCellsWritten;
+
+    msg[0] = '\0';
+    if (w->xda != NULL) {
+      ok = w->xda->CloseXDABCel();
+      if (!ok)
+        snprintf(msg, sizeof(msg), "%s", w->xda->GetError().c_str());
+    }
+    R_affx_free_cel_writer(w);
+    ok = ok && (nbrOfCellsWritten == nbrOfCells);
+    if (!FileUtils::CommitTempFile(ok, w->tmpFileName, w->fileName.c_str()) && ok) {
+      ok = false;
+      snprintf(msg, sizeof(msg), "could not rename '%s' to '%s'",
+               w->tmpFileName.c_str(), w->fileName.c_str());
+    }
+    delete w;
+    R_ClearExternalPtr(ptr);
+
+    if (nbrOfCellsWritten != nbrOfCells)
+      error("Failed to complete CEL file: only %d of the %d cells were written.",
+            nbrOfCellsWritten, nbrOfCells);
+    if (!ok)
+      error("Failed to complete CEL file: %s", msg);
+    return R_NilValue;
+  }
+
+}
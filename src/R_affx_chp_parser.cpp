@@ -1,6 +1,7 @@
 #include "FusionCHPData.h"
 #include "FusionCHPLegacyData.h"
 #include "FusionCHPMultiDataData.h"
+#include "FusionCHPMultiDataAccessor.h"
 #include "FusionCHPQuantificationData.h"
 #include "FusionCHPQuantificationDetectionData.h"
 #include "FusionCHPDataAdapterInterface.h"
@@ -8,6 +9,7 @@
 #include "CHPReseqEntry.h"
 #include "StringUtils.h"
 #include "ParameterNameValueType.h"
+#include <algorithm>
 #include <string>
 
 
@@ -303,6 +305,13 @@ R_affx_GetCHPUniversalResults(FusionCHPLegacyData *chp)
   count = chp->GetHeader().GetNumProbeSets();
   PROTECT(ans = NEW_NUMERIC(count));
 
+  // GCOS files: copy the results in bulk
+  affxchp::CCHPFileData *gcos = chp->GetGCOSData();
+  if (gcos != NULL && gcos->GetUniversalBackgrounds(0, count, REAL(ans))) {
+    UNPROTECT(1);
+    return ans;
+  }
+
   for(i = 0; i < count; ++i) {
     chp->GetUniversalResults(i, rFU);
     REAL(ans)[i] = rFU.GetBackground();
@@ -349,21 +358,51 @@ R_affx_GetCHPGenotypingResults(FusionCHPLegacyData *chp)
   }
 
 
-  FusionGenotypeProbeSetResults f;
-  for(i=0; i<qNbr; i++) {
-    chp->GetGenotypingResults(i, f);
-    INTEGER(call)[i] = f.GetAlleleCall();
-    SET_STRING_ELT(callstr, i, mkChar(f.GetAlleleCallString().c_str()));
-    REAL(conf)[i] = f.GetConfidence();
+  // GCOS files: copy the results in bulk
+  typedef affxchp::CGenotypeProbeSetResults Results;
+  affxchp::CCHPFileData *gcos = chp->GetGCOSData();
+  if (gcos != NULL &&
+      gcos->GetGenotypingColumn(&Results::AlleleCall, 0, qNbr, INTEGER(call))) {
+    gcos->GetGenotypingColumn(&Results::Confidence, 0, qNbr, REAL(conf));
+    // There are only a few different calls
+    Results r;
+    SEXP callChars[256];
+    for (i = 0; i < 256; i++) callChars[i] = NULL;
+    for (i = 0; i < qNbr; i++) {
+      int c = INTEGER(call)[i];
+      if (callChars[c] == NULL) {
+        r.AlleleCall = (unsigned char) c;
+        callChars[c] = mkChar(r.GetAlleleCallString().c_str());
+      }
+      SET_STRING_ELT(callstr, i, callChars[c]);
+    }
     if( bWholeGenome ) {
-      REAL(ras1)[i] =  f.GetRAS1();
-      REAL(ras2)[i] =  f.GetRAS2();
+      gcos->GetGenotypingColumn(&Results::RAS1, 0, qNbr, REAL(ras1));
+      gcos->GetGenotypingColumn(&Results::RAS2, 0, qNbr, REAL(ras2));
     }
     if( bDynamicModel ) {
-      REAL(aa)[i] = f.GetPValueAA();
-      REAL(ab)[i] = f.GetPValueAB();
-      REAL(bb)[i] = f.GetPValueBB();
-      REAL(nocall)[i] = f.GetPValueNoCall();
+      gcos->GetGenotypingColumn(&Results::pvalue_AA, 0, qNbr, REAL(aa));
+      gcos->GetGenotypingColumn(&Results::pvalue_AB, 0, qNbr, REAL(ab));
+      gcos->GetGenotypingColumn(&Results::pvalue_BB, 0, qNbr, REAL(bb));
+      gcos->GetGenotypingColumn(&Results::pvalue_NoCall, 0, qNbr, REAL(nocall));
+    }
+  } else {
+    FusionGenotypeProbeSetResults f;
+    for(i=0; i<qNbr; i++) {
+      chp->GetGenotypingResults(i, f);
+      INTEGER(call)[i] = f.GetAlleleCall();
+      SET_STRING_ELT(callstr, i, mkChar(f.GetAlleleCallString().c_str()));
+      REAL(conf)[i] = f.GetConfidence();
+      if( bWholeGenome ) {
+        REAL(ras1)[i] =  f.GetRAS1();
+        REAL(ras2)[i] =  f.GetRAS2();
+      }
+      if( bDynamicModel ) {
+        REAL(aa)[i] = f.GetPValueAA();
+        REAL(ab)[i] = f.GetPValueAB();
+        REAL(bb)[i] = f.GetPValueBB();
+        REAL(nocall)[i] = f.GetPValueNoCall();
+      }
     }
   }
 
@@ -437,23 +476,41 @@ R_affx_GetCHPExpressionResults(FusionCHPLegacyData *chp)
   PROTECT(change = NEW_INTEGER(qNbr));
 
   // FIXME: probe set names need to come from PSI file
-  // FIXME: very inefficient -- function calls for each assignment
-  FusionExpressionProbeSetResults psResults;
-  for (int qIdx=0; qIdx<qNbr; ++qIdx) {
-    chp->GetExpressionResults(qIdx, psResults);
-    REAL(detectionPValue)[qIdx] = psResults.GetDetectionPValue();
-    REAL(signal)[qIdx] = psResults.GetSignal();
-    INTEGER(numPairs)[qIdx] = psResults.GetNumPairs();
-    INTEGER(numUsedPairs)[qIdx] = psResults.GetNumUsedPairs();
-    INTEGER(detection)[qIdx] = psResults.GetDetection();
-    LOGICAL(hasCompResults)[qIdx] =
-      (psResults.HasCompResults() ? TRUE : FALSE);
-    REAL(changePValue)[qIdx] = psResults.GetChangePValue();
-    REAL(signalLogRatio)[qIdx] = psResults.GetSignalLogRatio();
-    REAL(signalLogRatioLow)[qIdx] = psResults.GetSignalLogRatioLow();
-    REAL(signalLogRatioHigh)[qIdx] = psResults.GetSignalLogRatioHigh();
-    INTEGER(numCommonPairs)[qIdx] = psResults.GetNumCommonPairs();
-    INTEGER(change)[qIdx] = psResults.GetChange();
+  // GCOS files: copy the results in bulk
+  typedef affxchp::CExpressionProbeSetResults Results;
+  affxchp::CCHPFileData *gcos = chp->GetGCOSData();
+  if (gcos != NULL &&
+      gcos->GetExpressionColumn(&Results::DetectionPValue, 0, qNbr, REAL(detectionPValue))) {
+    gcos->GetExpressionColumn(&Results::Signal, 0, qNbr, REAL(signal));
+    gcos->GetExpressionColumn(&Results::NumPairs, 0, qNbr, INTEGER(numPairs));
+    gcos->GetExpressionColumn(&Results::NumUsedPairs, 0, qNbr, INTEGER(numUsedPairs));
+    gcos->GetExpressionColumn(&Results::Detection, 0, qNbr, INTEGER(detection));
+    gcos->GetExpressionColumn(&Results::m_HasCompResults, 0, qNbr, LOGICAL(hasCompResults));
+    gcos->GetExpressionColumn(&Results::ChangePValue, 0, qNbr, REAL(changePValue));
+    gcos->GetExpressionColumn(&Results::SignalLogRatio, 0, qNbr, REAL(signalLogRatio));
+    gcos->GetExpressionColumn(&Results::SignalLogRatioLow, 0, qNbr, REAL(signalLogRatioLow));
+    gcos->GetExpressionColumn(&Results::SignalLogRatioHigh, 0, qNbr, REAL(signalLogRatioHigh));
+    gcos->GetExpressionColumn(&Results::NumCommonPairs, 0, qNbr, INTEGER(numCommonPairs));
+    gcos->GetExpressionColumn(&Results::Change, 0, qNbr, INTEGER(change));
+  } else {
+    // FIXME: very inefficient -- function calls for each assignment
+    FusionExpressionProbeSetResults psResults;
+    for (int qIdx=0; qIdx<qNbr; ++qIdx) {
+      chp->GetExpressionResults(qIdx, psResults);
+      REAL(detectionPValue)[qIdx] = psResults.GetDetectionPValue();
+      REAL(signal)[qIdx] = psResults.GetSignal();
+      INTEGER(numPairs)[qIdx] = psResults.GetNumPairs();
+      INTEGER(numUsedPairs)[qIdx] = psResults.GetNumUsedPairs();
+      INTEGER(detection)[qIdx] = psResults.GetDetection();
+      LOGICAL(hasCompResults)[qIdx] =
+        (psResults.HasCompResults() ? TRUE : FALSE);
+      REAL(changePValue)[qIdx] = psResults.GetChangePValue();
+      REAL(signalLogRatio)[qIdx] = psResults.GetSignalLogRatio();
+      REAL(signalLogRatioLow)[qIdx] = psResults.GetSignalLogRatioLow();
+      REAL(signalLogRatioHigh)[qIdx] = psResults.GetSignalLogRatioHigh();
+      INTEGER(numCommonPairs)[qIdx] = psResults.GetNumCommonPairs();
+      INTEGER(change)[qIdx] = psResults.GetChange();
+    }
   }
 
   SEXP result;
@@ -769,54 +826,161 @@ R_affx_ReadCHP(FusionCHPQuantificationData *chp, bool isBrief)
   return(lst);
 }
 
-/* the enumerated data types for a MultiData object
+/*
+ * Returns all columns of a data set of a MultiData object, including
+ * the extra metric columns, as a named list of vectors.  Each column is
+ * decoded in one pass.  Integer columns become integer vectors, float
+ * and unsigned 32-bit columns numeric vectors, and text columns
+ * character vectors.  The probe set names are named "ProbeNames", as
+ * they always have been for genotype data.  As for genotype data, the
+ * "Call" and "Confidence" columns, if any, come first, followed by the
+ * probe set names; the other columns follow in the order of the file.
+ */
+SEXP
+R_affx_GetCHPMultiDataColumns(FusionCHPMultiDataData *chp,
+			      MultiDataType dataType)
+{
+  SEXP cols = R_NilValue, nms = R_NilValue, vals = R_NilValue;
+  int nrows = chp->GetEntryCount(dataType), ncols = 0, col, k, i, n = 0;
+  int nprotect = 0;
+  bool failed = false;
+  char msg[256] = "";
+  static const char *leading[3] = { "Call", "Confidence", "ProbeNames" };
+
+  /* Errors are signalled once the column names are released. */
+  {
+    vector<string> colNames;
+    vector<int> order;
+    try {
+      ncols = chp->GetNumColumns(dataType);
+      for (col = 0; col < ncols; col++) {
+	string name = StringUtils::ConvertWCSToMBS(
+	  chp->GetColumnInfo(dataType, col).GetName());
+	colNames.push_back(name == "ProbeSetName" ? "ProbeNames" : name);
+      }
+    } catch (...) {
+      failed = true;
+      snprintf(msg, sizeof(msg), "could not read data set %d of the CHP file",
+	       (int) dataType);
+    }
 
-ExpressionMultiDataType 	
-ExpressionControlMultiDataType 	
-GenotypeMultiDataType 	
-GenotypeControlMultiDataType 	
-CopyNumberMultiDataType 	
-CytoMultiDataType 
-  */
+    for (k = 0; k < 3 && !failed; k++) {
+      for (col = 0; col < ncols; col++) {
+	if (colNames[col] == leading[k]) {
+	  order.push_back(col);
+	  break;
+	}
+      }
+    }
+    for (col = 0; col < ncols && !failed; col++) {
+      if (find(order.begin(), order.end(), col) == order.end())
+	order.push_back(col);
+    }
+
+    if (!failed) {
+      PROTECT(cols = NEW_LIST(ncols));
+      PROTECT(nms = NEW_CHARACTER(ncols));
+      nprotect += 2;
+    }
+    for (k = 0; k < ncols && !failed; k++) {
+      col = order[k];
+      const string &name = colNames[col];
+
+      switch (chp->GetColumnInfo(dataType, col).GetColumnType()) {
+      case ByteColType:
+      case UByteColType:
+      case ShortColType:
+      case UShortColType:
+      case IntColType:
+	PROTECT(vals = NEW_INTEGER(nrows));
+	try {
+	  n = chp->GetColumnData(dataType, col, INTEGER(vals));
+	} catch (...) {
+	  failed = true;
+	}
+	for (i = n; i < nrows; i++)
+	  INTEGER(vals)[i] = NA_INTEGER;
+	break;
+      case UIntColType:
+      case FloatColType:
+	PROTECT(vals = NEW_NUMERIC(nrows));
+	try {
+	  n = chp->GetColumnData(dataType, col, REAL(vals));
+	} catch (...) {
+	  failed = true;
+	}
+	for (i = n; i < nrows; i++)
+	  REAL(vals)[i] = NA_REAL;
+	break;
+      default:
+	PROTECT(vals = NEW_CHARACTER(nrows));
+	{
+	  vector<string> values(nrows);
+	  try {
+	    n = chp->GetColumnData(dataType, col, &values[0]);
+	  } catch (...) {
+	    failed = true;
+	  }
+	  for (i = 0; i < n; i++)
+	    SET_STRING_ELT(vals, i, mkChar(values[i].c_str()));
+	}
+	break;
+      }
+      if (failed) {
+	snprintf(msg, sizeof(msg), "could not read column '%s' of the CHP file",
+		 name.c_str());
+	nprotect++;
+      } else {
+	SET_NAMED_ELT(cols, k, vals, nms, name.c_str());
+	UNPROTECT(1);
+      }
+    }
+  }
+  if (failed) {
+    UNPROTECT(nprotect);
+    error("%s", msg);
+  }
+  SET_NAMES(cols, nms);
+  UNPROTECT(2);
+  return cols;
+}
 
+/*
+ * The first four data types (Expression, ExpressionControl, Genotype
+ * and GenotypeControl) are always counted in "MultiDataTypeCounts";
+ * the others only if the file has them.  Every data type in the file
+ * is returned by R_affx_GetCHPMultiDataColumns(), under the name of
+ * its data set.
+ */
 SEXP 
 R_affx_ReadCHP(FusionCHPMultiDataData *chp, bool isBrief)
 {
-  SEXP lst, nms, cts, conf, call, probenames, genodata, gnms;
-  int lstIdx = 0, lstNbr, nExpr, nExprC, nGeno, nGenoC,
-    nprotect = 0, i, nDataTypes;
-
-  PROTECT(cts = NEW_INTEGER(4)); //FIXME: change if enum changes
-  nprotect++;
-  INTEGER(cts)[0] = nExpr = chp->GetEntryCount(ExpressionMultiDataType);
-  INTEGER(cts)[1] = nExprC = chp->GetEntryCount(ExpressionControlMultiDataType);
-  INTEGER(cts)[2] = nGeno = chp->GetEntryCount(GenotypeMultiDataType);
-  INTEGER(cts)[3] = nGenoC = chp->GetEntryCount(GenotypeControlMultiDataType);
-
-  PROTECT(nms = NEW_CHARACTER(4));
-  SET_STRING_ELT(nms, 0, mkChar("Expression"));
-  SET_STRING_ELT(nms, 1, mkChar("ExpressionControl"));
-  SET_STRING_ELT(nms, 2, mkChar("Genotype"));
-  SET_STRING_ELT(nms, 3, mkChar("GenotypeControl"));
-  SET_NAMES(cts, nms);
-  UNPROTECT(1);
-
-  /*  for now ignore the next two, as affxparser seems to be using an
-  old version of some files
-      INTEGER(cts)[4] = nCopy = chp->GetEntryCount(CopyNumberMultiDataType);
-      INTEGER(cts)[5] = nCyto = chp->GetEntryCount(CytoMultiDataType);
-  */
+  SEXP lst, nms, cts, cnms;
+  int lstIdx = 0, lstNbr, nCounts = 0, nDataTypes = 0, i, j, count;
+  int nTypes = sizeof(MultiDataDataTypes) / sizeof(MultiDataDataTypes[0]);
+
+  for (i = 0; i < nTypes; i++) {
+    count = chp->GetEntryCount(MultiDataDataTypes[i]);
+    if (count > 0) nDataTypes++;
+    if (count > 0 || i < 4) nCounts++;
+  }
 
-  nDataTypes = 0;
-  if(nExpr > 0) nDataTypes++;
-  if(nExprC > 0) nDataTypes++;
-  if(nGeno > 0) nDataTypes++;
-  if(nGenoC > 0) nDataTypes++;
+  PROTECT(cts = NEW_INTEGER(nCounts));
+  PROTECT(cnms = NEW_CHARACTER(nCounts));
+  for (i = 0, j = 0; i < nTypes; i++) {
+    count = chp->GetEntryCount(MultiDataDataTypes[i]);
+    if (count > 0 || i < 4) {
+      INTEGER(cts)[j] = count;
+      SET_STRING_ELT(cnms, j, mkChar(StringUtils::ConvertWCSToMBS(
+	       MultiDataDataSetNames[i]).c_str()));
+      j++;
+    }
+  }
+  SET_NAMES(cts, cnms);
 
   lstNbr = nDataTypes + 7;
   PROTECT(lst = NEW_LIST(lstNbr));
   PROTECT(nms = NEW_CHARACTER(lstNbr));
-  nprotect+=2;
  
   lstIdx = R_affx_AddCHPMeta(chp->FileId(), chp->GetAlgName(),
 			     chp->GetAlgVersion(), chp->GetArrayType(),
@@ -831,29 +995,18 @@ R_affx_ReadCHP(FusionCHPMultiDataData *chp, bool isBrief)
   SET_NAMED_ELT(lst, lstIdx, cts, nms, "MultiDataTypeCounts");
   lstIdx++;
 
-  if(nGeno > 0) {
-    PROTECT(conf = NEW_NUMERIC(nGeno));
-    PROTECT(call = NEW_INTEGER(nGeno)); //should be char vector
-    PROTECT(probenames = NEW_CHARACTER(nGeno));
-    for (i = 0; i < nGeno; i++) {
-      INTEGER(call)[i] = chp->GetGenoCall(GenotypeMultiDataType, i);
-      REAL(conf)[i] = chp->GetGenoConfidence(GenotypeMultiDataType, i);
-      SET_STRING_ELT(probenames, i,
-		     mkChar(chp->GetProbeSetName(GenotypeMultiDataType,
-						 i).c_str())); 
-    }
-    PROTECT(genodata = NEW_LIST(3));
-    PROTECT(gnms = NEW_CHARACTER(3));
-    SET_NAMED_ELT(genodata, 0, call, gnms, "Call");
-    SET_NAMED_ELT(genodata, 1, conf, gnms, "Confidence");
-    SET_NAMED_ELT(genodata, 2, probenames, gnms, "ProbeNames");
-    SET_NAMES(genodata, gnms);
-    SET_NAMED_ELT(lst, lstIdx, genodata, nms, "Genotype");
-    UNPROTECT(5);
+  for (i = 0; i < nTypes; i++) {
+    if (chp->GetEntryCount(MultiDataDataTypes[i]) == 0)
+      continue;
+    SET_ELEMENT(lst, lstIdx,
+		R_affx_GetCHPMultiDataColumns(chp, MultiDataDataTypes[i]));
+    SET_STRING_ELT(nms, lstIdx, mkChar(StringUtils::ConvertWCSToMBS(
+	     MultiDataDataSetNames[i]).c_str()));
+    lstIdx++;
   }
 
   SET_NAMES(lst, nms);
-  UNPROTECT(nprotect);
+  UNPROTECT(4);
   return(lst);
 }
 
@@ -963,4 +1116,118 @@ extern "C" {
     UNPROTECT(protectionCount);
     return result;
   }
+
+  /*
+   * Reads the genotype calls and confidences of SNPs from several
+   * multi-data CHP files into one matrix each, with one column per
+   * file (one row per file if 'transpose' is TRUE).  The SNPs are in
+   * the same order in all files; 'units' are their names or one-based
+   * indices, or NULL for all SNPs.  If 'cache' is TRUE, the index of
+   * the SNP names is kept in a file next to the first CHP file.  When
+   * OpenMP is available, the files are read concurrently by
+   * 'nbrOfThreads' threads.  Returns a list with the SNP names and the
+   * two matrices, or NULL for those not read.
+   */
+  SEXP
+  R_affx_get_chp_genotype_matrix(SEXP fnames, SEXP units, SEXP readCalls,
+				 SEXP readConfidences, SEXP transpose,
+				 SEXP cache, SEXP nbrOfThreads)
+  {
+    SEXP result, nms, names = R_NilValue, calls = R_NilValue,
+      confidences = R_NilValue;
+    int nbrOfFiles = length(fnames), nbrOfUnits, nbrOfSnps, ii, idx;
+    int i_nbrOfThreads = INTEGER(nbrOfThreads)[0], nprotect = 0;
+    bool b_transpose = (LOGICAL(transpose)[0] == TRUE);
+    char msg[1024] = "";
+
+    if (IS_CHARACTER(fnames) == FALSE || nbrOfFiles == 0)
+      error("argument '%s' should be '%s'", "fnames", "character");
+
+    /* Errors are signalled once the accessor and the buffers are
+       released. */
+    {
+      vector<string> filenames(nbrOfFiles);
+      for (ii = 0; ii < nbrOfFiles; ii++)
+	filenames[ii] = CHAR(STRING_ELT(fnames, ii));
+
+      FusionCHPMultiDataAccessor accessor;
+      string indexFileName;
+      if (LOGICAL(cache)[0] == TRUE)
+	indexFileName = filenames[0] + ".snpidx";
+      if (accessor.Initialize(filenames, indexFileName) == false)
+	snprintf(msg, sizeof(msg), "could not read multi data CHP file '%s'",
+		 filenames[0].c_str());
+      nbrOfSnps = accessor.GetSnpCount();
+
+      /* Map the units to SNP indices */
+      nbrOfUnits = (isNull(units) ? nbrOfSnps : length(units));
+      vector<int> snpIndices(nbrOfUnits);
+      for (ii = 0; ii < nbrOfUnits && msg[0] == '\0'; ii++) {
+	if (isNull(units)) {
+	  idx = ii;
+	} else if (IS_CHARACTER(units)) {
+	  idx = accessor.GetSnpIndex(CHAR(STRING_ELT(units, ii)));
+	  if (idx < 0)
+	    snprintf(msg, sizeof(msg), "unknown unit '%s'",
+		     CHAR(STRING_ELT(units, ii)));
+	} else {
+	  idx = INTEGER(units)[ii] - 1;
+	  if (idx < 0 || idx >= nbrOfSnps)
+	    snprintf(msg, sizeof(msg),
+		     "Argument 'units' contains an element out of range.");
+	}
+	snpIndices[ii] = idx;
+      }
+
+      if (msg[0] == '\0') {
+	PROTECT(names = NEW_CHARACTER(nbrOfUnits));
+	nprotect++;
+	for (ii = 0; ii < nbrOfUnits; ii++)
+	  SET_STRING_ELT(names, ii,
+			 mkChar(accessor.GetSnpName(snpIndices[ii]).c_str()));
+
+	if (LOGICAL(readCalls)[0] == TRUE) {
+	  if (b_transpose)
+	    calls = allocMatrix(INTSXP, nbrOfFiles, nbrOfUnits);
+	  else
+	    calls = allocMatrix(INTSXP, nbrOfUnits, nbrOfFiles);
+	}
+	PROTECT(calls);
+	nprotect++;
+	if (LOGICAL(readConfidences)[0] == TRUE) {
+	  if (b_transpose)
+	    confidences = allocMatrix(REALSXP, nbrOfFiles, nbrOfUnits);
+	  else
+	    confidences = allocMatrix(REALSXP, nbrOfUnits, nbrOfFiles);
+	}
+	PROTECT(confidences);
+	nprotect++;
+
+	vector<string> errors;
+	accessor.ExtractData(snpIndices,
+			     (isNull(calls) ? NULL : INTEGER(calls)),
+			     (isNull(confidences) ? NULL : REAL(confidences)),
+			     b_transpose, i_nbrOfThreads, errors);
+	for (ii = 0; ii < nbrOfFiles; ii++) {
+	  if (!errors[ii].empty()) {
+	    snprintf(msg, sizeof(msg), "%s", errors[ii].c_str());
+	    break;
+	  }
+	}
+      }
+    }
+    if (msg[0] != '\0') {
+      UNPROTECT(nprotect);
+      error("%s", msg);
+    }
+
+    PROTECT(result = NEW_LIST(3));
+    PROTECT(nms = NEW_CHARACTER(3));
+    SET_NAMED_ELT(result, 0, names, nms, "units");
+    SET_NAMED_ELT(result, 1, calls, nms, "calls");
+    SET_NAMED_ELT(result, 2, confidences, nms, "confidences");
+    SET_NAMES(result, nms);
+    UNPROTECT(nprotect + 2);
+    return result;
+  }
 }
@@ -2,14 +2,20 @@
 #include "ClfFile.h"
 #include "PgfFile.h"
 #include "TsvFile.h"
+#include <cstdio>
+#include <cstring>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace affx;
 
 #include "RAffxErrHandler.h"
+#include "R_affx_cdf_cache.h"
 #include <Rdefines.h>
 
+using affymetrix_calvin_utilities::FileUtils;
+
 int *
 new_int_elt(const char* symbol, int length, SEXP rho)
 {
@@ -69,181 +75,555 @@ R_affx_read_tsv_header(TsvFile& tsv)
   return headers;
 }
 
+// Parses an integer field of a CLF line, which must be the whole field.
+static bool
+R_affx_parse_clf_int(const char* s, const char* end, int* value)
+{
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = (*s++ == '-');
+    if (s == end) return false;
+    long v = 0;
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9' || v > 100000000L) return false;
+        v = 10 * v + (*s - '0');
+    }
+    *value = (int) (negative ? -v : v);
+    return true;
+}
+
+// Reads the data lines of a CLF file in large blocks, without going
+// through TsvFile for each line.  Returns the number of probes read,
+// or -1 if a line is not plain tab-separated integers, in which case
+// nothing should be assumed about the values assigned.
+static int
+R_affx_read_clf_data(ClfFile* clf, int *id, int *x, int *y, int n)
+{
+    TsvFile& tsv = clf->m_tsv;
+    int nColumns = tsv.getColumnCount(0);
+    int idCol = tsv.cname2cidx(0, "probe_id");
+    int xCol = tsv.cname2cidx(0, "x");
+    int yCol = tsv.cname2cidx(0, "y");
+    if (nColumns <= 0 || idCol < 0 || xCol < 0 || yCol < 0) return -1;
+    char sep = (char) tsv.m_optFieldSep;
+
+    FILE* fp = fopen(tsv.m_fileName.c_str(), "rb");
+    if (fp == NULL) return -1;
+    long offset = (long) (std::streamoff) tsv.m_fileDataPos;
+    if (offset < 0 || fseek(fp, offset, SEEK_SET) != 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    const size_t blockSize = 1 << 20;
+    vector<char> buffer(blockSize);
+    size_t kept = 0;
+    int count = 0;
+    bool ok = true, eof = false;
+    while (ok && !eof) {
+        size_t nread = fread(&buffer[kept], 1, buffer.size() - kept, fp);
+        size_t len = kept + nread;
+        eof = (nread == 0);
+        // Unless at the end of the file, only parse complete lines
+        size_t stop = len;
+        if (!eof) {
+            while (stop > 0 && buffer[stop-1] != '\n') stop--;
+            if (stop == 0) {
+                // A line longer than the buffer
+                buffer.resize(2 * buffer.size());
+                kept = len;
+                continue;
+            }
+        }
+        const char *s = len > 0 ? &buffer[0] : NULL, *bufEnd = s + stop;
+        while (ok && s < bufEnd) {
+            const char* eol = (const char*) memchr(s, '\n', bufEnd - s);
+            if (eol == NULL) eol = bufEnd;
+            const char* lineEnd = eol;
+            if (lineEnd > s && lineEnd[-1] == '\r') lineEnd--;
+            // Skip blank and comment lines
+            if (lineEnd > s && *s != '#') {
+                if (count >= n) {
+                    ok = false;
+                    break;
+                }
+                int col = 0;
+                const char* field = s;
+                while (ok && col < nColumns) {
+                    const char* fieldEnd = (const char*) memchr(field, sep, lineEnd - field);
+                    if (fieldEnd == NULL) fieldEnd = lineEnd;
+                    if (col == idCol) ok = R_affx_parse_clf_int(field, fieldEnd, &id[count]);
+                    else if (col == xCol) ok = R_affx_parse_clf_int(field, fieldEnd, &x[count]);
+                    else if (col == yCol) ok = R_affx_parse_clf_int(field, fieldEnd, &y[count]);
+                    col++;
+                    if (fieldEnd == lineEnd) break;
+                    field = fieldEnd + 1;
+                }
+                // Too few columns, or levels other than 0?
+                if (col <= idCol || col <= xCol || col <= yCol) ok = false;
+                count++;
+            }
+            s = eol + 1;
+        }
+        kept = len - stop;
+        if (kept > 0) memmove(&buffer[0], &buffer[stop], kept);
+        if (eof && kept > 0) ok = false;
+    }
+    fclose(fp);
+    return ok ? count : -1;
+}
+
 void
 R_affx_get_body(ClfFile* clf, SEXP rho)
 {
-  int nx, ny;
+  int nx, ny, n, k;
   nx = clf->getXMax() + 1;
   ny = clf->getYMax() + 1;
+  n = nx*ny;
 
   int *dims, *id, *x, *y;
   dims = new_int_elt("dims", 2, rho);
-  id = new_int_elt("id", nx*ny, rho);
-  x = new_int_elt("x", nx*ny, rho);
-  y = new_int_elt("y", nx*ny, rho);
+  id = new_int_elt("id", n, rho);
+  x = new_int_elt("x", n, rho);
+  y = new_int_elt("y", n, rho);
 
   dims[0] = nx; dims[1] = ny;
-  while(clf->next_probe() == TSV_OK) {
-    *id++ = clf->probe_id;
-    *x++ = clf->x;
-    *y++ = clf->y;
+
+  // (a) In a sequential CLF file, probe ids enumerate the cells row
+  //     by row, i.e. probe_id = y*cols + x + sequential, such that the
+  //     body is not needed.  Files with order 'row_major' are laid out
+  //     the same way (see ClfFile.cpp).  Assert that the first probes
+  //     of the first two rows agree before relying on it.
+  int sequential = clf->getSequential();
+  if (sequential >= 0 && !clf->getOrder().empty() && n > 0) {
+    int width = ny;
+    bool isSequential = true;
+    for (k = 0; isSequential && k <= width && k < n; k++) {
+      if (clf->next_probe() != TSV_OK) {
+        isSequential = false;
+      } else if (k == 0 || k == 1 || k == width) {
+        isSequential = (clf->probe_id == sequential + k &&
+                        clf->x == k % width && clf->y == k / width);
+      }
+    }
+    if (isSequential) {
+      for (k = 0; k < n; k++) {
+        id[k] = sequential + k;
+        x[k] = k % width;
+        y[k] = k / width;
+      }
+      return;
+    }
+  }
+
+  // (b) Otherwise, parse the body in bulk, ...
+  if (R_affx_read_clf_data(clf, id, x, y, n) >= 0) return;
+
+  // (c) ... or line by line, if not plain tab-separated integers.
+  clf->rewind();
+  k = 0;
+  while(k < n && clf->next_probe() == TSV_OK) {
+    id[k] = clf->probe_id;
+    x[k] = clf->x;
+    y[k] = clf->y;
+    k++;
   }
 }
 
+// A column of strings, stored in one block of characters.
+class R_affx_string_column
+{
+public:
+    R_affx_string_column() : m_start(1, 0) {}
+
+    void push_back(const string& str) {
+        m_chars.insert(m_chars.end(), str.begin(), str.end());
+        m_start.push_back(m_chars.size());
+    }
+
+    size_t size() const { return m_start.size() - 1; }
+
+    // Adds strings [first, last) of another column.
+    void append(const R_affx_string_column& column, size_t first, size_t last) {
+        size_t offset = m_chars.size() - column.m_start[first];
+        m_chars.insert(m_chars.end(), column.m_chars.begin() + column.m_start[first],
+                       column.m_chars.begin() + column.m_start[last]);
+        for (size_t i = first + 1; i <= last; i++) {
+            m_start.push_back(column.m_start[i] + offset);
+        }
+    }
+
+    // Defines the column as a character vector.  Consecutive equal
+    // strings, e.g. probe types, share the same CHARSXP.
+    void define(const char* symbol, SEXP rho) const {
+        int n = (int) size();
+        SEXP tmp = new_char_elt(symbol, n, rho);
+        SEXP prev = R_NilValue;
+        for (int i = 0; i < n; i++) {
+            size_t len = m_start[i+1] - m_start[i];
+            const char* str = len > 0 ? &m_chars[m_start[i]] : "";
+            if (prev == R_NilValue || (size_t) LENGTH(prev) != len ||
+                memcmp(CHAR(prev), str, len) != 0) {
+                prev = mkCharLen(str, (int) len);
+            }
+            SET_STRING_ELT(tmp, i, prev);
+        }
+    }
+
+    vector<char> m_chars;
+    vector<uint64_t> m_start;
+};
+
+// The body of a PGF file as columns.  The start atom of each probeset
+// and the start probe of each atom are zero-based and followed by the
+// total number of atoms and probes, respectively.
+struct R_affx_pgf_body
+{
+    vector<int> probeset_id, probeset_start_atom;
+    R_affx_string_column probeset_type, probeset_name;
+    vector<int> atom_id, atom_exon_position, atom_start_probe;
+    vector<int> probe_id, probe_gc_count, probe_length,
+        probe_interrogation_position;
+    R_affx_string_column probe_type, probe_sequence;
+
+    R_affx_pgf_body() : probeset_start_atom(1, 0), atom_start_probe(1, 0) {}
+
+    int nProbesets() const { return (int) probeset_id.size(); }
+    int nAtoms() const { return (int) atom_id.size(); }
+    int nProbes() const { return (int) probe_id.size(); }
+};
+
+// Reads the current probeset of a PGF file, with its atoms and probes.
+static void
+R_affx_read_pgf_probeset(PgfFile* pgf, R_affx_pgf_body& body)
+{
+    body.probeset_id.push_back(pgf->probeset_id);
+    body.probeset_type.push_back(pgf->probeset_type);
+    body.probeset_name.push_back(pgf->probeset_name);
+
+    while (pgf->next_atom() == TSV_OK) {
+        body.atom_id.push_back(pgf->atom_id);
+        // FIXME: where's atom_type? in docs but not header
+        body.atom_exon_position.push_back(pgf->exon_position);
+
+        while (pgf->next_probe() == TSV_OK) {
+            body.probe_id.push_back(pgf->probe_id);
+            body.probe_type.push_back(pgf->probe_type);
+            body.probe_gc_count.push_back(pgf->gc_count);
+            body.probe_length.push_back(pgf->probe_length);
+            body.probe_interrogation_position.push_back(pgf->interrogation_position);
+            body.probe_sequence.push_back(pgf->probe_sequence);
+        } // while (pgf->next_probe() == TSV_OK)
+        body.atom_start_probe.push_back(body.nProbes());
+    } // while (pgf->next_atom() == TSV_OK)
+    body.probeset_start_atom.push_back(body.nAtoms());
+}
+
+// Reads the probesets with the given sorted (one-based) indices, or all
+// of them if 'indices' is NULL, in a single pass over the PGF file.
+// Returns the number of probesets passed, which is all of them if the
+// file ended before the last index.
+static int
+R_affx_read_pgf_body(PgfFile* pgf, const int* indices, int nIndices,
+                     R_affx_pgf_body& body)
+{
+    int nProbesets = 0, i = 0;
+    while ((indices == NULL || i < nIndices) && pgf->next_probeset() == TSV_OK) {
+        ++nProbesets;
+        // Don't read this probeset?
+        if (indices != NULL && nProbesets < indices[i]) continue;
+        R_affx_read_pgf_probeset(pgf, body);
+        ++i;
+    }
+    // Count the remaining probesets for the error message
+    if (indices != NULL && i < nIndices) {
+        while (pgf->next_probeset() == TSV_OK) ++nProbesets;
+    }
+    return nProbesets;
+}
+
+// Copies the probesets with the given (one-based) indices into a body.
+static void
+R_affx_subset_pgf_body(const R_affx_pgf_body& src, const int* indices,
+                       int nIndices, R_affx_pgf_body& body)
+{
+    for (int i = 0; i < nIndices; i++) {
+        int ps = indices[i] - 1;
+        body.probeset_id.push_back(src.probeset_id[ps]);
+        body.probeset_type.append(src.probeset_type, ps, ps+1);
+        body.probeset_name.append(src.probeset_name, ps, ps+1);
+
+        int a0 = src.probeset_start_atom[ps], a1 = src.probeset_start_atom[ps+1];
+        int p0 = src.atom_start_probe[a0], p1 = src.atom_start_probe[a1];
+        int atomOffset = body.nAtoms() - a0, probeOffset = body.nProbes() - p0;
+        body.atom_id.insert(body.atom_id.end(), src.atom_id.begin() + a0, src.atom_id.begin() + a1);
+        body.atom_exon_position.insert(body.atom_exon_position.end(),
+            src.atom_exon_position.begin() + a0, src.atom_exon_position.begin() + a1);
+        for (int a = a0 + 1; a <= a1; a++) {
+            body.atom_start_probe.push_back(src.atom_start_probe[a] + probeOffset);
+        }
+        body.probe_id.insert(body.probe_id.end(), src.probe_id.begin() + p0, src.probe_id.begin() + p1);
+        body.probe_type.append(src.probe_type, p0, p1);
+        body.probe_gc_count.insert(body.probe_gc_count.end(),
+            src.probe_gc_count.begin() + p0, src.probe_gc_count.begin() + p1);
+        body.probe_length.insert(body.probe_length.end(),
+            src.probe_length.begin() + p0, src.probe_length.begin() + p1);
+        body.probe_interrogation_position.insert(body.probe_interrogation_position.end(),
+            src.probe_interrogation_position.begin() + p0,
+            src.probe_interrogation_position.begin() + p1);
+        body.probe_sequence.append(src.probe_sequence, p0, p1);
+        body.probeset_start_atom.push_back(a1 + atomOffset);
+    }
+}
+
+static void
+R_affx_define_int_elt(const char* symbol, const vector<int>& values, size_t n, SEXP rho)
+{
+    int *dest = new_int_elt(symbol, (int) n, rho);
+    if (n > 0) memcpy(dest, &values[0], n * sizeof(int));
+}
+
+// Defines the R vectors of a body in an environment.  Start indices
+// become one-based.
+static void
+R_affx_define_pgf_body(const R_affx_pgf_body& body, SEXP rho)
+{
+    int i, *start;
+    int nProbesets = body.nProbesets(), nAtoms = body.nAtoms();
+
+    // probeset
+    R_affx_define_int_elt("probesetId", body.probeset_id, nProbesets, rho);
+    body.probeset_type.define("probesetType", rho);
+    body.probeset_name.define("probesetName", rho);
+    start = new_int_elt("probesetStartAtom", nProbesets, rho);
+    for (i = 0; i < nProbesets; i++) start[i] = body.probeset_start_atom[i] + 1;
+    // atom
+    R_affx_define_int_elt("atomId", body.atom_id, nAtoms, rho);
+    // FIXME: where's atom_type? in docs but not .h or .cpp
+    R_affx_define_int_elt("atomExonPosition", body.atom_exon_position, nAtoms, rho);
+    start = new_int_elt("atomStartProbe", nAtoms, rho);
+    for (i = 0; i < nAtoms; i++) start[i] = body.atom_start_probe[i] + 1;
+    // probe
+    R_affx_define_int_elt("probeId", body.probe_id, body.nProbes(), rho);
+    body.probe_type.define("probeType", rho);
+    R_affx_define_int_elt("probeGcCount", body.probe_gc_count, body.nProbes(), rho);
+    R_affx_define_int_elt("probeLength", body.probe_length, body.nProbes(), rho);
+    R_affx_define_int_elt("probeInterrogationPosition",
+                          body.probe_interrogation_position, body.nProbes(), rho);
+    body.probe_sequence.define("probeSequence", rho);
+}
+
+
+// The binary body cache of a PGF file.  It holds a header, the
+// counts, then each column.  Integer columns are stored as is, string
+// columns as their offsets followed by their characters, all in the
+// native byte order.
+static const char R_AFFX_PGF_CACHE_MAGIC[8] = { 'A','F','F','X','P','G','F','\0' };
+#define R_AFFX_PGF_CACHE_VERSION 1
+#define R_AFFX_PGF_CACHE_BYTE_ORDER 0x01020304
+
+struct R_affx_pgf_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    RAffxCacheKey key;
+    int32_t nProbesets, nAtoms, nProbes, reserved;
+};
+
+static bool
+R_affx_write_pgf_ints(FILE* fp, const vector<int>& values)
+{
+    return values.empty() ||
+        fwrite(&values[0], sizeof(int), values.size(), fp) == values.size();
+}
+
+static bool
+R_affx_write_pgf_strings(FILE* fp, const R_affx_string_column& column)
+{
+    return fwrite(&column.m_start[0], sizeof(uint64_t), column.m_start.size(), fp) ==
+            column.m_start.size() &&
+        (column.m_chars.empty() ||
+         fwrite(&column.m_chars[0], 1, column.m_chars.size(), fp) == column.m_chars.size());
+}
+
+static bool
+R_affx_read_pgf_ints(FILE* fp, vector<int>& values, size_t n)
+{
+    values.resize(n);
+    return n == 0 || fread(&values[0], sizeof(int), n, fp) == n;
+}
+
+static bool
+R_affx_read_pgf_strings(FILE* fp, R_affx_string_column& column, size_t n)
+{
+    column.m_start.resize(n + 1);
+    if (fread(&column.m_start[0], sizeof(uint64_t), n + 1, fp) != n + 1)
+        return false;
+    // Offsets must be increasing, starting at zero.
+    if (column.m_start[0] != 0) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (column.m_start[i] > column.m_start[i+1]) return false;
+    }
+    uint64_t nchars = column.m_start[n];
+    if (nchars > (uint64_t) 1 << 40) return false;
+    column.m_chars.resize((size_t) nchars);
+    return nchars == 0 || fread(&column.m_chars[0], 1, (size_t) nchars, fp) == nchars;
+}
+
+// Start indices must be increasing and end with the total count.
+static bool
+R_affx_valid_pgf_starts(const vector<int>& start, int total)
+{
+    if (start.empty() || start[0] != 0 || start.back() != total) return false;
+    for (size_t i = 1; i < start.size(); i++) {
+        if (start[i-1] > start[i]) return false;
+    }
+    return true;
+}
+
+static bool
+R_affx_read_pgf_cache(const string& cacheFileName, const char* pgfFileName,
+                      R_affx_pgf_body& body)
+{
+    RAffxCacheKey key;
+    if (!FileUtils::GetFileKey(pgfFileName, key)) return false;
+    FILE* fp = fopen(cacheFileName.c_str(), "rb");
+    if (fp == NULL) return false;
+
+    R_affx_pgf_cache_header header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+        memcmp(header.magic, R_AFFX_PGF_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == R_AFFX_PGF_CACHE_VERSION &&
+        header.byteOrder == R_AFFX_PGF_CACHE_BYTE_ORDER &&
+        header.key == key &&
+        header.nProbesets >= 0 && header.nAtoms >= 0 && header.nProbes >= 0;
+    if (ok) {
+        size_t nps = header.nProbesets, na = header.nAtoms, np = header.nProbes;
+        ok = R_affx_read_pgf_ints(fp, body.probeset_id, nps) &&
+            R_affx_read_pgf_ints(fp, body.probeset_start_atom, nps + 1) &&
+            R_affx_read_pgf_strings(fp, body.probeset_type, nps) &&
+            R_affx_read_pgf_strings(fp, body.probeset_name, nps) &&
+            R_affx_read_pgf_ints(fp, body.atom_id, na) &&
+            R_affx_read_pgf_ints(fp, body.atom_exon_position, na) &&
+            R_affx_read_pgf_ints(fp, body.atom_start_probe, na + 1) &&
+            R_affx_read_pgf_ints(fp, body.probe_id, np) &&
+            R_affx_read_pgf_ints(fp, body.probe_gc_count, np) &&
+            R_affx_read_pgf_ints(fp, body.probe_length, np) &&
+            R_affx_read_pgf_ints(fp, body.probe_interrogation_position, np) &&
+            R_affx_read_pgf_strings(fp, body.probe_type, np) &&
+            R_affx_read_pgf_strings(fp, body.probe_sequence, np) &&
+            fgetc(fp) == EOF &&
+            R_affx_valid_pgf_starts(body.probeset_start_atom, header.nAtoms) &&
+            R_affx_valid_pgf_starts(body.atom_start_probe, header.nProbes);
+    }
+    fclose(fp);
+    if (!ok) body = R_affx_pgf_body();
+    return ok;
+}
+
+static bool
+R_affx_write_pgf_cache(const string& cacheFileName, const char* pgfFileName,
+                       const R_affx_pgf_body& body)
+{
+    R_affx_pgf_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, R_AFFX_PGF_CACHE_MAGIC, sizeof(header.magic));
+    header.version = R_AFFX_PGF_CACHE_VERSION;
+    header.byteOrder = R_AFFX_PGF_CACHE_BYTE_ORDER;
+    if (!FileUtils::GetFileKey(pgfFileName, header.key)) return false;
+    header.nProbesets = body.nProbesets();
+    header.nAtoms = body.nAtoms();
+    header.nProbes = body.nProbes();
+
+    string tmpFileName;
+    FILE* fp = FileUtils::OpenTempFile(cacheFileName.c_str(), tmpFileName);
+    if (fp == NULL) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        R_affx_write_pgf_ints(fp, body.probeset_id) &&
+        R_affx_write_pgf_ints(fp, body.probeset_start_atom) &&
+        R_affx_write_pgf_strings(fp, body.probeset_type) &&
+        R_affx_write_pgf_strings(fp, body.probeset_name) &&
+        R_affx_write_pgf_ints(fp, body.atom_id) &&
+        R_affx_write_pgf_ints(fp, body.atom_exon_position) &&
+        R_affx_write_pgf_ints(fp, body.atom_start_probe) &&
+        R_affx_write_pgf_ints(fp, body.probe_id) &&
+        R_affx_write_pgf_ints(fp, body.probe_gc_count) &&
+        R_affx_write_pgf_ints(fp, body.probe_length) &&
+        R_affx_write_pgf_ints(fp, body.probe_interrogation_position) &&
+        R_affx_write_pgf_strings(fp, body.probe_type) &&
+        R_affx_write_pgf_strings(fp, body.probe_sequence);
+    return FileUtils::CommitTempFile(fp, ok, tmpFileName, cacheFileName.c_str());
+}
+
 void
-R_affx_get_body(PgfFile* pgf, SEXP rho, SEXP indices)
+R_affx_get_body(PgfFile* pgf, SEXP rho, SEXP indices, const char* pgfFileName,
+                bool cache)
 {
-    int nProbesets, nAtoms, nProbes;
-    int i, prevIndex, currIndex, nextIndex=0, maxIndex;
+    int i, prevIndex, currIndex, maxIndex = 0;
     bool readAll = (indices == R_NilValue);
-    int *pindices; // Argument 'indices'
+    int nIndices = readAll ? 0 : length(indices);
+    const int *pindices = readAll ? NULL : INTEGER(indices); // Argument 'indices'
 
 
-    // (a) Find maximum index requested to allow for early stopping
-    if (readAll) {
-        maxIndex = R_LEN_T_MAX;
-    } else {
-        pindices = INTEGER(indices);
+    // (a) Validate 'indices', which must be sorted
+    if (!readAll) {
         prevIndex = 0;
-        maxIndex = 0;
-        for (i=0; i < length(indices); i++) {
+        for (i=0; i < nIndices; i++) {
 	    currIndex = pindices[i];
             if (currIndex == prevIndex) {
 	        error("Argument 'indices' must not contain duplicated entries: %d", currIndex);
             } else if (currIndex < prevIndex) {
 	        error("Argument 'indices' must be sorted.");
-	    } else if (currIndex > maxIndex) {
-                maxIndex = currIndex;
 	    }
             prevIndex = currIndex;
 	}
     }
 
-
-    // (b) Count the number of (probesets, atoms, probes) needed
-    nProbesets = 0, nAtoms = 0, nProbes = 0;
-    if (!readAll) currIndex = pindices[0];
-    i = 0;
-    while (nProbesets < maxIndex && pgf->next_probeset() == TSV_OK) {
-        ++nProbesets;
-
-        if (!readAll) {
-          // Don't read this probeset?
-	  if (nProbesets < currIndex) continue;
-
-          // Next index
-          currIndex = pindices[++i];
-	}
-
-        while (pgf->next_atom() == TSV_OK) {
-            ++nAtoms;
-            while (pgf->next_probe() == TSV_OK) {
-                ++nProbes;
+    // (b) Read the requested (probesets, atoms, probes) in a single
+    // pass, or all of them from the cache file.  Errors are signalled
+    // once the buffers are released.
+    int nProbesets;
+    char msg[256] = "";
+    {
+        R_affx_pgf_body body, subset;
+        const R_affx_pgf_body *result = &body;
+        if (cache) {
+            string cacheFileName = string(pgfFileName) + ".pgfbody";
+            if (!R_affx_read_pgf_cache(cacheFileName, pgfFileName, body)) {
+                R_affx_read_pgf_body(pgf, NULL, 0, body);
+                R_affx_write_pgf_cache(cacheFileName, pgfFileName, body);
             }
+            nProbesets = body.nProbesets();
+            if (!readAll && nIndices > 0 && pindices[nIndices-1] <= nProbesets &&
+                pindices[0] > 0) {
+                R_affx_subset_pgf_body(body, pindices, nIndices, subset);
+                result = &subset;
+            }
+        } else {
+            nProbesets = R_affx_read_pgf_body(pgf, pindices, nIndices, body);
         }
 
-        // No need to continue?
-        if (nProbesets >= maxIndex) break;
-    }
-    maxIndex = nProbesets;
-    pgf->rewind();
-
-    // (c) Setup/validate 'indices'
-    if (readAll) {
-        // indices <- 1:maxIndex
-        PROTECT(indices = allocVector(INTSXP, maxIndex));
-        pindices = INTEGER(indices);
-        for (i=0; i < length(indices); i++) {
-            pindices[i] = i+1; 
-        }
-    } else {
-        for (i=0; i < length(indices); i++) {
+        // (c) Validate 'indices'
+        maxIndex = nProbesets;
+        for (i=0; i < nIndices; i++) {
             currIndex = pindices[i];
             if (currIndex <= 0) {
-                error("Argument 'indices' contains a non-positive element: %d", currIndex);
+                sprintf(msg, "Argument 'indices' contains a non-positive element: %d", currIndex);
+                break;
             } else if (currIndex > maxIndex) {
-                error("Argument 'indices' contains an element out of range [1,%d]: %d", maxIndex, currIndex);
+                sprintf(msg, "Argument 'indices' contains an element out of range [1,%d]: %d", maxIndex, currIndex);
+                break;
             }
         }
-    }
-    
 
-    // (d) Allocate (probesets, atoms, probes)
-    SEXP probeset_type, probeset_name, // atom_type, 
-        probe_type, probe_sequence;
-    int *probeset_id, *probeset_start_atom, 
-        *atom_id, *atom_exon_position, *atom_start_probe,
-        *probe_id, *probe_gc_count, *probe_length, 
-        *probe_interrogation_position;
-    
-    // probeset
-    probeset_id = new_int_elt("probesetId", length(indices), rho);
-    probeset_type = new_char_elt("probesetType", length(indices), rho);
-    probeset_name = new_char_elt("probesetName", length(indices), rho);
-    probeset_start_atom = new_int_elt("probesetStartAtom", length(indices), rho);
-    // atom
-    atom_id = new_int_elt("atomId", nAtoms, rho);
-    // FIXME: where's atom_type? in docs but not .h or .cpp
-    //   atom_type = new_char_elt("atomType", nAtoms, rho);
-    atom_exon_position = new_int_elt("atomExonPosition", nAtoms, rho);
-    atom_start_probe = new_int_elt("atomStartProbe", nAtoms, rho);
-    // probe
-    probe_id = new_int_elt("probeId", nProbes, rho);
-    probe_type = new_char_elt("probeType", nProbes, rho);
-    probe_gc_count = new_int_elt("probeGcCount", nProbes, rho);
-    probe_length = new_int_elt("probeLength", nProbes, rho);
-    probe_interrogation_position = 
-        new_int_elt("probeInterrogationPosition", nProbes, rho);
-    probe_sequence = new_char_elt("probeSequence", nProbes, rho);
-
-
-    // (e) Read (probesets, atoms, probes)
-    nProbesets = 0;
-    nAtoms = nProbes = 0;
-    for (i=0; i < length(indices); i++) {
-        // Next index to read
-        nextIndex = pindices[i];
-  
-        // Skip to probeset of interest.
-        while (nProbesets < nextIndex && pgf->next_probeset() == TSV_OK) {
-          ++nProbesets;
+        // (d) Allocate and assign (probesets, atoms, probes)
+        if (msg[0] == '\0') {
+            R_affx_define_pgf_body(*result, rho);
         }
-  
-        // Sanity check
-        if (nProbesets < nextIndex) {
-          error("INTERNAL ERROR: Expected %d more probesets to skip in PGF file, but reached end of file.", nextIndex-nProbesets);
-        }
-  
-        // Read probeset
-        probeset_id[i] = pgf->probeset_id;
-        SET_STRING_ELT(probeset_type, i, mkChar(pgf->probeset_type.c_str()));
-        SET_STRING_ELT(probeset_name, i, mkChar(pgf->probeset_name.c_str()));
-        probeset_start_atom[i] = 1 + nAtoms;
-  
-        while (pgf->next_atom() == TSV_OK) {
-            atom_id[nAtoms] = pgf->atom_id;
-            // FIXME: where's atom_type? in docs but not header
-            atom_exon_position[nAtoms] = pgf->exon_position;
-            atom_start_probe[nAtoms] = 1 + nProbes;
-            ++nAtoms;
-
-            while (pgf->next_probe() == TSV_OK) {
-                probe_id[nProbes] = pgf->probe_id;
-                SET_STRING_ELT(probe_type, nProbes, 
-                               mkChar(pgf->probe_type.c_str()));
-                probe_gc_count[nProbes] = pgf->gc_count;
-                probe_length[nProbes] = pgf->probe_length;
-                probe_interrogation_position[nProbes] = 
-                    pgf->interrogation_position;
-                SET_STRING_ELT(probe_sequence, nProbes,
-                               mkChar(pgf->probe_sequence.c_str()));
-                ++nProbes;
-            } // while (pgf->next_probe() == TSV_OK)
-        } // while (pgf->next_atom() == TSV_OK)
-
-    } // for (i=0; ...)
-
-    if (readAll) UNPROTECT(1); // Temporarily allocated 'indices'.
+    }
+    if (msg[0] != '\0') {
+        error("%s", msg);
+    }
 }
 
 extern "C" {
@@ -294,7 +674,8 @@ extern "C" {
   }
 
   SEXP 
-  R_affx_get_pgf_file(SEXP fname, SEXP readBody, SEXP rho, SEXP indices)
+  R_affx_get_pgf_file(SEXP fname, SEXP readBody, SEXP rho, SEXP indices,
+                      SEXP cache)
   {
     if (IS_CHARACTER(fname) == FALSE || LENGTH(fname) != 1)
       error("argument '%s' should be '%s'", "fname",
@@ -304,6 +685,9 @@ extern "C" {
                "logical(1)");
     if (TYPEOF(rho) != ENVSXP)
       error("argument '%' should be '%s'", "rho", "environments");
+    if (IS_LOGICAL(cache) == FALSE || LENGTH(cache) != 1)
+      error("argument '%s' should be '%s'", "cache",
+               "logical(1)");
 
     const char *pgfFileName = CHAR(STRING_ELT(fname, 0));
 
@@ -320,7 +704,8 @@ extern "C" {
       defineVar(install("header"), tmp, rho);
       UNPROTECT(1);
       if (LOGICAL(readBody)[0] == TRUE) {
-          R_affx_get_body(pgf, rho, indices);
+          R_affx_get_body(pgf, rho, indices, pgfFileName,
+                          LOGICAL(cache)[0] == TRUE);
       }
       pgf->close();
       delete Err::popHandler();
@@ -61,7 +61,7 @@ void CDFData::Clear()
 		tocDataSet = 0;
 	}
 
-	nameToFilePosMap.clear();
+	nameIndex.Clear();
 }
 
 int32_t CDFData::GetFormatVersion()
@@ -265,19 +265,19 @@ void CDFData::PrepareForAccessByProbeSetName()
 		if (tocDataSet->Open())
 		{
 
-			// build the name-file position map
+			// build the name index; the file positions are read from the TOC
 			int32_t rows = tocDataSet->Rows();
 
-			std::wstring probeSetName;
-			u_int32_t filePos = 0;
+			WStringVector probeSetNames;
+			tocDataSet->GetData(TOCProbeSetNameCol, 0, rows, probeSetNames);
 
-			for (int32_t row = 0; row < rows; ++row)
-			{
-				tocDataSet->GetData(row, TOCProbeSetNameCol, probeSetName);
-				tocDataSet->GetData(row, TOCFilePosCol, filePos);
-
-				nameToFilePosMap[probeSetName] = filePos;
-			}
+			size_t nameBytes = 0;
+			for (size_t row = 0; row < probeSetNames.size(); ++row)
+				nameBytes += probeSetNames[row].size()*sizeof(wchar_t);
+			nameIndex.Clear();
+			nameIndex.Reserve((int32_t)probeSetNames.size(), nameBytes);
+			for (size_t row = 0; row < probeSetNames.size(); ++row)
+				nameIndex.Add(probeSetNames[row]);
 		}
 	}
 }
@@ -435,14 +435,16 @@ u_int32_t CDFData::GetTOCFilePosByName(const std::wstring& name)
 		throw e;
 	}
 
-	std::map<std::wstring, u_int32_t>::iterator ii = nameToFilePosMap.find(name);
-	if (ii == nameToFilePosMap.end())
+	int32_t row = nameIndex.Find(name);
+	if (row < 0)
 	{
 		ProbeSetNotFoundException e(L"Calvin",L"Default Description, Please Update!",affymetrix_calvin_utilities::DateTime::GetCurrentDateTime().ToString(),std::string(__FILE__),(u_int16_t)__LINE__,0);
 		throw e;
 	}
-	else
-		return ii->second;
+
+	u_int32_t filePos = (u_int32_t)-1;
+	tocDataSet->GetData(row, TOCFilePosCol, filePos);
+	return filePos;
 }
 
 std::wstring CDFData::GetProbeSetName(int32_t index)
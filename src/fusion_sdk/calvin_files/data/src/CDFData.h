@@ -29,6 +29,7 @@
 #include "calvin_files/data/src/GenericData.h"
 #include "calvin_files/parameter/src/AffymetrixParameterConsts.h"
 #include "calvin_files/portability/src/AffymetrixBaseTypes.h"
+#include "calvin_files/utils/src/StringIndex.h"
 //
 #include <cstring>
 #include <map>
@@ -298,13 +299,13 @@ private:
 	int32_t curIndex;
 
 	/*! file position of the current DataGroup */
-	u_int32_t curGroupFilePos;
+	u_int64_t curGroupFilePos;
 
 	/*! pointer to the table of contents DataSet */
 	DataSet* tocDataSet;
 
-	/*! map of probe set name to file position*/
-	std::map<std::wstring, u_int32_t> nameToFilePosMap;
+	/*! index of probe set name to table of contents row */
+	affymetrix_calvin_utilities::StringIndex nameIndex;
 
 	/*! Friend to the reader. */
 	friend class CDFFileReader;
@@ -544,6 +544,52 @@ bool CelFileData::GetNumPixels(int32_t cellIdxStart, int32_t count, Int16Vector&
 	return false;
 }
 
+/*
+ * Get the intensities for a range of cell indexes into a buffer.
+ */
+int32_t CelFileData::GetIntensities(int32_t cellIdxStart, int32_t count, float* values)
+{
+	if (count <= 0)
+		return 0;
+
+	PrepareIntensityPlane();
+	if (dpInten && dpInten->IsOpen())
+	{
+		if (intensityColumnType == FloatColType)
+			return dpInten->GetDataRaw(0, cellIdxStart, count, values);
+
+		// try u_int16_t or throw
+		Uint16Vector uint16Vector(count);
+		int32_t n = dpInten->GetDataRaw(0, cellIdxStart, count, &uint16Vector[0]);
+		for (int32_t i = 0; i < n; ++i)
+			values[i] = (float)uint16Vector[i];
+		return n;
+	}
+	return 0;
+}
+
+/*
+ * Get the standard deviations for a range of cell indexes into a buffer.
+ */
+int32_t CelFileData::GetStdev(int32_t cellIdxStart, int32_t count, float* values)
+{
+	PrepareStdevPlane();
+	if (dpStdev && dpStdev->IsOpen())
+		return dpStdev->GetDataRaw(0, cellIdxStart, count, values);
+	return 0;
+}
+
+/*
+ * Get the number of pixels for a range of cell indexes into a buffer.
+ */
+int32_t CelFileData::GetNumPixels(int32_t cellIdxStart, int32_t count, int16_t* values)
+{
+	PrepareNumPixelPlane();
+	if (dpPixels && dpPixels->IsOpen())
+		return dpPixels->GetDataRaw(0, cellIdxStart, count, values);
+	return 0;
+}
+
 /*
  * Get the outlier flags for a range of cell indexes.
  */
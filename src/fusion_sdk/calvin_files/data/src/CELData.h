@@ -294,6 +294,30 @@ public:
 	 */
 	bool GetNumPixels(int32_t cellIdxStart, int32_t count, Int16Vector& values);
 
+	/*! Get the intensities for a range of cell indexes into a caller allocated buffer.
+	 *	@param cellIdxStart Cell index of the first intensity to retrieve.
+	 *	@param count Number of intensities to retrieve.
+	 *	@param values Buffer of at least count elements.
+	 *	@return The number of intensities retrieved.
+	 */
+	int32_t GetIntensities(int32_t cellIdxStart, int32_t count, float* values);
+
+	/*! Get the standard deviations for a range of cell indexes into a caller allocated buffer.
+	 *	@param cellIdxStart Cell index of the first standard deviation to retrieve.
+	 *	@param count Number of cell standard deviations to retrieve.
+	 *	@param values Buffer of at least count elements.
+	 *	@return The number of standard deviations retrieved.
+	 */
+	int32_t GetStdev(int32_t cellIdxStart, int32_t count, float* values);
+
+	/*! Get the number of pixels for a range of cell indexes into a caller allocated buffer.
+	 *	@param cellIdxStart Cell index of the first pixel count to retrieve.
+	 *	@param count Number of cell pixels to retrieve.
+	 *	@param values Buffer of at least count elements.
+	 *	@return The number of pixel counts retrieved.
+	 */
+	int32_t GetNumPixels(int32_t cellIdxStart, int32_t count, int16_t* values);
+
 	/*! Get the outlier flags for a range of cell indexes.
 	 *	@param cellIdxStart Cell index of the first outlier flag to retrieve.
 	 *	@param count Number of cell outlier flags to retrieve.
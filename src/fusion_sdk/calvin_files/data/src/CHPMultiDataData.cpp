@@ -360,6 +360,104 @@ int32_t CHPMultiDataData::GetEntryCount(MultiDataType dataType)
 	return (h == NULL ? 0 : h->GetRowCnt());
 }
 
+int32_t CHPMultiDataData::GetNumColumns(MultiDataType dataType)
+{
+	DataSetInfo *info = OpenMultiDataDataSet(dataType);
+	return (info == NULL ? 0 : info->entries->Header().GetColumnCnt());
+}
+
+ColumnInfo CHPMultiDataData::GetColumnInfo(MultiDataType dataType, int col)
+{
+	DataSetInfo *info = OpenMultiDataDataSet(dataType);
+	if (info == NULL || col < 0 || col >= info->entries->Header().GetColumnCnt())
+	{
+		affymetrix_calvin_exceptions::ColumnIndexOutOfBoundsException e(L"Calvin",L"Default Description, Please Update!",affymetrix_calvin_utilities::DateTime::GetCurrentDateTime().ToString(),std::string(__FILE__),(u_int16_t)__LINE__,0);
+		throw e;
+	}
+	return info->entries->Header().GetColumnInfo(col);
+}
+
+/*
+ * Read a column in its stored type and convert the values.
+ */
+template<typename S, typename T> static int32_t GetConvertedColumnData(DataSet *entries, int col, T *values)
+{
+	std::vector<S> data(entries->Header().GetRowCnt());
+	int32_t n = (data.empty() ? 0 : entries->GetDataRaw(col, 0, (int32_t)data.size(), &data[0]));
+	for (int32_t i=0; i<n; i++)
+		values[i] = (T)data[i];
+	return n;
+}
+
+int32_t CHPMultiDataData::GetColumnData(MultiDataType dataType, int col, int32_t *values)
+{
+	DataSetInfo *info = OpenMultiDataDataSet(dataType);
+	switch (GetColumnInfo(dataType, col).GetColumnType())
+	{
+	case ByteColType:
+		return GetConvertedColumnData<int8_t>(info->entries, col, values);
+	case UByteColType:
+		return GetConvertedColumnData<u_int8_t>(info->entries, col, values);
+	case ShortColType:
+		return GetConvertedColumnData<int16_t>(info->entries, col, values);
+	case UShortColType:
+		return GetConvertedColumnData<u_int16_t>(info->entries, col, values);
+	case IntColType:
+		return info->entries->GetDataRaw(col, 0, info->entries->Header().GetRowCnt(), values);
+	default:
+		break;
+	}
+	affymetrix_calvin_exceptions::UnexpectedColumnTypeException e(L"Calvin",L"Default Description, Please Update!",affymetrix_calvin_utilities::DateTime::GetCurrentDateTime().ToString(),std::string(__FILE__),(u_int16_t)__LINE__,0);
+	throw e;
+}
+
+int32_t CHPMultiDataData::GetColumnData(MultiDataType dataType, int col, double *values)
+{
+	DataSetInfo *info = OpenMultiDataDataSet(dataType);
+	switch (GetColumnInfo(dataType, col).GetColumnType())
+	{
+	case ByteColType:
+		return GetConvertedColumnData<int8_t>(info->entries, col, values);
+	case UByteColType:
+		return GetConvertedColumnData<u_int8_t>(info->entries, col, values);
+	case ShortColType:
+		return GetConvertedColumnData<int16_t>(info->entries, col, values);
+	case UShortColType:
+		return GetConvertedColumnData<u_int16_t>(info->entries, col, values);
+	case IntColType:
+		return GetConvertedColumnData<int32_t>(info->entries, col, values);
+	case UIntColType:
+		return GetConvertedColumnData<u_int32_t>(info->entries, col, values);
+	case FloatColType:
+		return GetConvertedColumnData<float>(info->entries, col, values);
+	default:
+		break;
+	}
+	affymetrix_calvin_exceptions::UnexpectedColumnTypeException e(L"Calvin",L"Default Description, Please Update!",affymetrix_calvin_utilities::DateTime::GetCurrentDateTime().ToString(),std::string(__FILE__),(u_int16_t)__LINE__,0);
+	throw e;
+}
+
+int32_t CHPMultiDataData::GetColumnData(MultiDataType dataType, int col, std::string *values)
+{
+	DataSetInfo *info = OpenMultiDataDataSet(dataType);
+	ColumnInfo colInfo = GetColumnInfo(dataType, col);
+	int32_t nrows = info->entries->Header().GetRowCnt();
+	if (colInfo.GetColumnType() == ASCIICharColType)
+	{
+		return info->entries->GetDataRaw(col, 0, nrows, values);
+	}
+	else if (colInfo.GetColumnType() == UnicodeCharColType)
+	{
+		std::vector<std::wstring> data(nrows);
+		int32_t n = (nrows == 0 ? 0 : info->entries->GetDataRaw(col, 0, nrows, &data[0]));
+		for (int32_t i=0; i<n; i++)
+			values[i] = StringUtils::ConvertWCSToMBS(data[i]);
+		return n;
+	}
+	affymetrix_calvin_exceptions::UnexpectedColumnTypeException e(L"Calvin",L"Default Description, Please Update!",affymetrix_calvin_utilities::DateTime::GetCurrentDateTime().ToString(),std::string(__FILE__),(u_int16_t)__LINE__,0);
+	throw e;
+}
+
 int CHPMultiDataData::GetMaxProbeSetName(MultiDataType dataType)
 {
 	OpenMultiDataDataSet(dataType);
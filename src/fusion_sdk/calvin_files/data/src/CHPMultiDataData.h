@@ -539,6 +539,34 @@ public:
 	*/
 	std::wstring GetMetricColumnName(MultiDataType dataType, int colIndex);
 
+	/*! Get the number of columns of a data set, including the metric columns.
+	* @param dataType The data type
+	* @return The number of columns.
+	*/
+	int32_t GetNumColumns(MultiDataType dataType);
+
+	/*! Get the column information.
+	* @param dataType The data type
+	* @param col The column index (of all columns)
+	* @return The column information
+	*/
+	ColumnInfo GetColumnInfo(MultiDataType dataType, int col);
+
+	/*! Get all values of a column of a data set. The values are decoded in one pass over the column.
+	* Signed integer columns and 8 and 16 bit unsigned integer columns can be read as int32_t,
+	* all numeric columns as double and text columns as strings.
+	* @param dataType The data type
+	* @param col The column index (of all columns)
+	* @param values The array to fill, with room for GetEntryCount(dataType) values.
+	* @return The number of values read.
+	* @exception affymetrix_calvin_exceptions::UnexpectedColumnTypeException The column cannot be read as the requested type.
+	*/
+	int32_t GetColumnData(MultiDataType dataType, int col, int32_t *values);
+
+	int32_t GetColumnData(MultiDataType dataType, int col, double *values);
+
+	int32_t GetColumnData(MultiDataType dataType, int col, std::string *values);
+
 private:
 	/*! Get the extra metric columns.
 	* @param ds The data set info.
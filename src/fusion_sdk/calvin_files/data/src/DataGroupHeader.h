@@ -48,11 +48,11 @@ private:
 	/*! data dataGroup name */
 	std::wstring name;
 	/*! file position of the 1st data dataSet */
-	u_int32_t dataSetPos;
+	u_int64_t dataSetPos;
 	/*! file position of the next dataGroup */
-	u_int32_t nextGrpPos;
+	u_int64_t nextGrpPos;
 	/*! file position of the start of the data group header */
-	u_int32_t headerStartFilePos;
+	u_int64_t headerStartFilePos;
 	/*! data dataSets in this dataGroup */
 	DataSetHdrVector dataSetHdrs;
 
@@ -84,21 +84,21 @@ public:
 	/*! Set the file position of the start of the DataSet header.
 	 *	The value set here is not written to the file.
 	 */
-	void SetHeaderStartFilePos(u_int32_t pos) { headerStartFilePos = pos; }
+	void SetHeaderStartFilePos(u_int64_t pos) { headerStartFilePos = pos; }
 
 	/*! Get the file position of the start of the DataSet header. */
-	u_int32_t GetHeaderStartFilePos() const { return headerStartFilePos; }
+	u_int64_t GetHeaderStartFilePos() const { return headerStartFilePos; }
 
 /*! Set the file position of the DataSet header.
 *  The value set here is not necessarily the value written to the file.
 */
-	void SetDataSetPos(u_int32_t pos) { dataSetPos  = pos; }
+	void SetDataSetPos(u_int64_t pos) { dataSetPos  = pos; }
 	/*! Get the file position of the DataSet header. */
-	u_int32_t GetDataSetPos() const { return dataSetPos; }
+	u_int64_t GetDataSetPos() const { return dataSetPos; }
 	/*! Set the file position of the next DataGroup header. */
-	void SetNextGroupPos(u_int32_t pos) { nextGrpPos  = pos; }
+	void SetNextGroupPos(u_int64_t pos) { nextGrpPos  = pos; }
 	/*! Get the file position of the next DataGroup header. */
-	u_int32_t GetNextGroupPos() const { return nextGrpPos; }
+	u_int64_t GetNextGroupPos() const { return nextGrpPos; }
 	/*!
 	 */
 	affymetrix_calvin_io::DataSetHeader* FindDataSetHeader(const std::wstring& dataSetName);
@@ -39,14 +39,6 @@ using namespace affymetrix_calvin_io;
 /// Page size used for memory mapping in non Windows environment
 #define PAGE_SIZE (getpagesize())
 #endif
-#ifndef PAGE_MASK
-/// Page mask used for memory mapping in non Windows environment
-#define PAGE_MASK ~(PAGE_SIZE-1)
-#endif
-#ifndef PAGE_TRUNC
-/// Page truncation pointer used for memory mapping in non Windows environment
-#define PAGE_TRUNC(ptr) (ptr&(PAGE_MASK))
-#endif
 #endif
 
 /*
@@ -166,9 +158,9 @@ void DataSet::ReadDataSetUsingStream()
 	mapLen = header.GetDataSize();
 	mapStart = header.GetDataStartFilePos();
 
-	data = new char[mapLen];
-	fileStream->seekg(mapStart);
-	fileStream->read(data, mapLen);
+	data = new char[(size_t) mapLen];
+	fileStream->seekg((std::streamoff) mapStart);
+	fileStream->read(data, (std::streamsize) mapLen);
 }
 
 /*
@@ -213,7 +205,7 @@ std::string GetErrorMsg()
 /*
  * Map the data on Win32
  */
-bool DataSet::MapDataWin32(u_int32_t start, u_int32_t bytes)
+bool DataSet::MapDataWin32(u_int64_t start, u_int64_t bytes)
 {
 	mapStart = start;
 
@@ -230,7 +222,7 @@ bool DataSet::MapDataWin32(u_int32_t start, u_int32_t bytes)
 								sysinfo.dwAllocationGranularity;
 	DWORD dwOffsetHigh = DWORD(qwFileOffset >> 32);
 	DWORD dwOffsetLow  = DWORD(qwFileOffset & 0xFFFFFFFF);
-	DWORD dwBytesToMap = bytes + dwOffset;
+	DWORD dwBytesToMap = DWORD(bytes) + dwOffset;
 
 	if (mappedData != 0)
 	{
@@ -255,26 +247,33 @@ bool DataSet::MapDataWin32(u_int32_t start, u_int32_t bytes)
 /*
  * Map the data on Linux
  */
-bool DataSet::MapDataPosix(u_int32_t start, u_int32_t bytes)
+bool DataSet::MapDataPosix(u_int64_t start, u_int64_t bytes)
 {
 	mapStart = start;
 	if (fp == NULL)
 		return false;
 
-	u_int32_t page_start = PAGE_TRUNC(start);
-	u_int32_t page_offset = start - page_start;
+	u_int64_t page_start = start - (start % (u_int64_t) PAGE_SIZE);
+	u_int64_t page_offset = start - page_start;
 	mapLen = bytes + page_offset;
 
 	// Get the file size
 	if (Fs::fileExists(fileName))
 	{
           int64_t fileLen = Fs::fileSize(fileName);
-		if (fileLen < page_start + mapLen)
+		if ((u_int64_t) fileLen < page_start + mapLen)
 			mapLen = fileLen - page_start;
 	}
 
+	// The view and its offset must be addressable on this platform.
+	if ((u_int64_t) (size_t) mapLen != mapLen || (u_int64_t) (off_t) page_start != page_start)
+	{
+		Close();
+		return false;
+	}
+
 	// Map the file.
-	mappedData = mmap(NULL, mapLen, PROT_READ, MAP_SHARED, fileno(fp), page_start);
+	mappedData = mmap(NULL, (size_t) mapLen, PROT_READ, MAP_SHARED, fileno(fp), (off_t) page_start);
 	if (mappedData == MAP_FAILED)
 	{
 		Close();
@@ -311,7 +310,7 @@ void DataSet::UnmapFile()
 	{
 		if (mappedData)
 		{
-			munmap(mappedData, mapLen);
+			munmap(mappedData, (size_t) mapLen);
 			mapLen = 0;
 			mappedData = 0;
 		}
@@ -364,6 +363,45 @@ void DataSet::CheckRowColumnAndType(int32_t row, int32_t col, DataSetColumnTypes
 	}
 }
 
+/*
+ * Provide a view of the column data in memory, if all requested rows are in memory.
+ */
+bool DataSet::GetColumnView(int32_t col, int32_t startRow, int32_t count, DataSetColumnView& view)
+{
+	if (isOpen == false || col < 0 || col >= header.GetColumnCnt() || startRow < 0)
+		return false;
+
+	// Strings are variable length and cannot be viewed
+	ColumnInfo info = header.GetColumnInfo(col);
+	if (info.GetColumnType() == ASCIICharColType || info.GetColumnType() == UnicodeCharColType)
+		return false;
+
+	int32_t endRow = ComputeEndRow(startRow, count);
+	if (endRow <= startRow)
+		return false;
+
+	char* instr = FilePosition(startRow, col, endRow-startRow);
+
+	// Check that the last element is in memory too
+	u_int64_t endByte = ((u_int64_t) BytesPerRow())*(endRow-1) + columnByteOffsets[col+1] + header.GetDataStartFilePos();
+	u_int64_t mapEnd = mapStart + mapLen;
+#ifndef _MSC_VER
+	// The posix mapping length includes the offset into the first page
+	if (useMemoryMapping)
+		mapEnd -= mapStart % (u_int64_t) PAGE_SIZE;
+#endif
+	if (data == 0 || endByte > mapEnd)
+		return false;
+
+	view.data = instr;
+	view.stride = BytesPerRow();
+	view.count = endRow-startRow;
+	view.size = info.GetSize();
+	view.type = info.GetColumnType();
+	view.bigEndian = true;
+	return true;
+}
+
 /*
  * Detemine the address of data given row and col.  Ensure all requested data is mapped
  */
@@ -385,21 +423,21 @@ char* DataSet::FilePosition(int32_t rowStart, int32_t col, int32_t rowCount)
 	}
 
 	// Byte offset in data set + byte offset of data set in file
-	u_int32_t startByte = BytesPerRow()*rowStart + columnByteOffsets[col] + header.GetDataStartFilePos();
+	u_int64_t startByte = ((u_int64_t) BytesPerRow())*rowStart + columnByteOffsets[col] + header.GetDataStartFilePos();
 
 #ifdef _MSC_VER
 
 	if (useMemoryMapping)
 	{
 		// Byte offset in data set + byte offset of data set in file
-		u_int32_t endByte = BytesPerRow()*(rowStart+rowCount-1) + columnByteOffsets[col+1] + header.GetDataStartFilePos();	// as long as col is in bounds this is safe.
+		u_int64_t endByte = ((u_int64_t) BytesPerRow())*(rowStart+rowCount-1) + columnByteOffsets[col+1] + header.GetDataStartFilePos();	// as long as col is in bounds this is safe.
 
 		// Remap the file if necessary
 		if (startByte < mapStart || endByte > mapStart+mapLen)
 		{
 			if (startByte < mapStart)	// moving backwards through the data, attempt to find an optimum startByte.
 			{
-				u_int32_t reverseStartByte = 0;
+				u_int64_t reverseStartByte = 0;
 				if (endByte > MaxViewSize)
 					reverseStartByte = endByte - MaxViewSize;
 
@@ -437,12 +475,12 @@ char* DataSet::LoadDataAndReturnFilePosition(int32_t rowStart, int32_t col, int3
 	// Delete the previous data
 	ClearStreamData();
 
-	mapLen = BytesPerRow()*rowCount;
-	mapStart = BytesPerRow()*rowStart + columnByteOffsets[col] + header.GetDataStartFilePos();
+	mapLen = ((u_int64_t) BytesPerRow())*rowCount;
+	mapStart = ((u_int64_t) BytesPerRow())*rowStart + columnByteOffsets[col] + header.GetDataStartFilePos();
 
-	data = new char[mapLen];
-	fileStream->seekg(mapStart);
-	fileStream->read(data, mapLen);
+	data = new char[(size_t) mapLen];
+	fileStream->seekg((std::streamoff) mapStart);
+	fileStream->read(data, (std::streamsize) mapLen);
 	return data;
 }
 
@@ -547,30 +585,8 @@ template<typename T> void DataSet::GetDataT(int32_t col, int32_t startRow, int32
 	int32_t endRow = ComputeEndRow(startRow, count);
 	ClearAndSizeVector(values, endRow-startRow);
 
-	if (header.GetColumnCnt() > 1)
-	{
-		for (int32_t row = startRow; row < endRow; ++row)
-		{
-			// Get the data
-			char* instr = FilePosition(row, col);
-			AssignValue(row-startRow, values, instr);
-		}
-	}
-	else
-	{
-		char* instr = FilePosition(startRow, col, count);
-		int32_t recomputePositionRow = LastRowMapped();
-
-		for (int32_t row = startRow; row < endRow; ++row)
-		{
-			if (row > recomputePositionRow)
-			{
-				instr = FilePosition(row, col, count-row);
-				recomputePositionRow = LastRowMapped();
-			}
-			AssignValue(row-startRow, values, instr);
-		}
-	}
+	if (endRow > startRow)
+		GetDataRawT(col, startRow, endRow-startRow, &values[0]);
 }
 
 void DataSet::AssignValue(int32_t index, Uint8Vector& values, char*& instr)
@@ -667,6 +683,11 @@ template<typename T> int32_t DataSet::GetDataRawT(int32_t col, int32_t startRow,
 {
 	int32_t endRow = ComputeEndRow(startRow, count);
 
+	// Decode all values in one pass when they are in memory
+	DataSetColumnView view;
+	if (endRow-startRow > 1 && GetColumnView(col, startRow, endRow-startRow, view) && AssignValues(view, values))
+		return view.count;
+
 	if (header.GetColumnCnt() > 1)
 	{
 		for (int32_t row = startRow; row < endRow; ++row)
@@ -737,6 +758,58 @@ void DataSet::AssignValue(int32_t index, std::wstring* values, char*& instr)
 	values[index] = FileInput::ReadString16(instr);
 }
 
+bool DataSet::AssignValues(const DataSetColumnView& view, u_int8_t* values)
+{
+	FileInput::ReadUInt8Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, int8_t* values)
+{
+	FileInput::ReadInt8Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, u_int16_t* values)
+{
+	FileInput::ReadUInt16Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, int16_t* values)
+{
+	FileInput::ReadInt16Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, u_int32_t* values)
+{
+	FileInput::ReadUInt32Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, int32_t* values)
+{
+	FileInput::ReadInt32Array(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, float* values)
+{
+	FileInput::ReadFloatArray(view.data, view.count, values, view.stride);
+	return true;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, std::string* values)
+{
+	return false;
+}
+
+bool DataSet::AssignValues(const DataSetColumnView& view, std::wstring* values)
+{
+	return false;
+}
+
 int32_t DataSet::GetDataRaw(int32_t col, int32_t startRow, int32_t count, u_int8_t* values)
 {
 	return GetDataRawT(col, startRow, count, values);
@@ -784,5 +857,5 @@ int32_t DataSet::GetDataRaw(int32_t col, int32_t startRow, int32_t count, std::w
 
 int32_t DataSet::LastRowMapped()
 {
-	return (mapLen+(mapStart-header.GetDataStartFilePos()))/BytesPerRow() - 1;
+	return (int32_t) ((mapLen+(mapStart-header.GetDataStartFilePos()))/BytesPerRow()) - 1;
 }
@@ -42,6 +42,40 @@ namespace affymetrix_calvin_io
 // forward declare
 class GenericData;
 
+/*! A read-only view of consecutive values of one numeric column of a DataSet.
+ *	The values are not copied; they are stride bytes apart in the mapped (or buffered)
+ *	DataSet data and remain valid until the DataSet is closed or remapped.
+ */
+class DataSetColumnView
+{
+public:
+	/*! Constructor */
+	DataSetColumnView() : data(0), stride(0), count(0), size(0), type(FloatColType), bigEndian(true) {}
+
+	/*! Pointer to the first value */
+	const char* data;
+
+	/*! Number of bytes between consecutive values */
+	int32_t stride;
+
+	/*! Number of values */
+	int32_t count;
+
+	/*! Number of bytes in each value */
+	int32_t size;
+
+	/*! The column type */
+	DataSetColumnTypes type;
+
+	/*! True if the values are stored big endian, which is the case for all Calvin files */
+	bool bigEndian;
+
+	/*! Determines if the values are adjacent in memory
+	 *	@return true if the stride equals the value size.
+	 */
+	bool IsContiguous() const { return stride == size; }
+};
+
 /*! This class provides methods to access the data of a DataSet. */
 class DataSet
 {
@@ -186,6 +220,18 @@ public:
 	 */
 	void CheckRowColumnAndType(int32_t row, int32_t col, affymetrix_calvin_io::DataSetColumnTypes type);
 
+	/*! Provides a view of multiple data elements in the same numeric column without copying them.
+	 *	The view is only available when all requested rows are in memory at once, which is
+	 *	the case when the entire DataSet data is memory-mapped or was read into a buffer.
+	 *	@param col Column index.
+	 *	@param startRow Row index of the first element in the view.
+	 *	@param count Number of elements in the view. -1 indicates to view all
+	 *	@param view The view to fill.
+	 *	@return true if the view is available, false if the column is not numeric or the rows
+	 *	are not all in memory.  In that case GetDataRaw still provides the data.
+	 */
+	bool GetColumnView(int32_t col, int32_t startRow, int32_t count, DataSetColumnView& view);
+
 //protected:
 
 	/*! Return the bytes per row.
@@ -279,11 +325,11 @@ protected:
 	/*! Platform specific memory-mapping method */
 #ifdef _MSC_VER
 
-	bool MapDataWin32(u_int32_t start, u_int32_t bytes);
+	bool MapDataWin32(u_int64_t start, u_int64_t bytes);
 
 #else
 
-	bool MapDataPosix(u_int32_t start, u_int32_t bytes);
+	bool MapDataPosix(u_int64_t start, u_int64_t bytes);
 
 #endif
 
@@ -328,6 +374,29 @@ protected:
 
 	void AssignValue(int32_t index, std::wstring* values, char*& instr);
 
+	/*! Decodes all values of a view into an array.
+	 *	@param view The view of the data in memory.
+	 *	@param values The array into which to write the values.
+	 *	@return true if the values were decoded, false for string types, which cannot be viewed.
+	 */
+	bool AssignValues(const DataSetColumnView& view, u_int8_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, int8_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, u_int16_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, int16_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, u_int32_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, int32_t* values);
+
+	bool AssignValues(const DataSetColumnView& view, float* values);
+
+	bool AssignValues(const DataSetColumnView& view, std::string* values);
+
+	bool AssignValues(const DataSetColumnView& view, std::wstring* values);
+
 protected:
 	/*! name of the file containing the data data set*.  */
 	std::string fileName;
@@ -362,9 +431,9 @@ protected:
 	/*! Indicates if the DataSet is open*/
 	bool isOpen;
 	/*! Byte offset to the start of the view */
-	u_int32_t mapStart;
+	u_int64_t mapStart;
 	/*! Number of bytes mapped to the view */
-	u_int32_t mapLen;
+	u_int64_t mapLen;
 	/*! A flag the indicates the data access mode.  True = access the data using memory-mapping.  False = access the data using std::ifstream */
 	bool useMemoryMapping;
 	/*! An open ifstream object */
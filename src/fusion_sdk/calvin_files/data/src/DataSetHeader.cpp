@@ -53,9 +53,9 @@ void DataSetHeader::ClearNameValueParameters()
 	nameValParams.clear();
 }
 
-int32_t DataSetHeader::GetDataSize() const
+u_int64_t DataSetHeader::GetDataSize() const
 {
-	return GetRowSize() * rowCount;
+	return ((u_int64_t) GetRowSize()) * rowCount;
 }
 
 int32_t DataSetHeader::GetRowSize() const
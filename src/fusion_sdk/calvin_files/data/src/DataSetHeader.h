@@ -62,11 +62,11 @@ private:
 	/*! column information */
 	ColInfoVector columnTypes;
 	/*! file position of the start of the dataSet header */
-	u_int32_t headerStartFilePos;
+	u_int64_t headerStartFilePos;
 	/*! file position of the start of the data */
-	u_int32_t dataStartFilePos;
+	u_int64_t dataStartFilePos;
 	/*! file position of the next dataSet header */
-	u_int32_t nextSetFilePos;
+	u_int64_t nextSetFilePos;
 
 public:
 
@@ -75,8 +75,8 @@ public:
 
 	void ClearNameValueParameters();
 
-	/*!  */
-	int32_t GetDataSize() const;
+	/*! Get the size of the data in bytes. */
+	u_int64_t GetDataSize() const;
 	/*!  */
 	int32_t GetRowSize() const;
 	/*!  */
@@ -135,21 +135,21 @@ public:
 	/*! Set the file position of the start of the DataSet header.
 	 *	The value set here is not written to the file.
 	 */
-	void SetHeaderStartFilePos(u_int32_t pos) { headerStartFilePos = pos; }
+	void SetHeaderStartFilePos(u_int64_t pos) { headerStartFilePos = pos; }
 	/*! Get the file position of the start of the DataSet header. */
-	u_int32_t GetHeaderStartFilePos() const { return headerStartFilePos; }
+	u_int64_t GetHeaderStartFilePos() const { return headerStartFilePos; }
 
 	/*! Set the file position of the start of the DataSet data.
 	*  The value set here is not written to the file.
 	*/
-	void SetDataStartFilePos(u_int32_t pos) { dataStartFilePos  = pos; }
+	void SetDataStartFilePos(u_int64_t pos) { dataStartFilePos  = pos; }
 	/*! Get the file position of the start of the DataSet data. */
-	u_int32_t GetDataStartFilePos() const { return dataStartFilePos; }
+	u_int64_t GetDataStartFilePos() const { return dataStartFilePos; }
 
 	/*! Set the file position of the next DataSet header. */
-	void SetNextSetFilePos(u_int32_t pos) { nextSetFilePos = pos; }
+	void SetNextSetFilePos(u_int64_t pos) { nextSetFilePos = pos; }
 	/*! Get the file position of the next DataSet header. */
-	u_int32_t GetNextSetFilePos() const { return nextSetFilePos; }
+	u_int64_t GetNextSetFilePos() const { return nextSetFilePos; }
 
 protected:
 	/*! Finds a ParameterNameValueType by name in the nameValPairs collection
@@ -162,6 +162,24 @@ private:
 
 };
 
+/*! Restores a file position that was stored in the file as 32 bits.
+ *	The file format stores file positions as 32-bit values, so positions
+ *	beyond 4 GB are stored modulo 2^32.  Since the file is laid out
+ *	sequentially, the full position is the smallest position that is not
+ *	before the given lower bound and agrees with the stored value.
+ *	@param pos The file position as stored in the file.
+ *	@param minPos A file position known not to be after the position.
+ *	@return The 64-bit file position.
+ */
+inline u_int64_t UnwrapFilePos(u_int32_t pos, u_int64_t minPos)
+{
+	const u_int64_t high = (minPos >> 32) << 32;
+	u_int64_t fullPos = high | pos;
+	if (fullPos < minPos)
+		fullPos += ((u_int64_t) 1) << 32;
+	return fullPos;
+}
+
 /*! vector of DataSetHeaders */
 typedef std::vector<DataSetHeader> DataSetHdrVector;
 /*! constant iterator of DataSetHeaders */
@@ -285,7 +285,7 @@ DataSet* GenericData::CreateDataSet(DataSetHeader* dsh)
 /*
  * Returns a DataGroup object based on a DataGroup file position
  */
-affymetrix_calvin_io::DataGroup GenericData::DataGroup(u_int32_t dataGroupFilePos)
+affymetrix_calvin_io::DataGroup GenericData::DataGroup(u_int64_t dataGroupFilePos)
 {
 	if (Open() == false)
 	{
@@ -305,7 +305,7 @@ affymetrix_calvin_io::DataGroup GenericData::DataGroup(u_int32_t dataGroupFilePo
 	}
 
 	// and position it
-	pfs->seekg(dataGroupFilePos, std::ios_base::beg);
+	pfs->seekg((std::streamoff) dataGroupFilePos, std::ios_base::beg);
 
 	// Read the DataGroupHeader and all DataSetHeaders
 	DataGroupHeader dch;
@@ -413,7 +413,7 @@ void GenericData::ReadFullDataSetHeader(DataSetHeader* dph)
 		}
 
 		// and position it
-		pfs->seekg(dph->GetHeaderStartFilePos(), std::ios_base::beg);
+		pfs->seekg((std::streamoff) dph->GetHeaderStartFilePos(), std::ios_base::beg);
 
 		// Read the header
 		DataSetHeaderReader reader;
@@ -146,7 +146,7 @@ public:
 	 *	@param dataGroupFilePos File position of the DataGroup in the current file
 	 *	@return DataGroup object.
 	*/
-	affymetrix_calvin_io::DataGroup DataGroup(u_int32_t dataGroupFilePos);
+	affymetrix_calvin_io::DataGroup DataGroup(u_int64_t dataGroupFilePos);
 
 	/*! Clears the contents of the class.*/
 	void Clear();
@@ -26,6 +26,7 @@
 #include "calvin_files/parsers/src/CelFileReader.h"
 #include "calvin_files/utils/src/StringUtils.h"
 //
+#include <algorithm>
 #include <cstdlib>
 //
 
@@ -440,6 +441,111 @@ int CalvinCELDataAdapter::GetIntensities(int index,std::vector<float>& intensiti
   return 0;
 }
 
+/*
+ * Read the planes of a contiguous range in one pass per plane.  Values that
+ * could not be read, e.g. the optional stdv and pixel planes when they are
+ * missing, are zero filled, as GetEntry() does.
+ */
+void CalvinCELDataAdapter::GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels)
+{
+	if (intensities != NULL)
+	{
+		int32_t n = calvinCel.GetIntensities(index, count, intensities);
+		std::fill(intensities + n, intensities + count, 0.0f);
+	}
+	if (stdvs != NULL)
+	{
+		int32_t n = calvinCel.GetStdev(index, count, stdvs);
+		std::fill(stdvs + n, stdvs + count, 0.0f);
+	}
+	if (pixels != NULL)
+	{
+		int32_t n = calvinCel.GetNumPixels(index, count, pixels);
+		std::fill(pixels + n, pixels + count, (short) 0);
+	}
+}
+
+/*
+ * Read the span covering all requested cells once and gather from it,
+ * instead of going through the data set once per cell.  Sparse selections
+ * are read one run of consecutive cells at the time instead, so that the
+ * buffer is never much larger than the number of requested cells.
+ */
+void CalvinCELDataAdapter::GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels)
+{
+	if (count <= 0)
+		return;
+
+	int first = indices[0];
+	int last = indices[0];
+	for (int k = 1; k < count; k++)
+	{
+		if (indices[k] < first)
+			first = indices[k];
+		else if (indices[k] > last)
+			last = indices[k];
+	}
+	int span = last - first + 1;
+
+	if (span / 4 > count)
+	{
+		for (int k = 0; k < count; )
+		{
+			int n = 1;
+			while (k + n < count && indices[k + n] == indices[k] + n)
+				n++;
+			GetEntries(indices[k], n,
+				(intensities != NULL ? intensities + k : NULL),
+				(stdvs != NULL ? stdvs + k : NULL),
+				(pixels != NULL ? pixels + k : NULL));
+			k += n;
+		}
+		return;
+	}
+
+	FloatVector fvalues(intensities != NULL || stdvs != NULL ? span : 0);
+	if (intensities != NULL)
+	{
+		GetEntries(first, span, &fvalues[0], NULL, NULL);
+		for (int k = 0; k < count; k++)
+			intensities[k] = fvalues[indices[k] - first];
+	}
+	if (stdvs != NULL)
+	{
+		GetEntries(first, span, NULL, &fvalues[0], NULL);
+		for (int k = 0; k < count; k++)
+			stdvs[k] = fvalues[indices[k] - first];
+	}
+	if (pixels != NULL)
+	{
+		Int16Vector pvalues(span);
+		GetEntries(first, span, NULL, NULL, &pvalues[0]);
+		for (int k = 0; k < count; k++)
+			pixels[k] = pvalues[indices[k] - first];
+	}
+}
+
+/*
+ * The data sets are memory mapped, so reading the span of each row of
+ * the rectangle only touches the pages of those spans.
+ */
+bool CalvinCELDataAdapter::GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels)
+{
+	int cols = GetCols();
+	if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > cols || y + height > GetRows())
+		return false;
+
+	for (int row = 0; row < height; row++)
+	{
+		int k = row * width;
+		GetEntries((y + row) * cols + x, width,
+		           intensities == NULL ? NULL : intensities + k,
+		           stdvs == NULL ? NULL : stdvs + k,
+		           pixels == NULL ? NULL : pixels + k);
+	}
+	return true;
+}
+
 /*
  */
 float CalvinCELDataAdapter::GetIntensity(int x, int y)
@@ -535,6 +641,36 @@ bool CalvinCELDataAdapter::IsOutlier(int index)
 		return false;
 }
 
+/*
+ * Convert cell coordinates to sorted cell indices.
+ */
+static void CoordsToIndices(const XYCoordVector &coords, int cols, std::vector<int> &indices)
+{
+	indices.clear();
+	indices.reserve(coords.size());
+	for (XYCoordVector::const_iterator ii = coords.begin(); ii != coords.end(); ++ii)
+		indices.push_back(ii->yCoord * cols + ii->xCoord);
+	std::sort(indices.begin(), indices.end());
+}
+
+/*
+ */
+void CalvinCELDataAdapter::GetMaskedIndices(std::vector<int> &indices)
+{
+	XYCoordVector coords;
+	calvinCel.GetMaskedCoords(coords);
+	CoordsToIndices(coords, GetCols(), indices);
+}
+
+/*
+ */
+void CalvinCELDataAdapter::GetOutlierIndices(std::vector<int> &indices)
+{
+	XYCoordVector coords;
+	calvinCel.GetOutlierCoords(coords);
+	CoordsToIndices(coords, GetCols(), indices);
+}
+
 
 bool CalvinCELDataAdapter::ReadHeader()
 {
@@ -245,6 +245,9 @@ public:
 	/*! Returns the GenericData object associated with a Calvin file, NULL for GCOS files. */
 	affymetrix_calvin_io::GenericData *GetGenericData();
 
+	/*! Returns the CCHPFileData object associated with a GCOS file, NULL for Calvin files. */
+	affxchp::CCHPFileData *GetGCOSData() { return NULL; }
+
 protected:
 	/*! The underlying data access object */
 	CHPData calvinChp;
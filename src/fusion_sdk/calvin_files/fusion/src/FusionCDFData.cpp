@@ -1254,6 +1254,73 @@ bool FusionCDFData::Read()
 	}
 }
 
+/*
+ * Read the file for access by probe set index. XDA files are memory mapped by
+ * Read() and support this already; Calvin files are read sequentially by
+ * default and need their table of contents opened.
+ */
+bool FusionCDFData::ReadByProbeSetIndex()
+{
+	CreateObject();
+	if (gcosData)
+	{
+		gcosData->SetFileName(fileName.c_str());
+		return gcosData->Read();
+	}
+	else
+	{
+		CDFFileReader reader;
+		reader.SetFilename(fileName);
+		try
+		{
+			reader.Read(*calvinData, CDFFileReader::ReadByProbeSetNumber);
+		}
+		catch(...)
+		{
+			return false;
+		}
+		return true;
+	}
+}
+
+/*
+ * Map the index of the probe set names from its file, or build it from the
+ * names in the file. A failure to write the index file is not an error.
+ */
+bool FusionCDFData::GetProbeSetNameIndex(affymetrix_calvin_utilities::StringIndex &index, const std::string &indexFileName)
+{
+	if (indexFileName.empty() == false && index.Map(indexFileName, fileName) == true)
+		return true;
+
+	index.Clear();
+	if (Read() == false)
+		return false;
+	try
+	{
+		int n = GetHeader().GetNumProbeSets();
+		std::vector<std::string> names(n);
+		size_t nameBytes = 0;
+		for (int i=0; i<n; i++)
+		{
+			names[i] = GetProbeSetName(i);
+			nameBytes += names[i].size();
+		}
+		index.Reserve(n, nameBytes);
+		for (int i=0; i<n; i++)
+			index.Add(names[i]);
+	}
+	catch(...)
+	{
+		index.Clear();
+		return false;
+	}
+	index.Sort();
+
+	if (indexFileName.empty() == false)
+		index.Write(indexFileName, fileName);
+	return true;
+}
+
 /*
  * Read the header of the file only. Read a calvin file in its entirety - this really
  * reads the header until the data groups are opened.
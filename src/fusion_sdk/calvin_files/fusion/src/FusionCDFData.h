@@ -559,6 +559,13 @@ public:
 	 */
 	bool Read();
 
+	/*! Reads the file such that the probe sets can be accessed by index in any
+	 * order.  Several objects may read the same file this way concurrently, one
+	 * per thread, since each holds its own file handles or memory map.
+	 * @return True if successful.
+	 */
+	bool ReadByProbeSetIndex();
+
 	/*! Reads the header of the file only.
 	 * @return True if successful.
 	 */
@@ -572,6 +579,16 @@ public:
 	/*! Deallocates memory and closes any file handles. */
 	void Close();
 
+	/*! Gets an index of the probe set names, for looking up probe sets by name
+	 * or by prefix.  The index is memory mapped from an index file if that is up
+	 * to date.  Otherwise the file is read and the index is built, and then
+	 * written to the index file.
+	 * @param index Receives the index.
+	 * @param indexFileName The name of the index file, or empty for none.
+	 * @return True if successful.
+	 */
+	bool GetProbeSetNameIndex(affymetrix_calvin_utilities::StringIndex &index, const std::string &indexFileName);
+
 	/*! Determines if a CDF file is of the XDA (binary) format.
 	 * @param fileName The name of the file to test.
 	 * @return True if XDA format.
@@ -391,6 +391,33 @@ int FusionCELData::GetIntensities(int index,std::vector<float>& intensities)
 	return adapter->GetIntensities(index,intensities);
 }
 
+/*
+ * Retrieve CEL file intensities, stdv values and pixel counts of a range of cells.
+ */
+void FusionCELData::GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels)
+{
+	CheckAdapter();
+	adapter->GetEntries(index, count, intensities, stdvs, pixels);
+}
+
+/*
+ * Retrieve CEL file intensities, stdv values and pixel counts of a set of cells.
+ */
+void FusionCELData::GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels)
+{
+	CheckAdapter();
+	adapter->GetEntries(indices, count, intensities, stdvs, pixels);
+}
+
+/*
+ * Retrieve CEL file intensities, stdv values and pixel counts of a rectangle of cells.
+ */
+bool FusionCELData::GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels)
+{
+	CheckAdapter();
+	return adapter->GetRectangle(x, y, width, height, intensities, stdvs, pixels);
+}
+
 /*
  * Retrieve a CEL file intensity.
  */
@@ -473,6 +500,24 @@ bool FusionCELData::IsOutlier(int index)
 	return adapter->IsOutlier(index);
 }
 
+/*
+ * Retrieve the indices of the masked cells.
+ */
+void FusionCELData::GetMaskedIndices(std::vector<int> &indices)
+{
+	CheckAdapter();
+	adapter->GetMaskedIndices(indices);
+}
+
+/*
+ * Retrieve the indices of the outlier cells.
+ */
+void FusionCELData::GetOutlierIndices(std::vector<int> &indices)
+{
+	CheckAdapter();
+	adapter->GetOutlierIndices(indices);
+}
+
 // For reading a file.
 
 /*
@@ -239,6 +239,38 @@ public:
   /// @param     intensity_vec The vector to fill, its size is the number of intensities.
 	int GetIntensities(int index,std::vector<float>& intensity_vec);
 
+	/*! Retrieve CEL file intensities, stdv values and pixel counts of a range of cells.
+	 * This is much faster than one GetIntensity()/GetStdv()/GetPixels() call per cell.
+	 * @param index The index of the first cell.
+	 * @param count The number of cells.
+	 * @param intensities Buffer of count values to fill, or NULL to skip.
+	 * @param stdvs Buffer of count values to fill, or NULL to skip.
+	 * @param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	void GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels);
+
+	/*! Retrieve CEL file intensities, stdv values and pixel counts of a set of cells.
+	 * @param indices The (zero-based) indices of the cells.
+	 * @param count The number of cells.
+	 * @param intensities Buffer of count values to fill, or NULL to skip.
+	 * @param stdvs Buffer of count values to fill, or NULL to skip.
+	 * @param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	void GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels);
+
+	/*! Retrieve CEL file intensities, stdv values and pixel counts of a rectangle of cells.
+	 * After ReadHeader(), only the parts of the file holding the rectangle are read.
+	 * @param x The X coordinate of the upper left cell.
+	 * @param y The Y coordinate of the upper left cell.
+	 * @param width The number of columns.
+	 * @param height The number of rows.
+	 * @param intensities Buffer of width*height values to fill row by row, or NULL to skip.
+	 * @param stdvs Buffer of width*height values to fill row by row, or NULL to skip.
+	 * @param pixels Buffer of width*height values to fill row by row, or NULL to skip.
+	 * @return True if successful.
+	 */
+	bool GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels);
+
 	/*! Retrieve a CEL file intensity.
 	 * @param x The X coordinate.
 	 * @param y The Y coordinate.
@@ -299,6 +331,16 @@ public:
 	 */
 	bool IsOutlier(int index);
 
+	/*! Retrieves the indices of all masked cells.
+	 * @param indices The cell indices in increasing order.
+	 */
+	void GetMaskedIndices(std::vector<int> &indices);
+
+	/*! Retrieves the indices of all outlier cells.
+	 * @param indices The cell indices in increasing order.
+	 */
+	void GetOutlierIndices(std::vector<int> &indices);
+
 	// For reading a file.
 	/*! Closes the file */
 	void Close();
@@ -218,6 +218,33 @@ public:
 	 *	@return   non-zero on error.
 	 */
 	virtual int GetIntensities(int index, std::vector<float>& intensities) = 0;
+	/*! \brief Get intensities, standard deviations and pixels of a range of cells.
+	 *	\param index Index of the first cell.
+	 *	\param count Number of cells.
+	 *	\param intensities Buffer of count values to fill, or NULL to skip.
+	 *	\param stdvs Buffer of count values to fill, or NULL to skip.
+	 *	\param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	virtual void GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels) = 0;
+	/*! \brief Get intensities, standard deviations and pixels of a set of cells.
+	 *	\param indices Indices of the cells.
+	 *	\param count Number of cells.
+	 *	\param intensities Buffer of count values to fill, or NULL to skip.
+	 *	\param stdvs Buffer of count values to fill, or NULL to skip.
+	 *	\param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	virtual void GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels) = 0;
+	/*! \brief Get intensities, standard deviations and pixels of a rectangle of cells.
+	 *	\param x X coordinate of the upper left cell.
+	 *	\param y Y coordinate of the upper left cell.
+	 *	\param width Number of columns.
+	 *	\param height Number of rows.
+	 *	\param intensities Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\param stdvs Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\param pixels Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\return True if successful.
+	 */
+	virtual bool GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels) = 0;
 
 	/*! \brief Get intensity by x, y position.
 	 *	\param x X position.
@@ -271,6 +298,14 @@ public:
 	 *	\return Is index position an outlier.
 	 */
 	virtual bool IsOutlier(int index) = 0;
+	/*! \brief Get the indices of all masked cells.
+	 *	\param indices The cell indices in increasing order.
+	 */
+	virtual void GetMaskedIndices(std::vector<int> &indices) = 0;
+	/*! \brief Get the indices of all outlier cells.
+	 *	\param indices The cell indices in increasing order.
+	 */
+	virtual void GetOutlierIndices(std::vector<int> &indices) = 0;
 
 	// For reading a file.
 	/*! Close the cell file. */
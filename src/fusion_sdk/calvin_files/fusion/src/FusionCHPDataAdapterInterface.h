@@ -254,6 +254,9 @@ public:
 
 	/*! Returns the GenericData object associated with a Calvin file, NULL for GCOS files. */
 	virtual affymetrix_calvin_io::GenericData *GetGenericData() = 0;
+
+	/*! Returns the CCHPFileData object associated with a GCOS file, NULL for Calvin files. */
+	virtual affxchp::CCHPFileData *GetGCOSData() = 0;
 };
 
 }
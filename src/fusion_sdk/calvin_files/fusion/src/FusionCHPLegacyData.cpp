@@ -270,6 +270,12 @@ GenericData *FusionCHPLegacyData::GetGenericData()
 	return adapter->GetGenericData();
 }
 
+affxchp::CCHPFileData *FusionCHPLegacyData::GetGCOSData()
+{
+	CheckAdapter();
+	return adapter->GetGCOSData();
+}
+
 std::string FusionCHPLegacyData::GetProbeSetName(int index)
 {
     CheckAdapter();
@@ -194,6 +194,11 @@ public:
 	/*! Returns the GenericData object associated with a Calvin file, NULL for GCOS files. */
 	affymetrix_calvin_io::GenericData *GetGenericData();
 
+	/*! Returns the CCHPFileData object associated with a GCOS file, NULL for Calvin files.
+	 * Its results can be copied in bulk, e.g. by CCHPFileData::GetExpressionColumn().
+	 */
+	affxchp::CCHPFileData *GetGCOSData();
+
 	/*! Gets the class name. */
 	affymetrix_calvin_utilities::AffymetrixGuidType GetObjectName();
 
@@ -22,6 +22,10 @@
 #include "calvin_files/fusion/src/FusionCHPData.h"
 #include "calvin_files/fusion/src/FusionCHPMultiDataData.h"
 //
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+//
 
 using namespace affymetrix_fusion_io;
 using namespace affymetrix_calvin_io;
@@ -36,15 +40,24 @@ FusionCHPMultiDataAccessor::~FusionCHPMultiDataAccessor()
 }
 
 bool FusionCHPMultiDataAccessor::Initialize(const vector<string> &chps)
+{
+    return Initialize(chps, "");
+}
+
+bool FusionCHPMultiDataAccessor::Initialize(const vector<string> &chps, const string &indexFileName)
 {
     // Clear the map
-    snpNameIndexMap.clear();
+    snpNameIndex.Clear();
 
     // Store the chp file names.
     chpFileNames = chps;
     if (chps.size() == 0)
         return false;
 
+    // Map the index of a previous run.
+    if (indexFileName.empty() == false && snpNameIndex.Map(indexFileName, chpFileNames[0]) == true)
+        return true;
+
     // Read the first chp file.
     FusionCHPData *chp = FusionCHPDataReg::Read(chpFileNames[0]);
     if (chp == NULL)
@@ -58,8 +71,27 @@ bool FusionCHPMultiDataAccessor::Initialize(const vector<string> &chps)
 
     // Extract the probe set names
     int n = mchp->GetEntryCount(GenotypeMultiDataType);
+    vector<string> snpNames(n);
+    try
+    {
+        if (n > 0)
+            mchp->GetColumnData(GenotypeMultiDataType, 0, &snpNames[0]);
+    }
+    catch (...)
+    {
+        delete mchp;
+        return false;
+    }
+    size_t nameBytes = 0;
+    for (int i=0; i<n; i++)
+        nameBytes += snpNames[i].size();
+    snpNameIndex.Reserve(n, nameBytes);
     for (int i=0; i<n; i++)
-        snpNameIndexMap[mchp->GetProbeSetName(GenotypeMultiDataType, i)] = i;
+        snpNameIndex.Add(snpNames[i]);
+
+    // Failing to write the index file is not an error.
+    if (indexFileName.empty() == false)
+        snpNameIndex.Write(indexFileName, chpFileNames[0]);
 
     // Close the file and return
     delete mchp;
@@ -78,7 +110,9 @@ void FusionCHPMultiDataAccessor::ExtractData(const vector<string> &snps, vector<
     vector<int> snpIndicies(nsnps);
     for (int isnp=0; isnp<nsnps; isnp++)
     {
-        snpIndicies[isnp] = snpNameIndexMap[snps[isnp]];
+        // Unknown SNPs are taken as the first one, as before.
+        int index = snpNameIndex.Find(snps[isnp]);
+        snpIndicies[isnp] = (index < 0 ? 0 : index);
     }
 
     // Loop over the chp files and extract the snp data
@@ -113,3 +147,100 @@ void FusionCHPMultiDataAccessor::ExtractData(const vector<string> &snps, vector<
    }
 }
 
+int FusionCHPMultiDataAccessor::GetSnpIndex(const string &snp) const
+{
+    return snpNameIndex.Find(snp);
+}
+
+/*
+ * Find the column of the genotype data set with the given name, or -1.
+ */
+static int FindGenotypeColumn(FusionCHPMultiDataData *mchp, const wstring &name)
+{
+    int ncols = mchp->GetNumColumns(GenotypeMultiDataType);
+    for (int icol=0; icol<ncols; icol++)
+    {
+        if (mchp->GetColumnInfo(GenotypeMultiDataType, icol).GetName() == name)
+            return icol;
+    }
+    return -1;
+}
+
+/*
+ * Read the calls and confidences of the SNPs of one CHP file. The values of
+ * SNP i are stored at [i*stride]. This is called from worker threads.
+ */
+static string ExtractFileData(const string &fileName, int nsnps, const vector<int> &snpIndices, int32_t *calls, double *confidences, size_t stride)
+{
+    FusionCHPData *chp = NULL;
+    try
+    {
+        chp = FusionCHPDataReg::Read(fileName);
+        FusionCHPMultiDataData *mchp = FusionCHPMultiDataData::FromBase(chp);
+        if (mchp == NULL)
+        {
+            delete chp;
+            return "Could not read multi data CHP file: " + fileName;
+        }
+        if (mchp->GetEntryCount(GenotypeMultiDataType) != nsnps)
+        {
+            delete mchp;
+            return "The number of SNPs differs from the first CHP file: " + fileName;
+        }
+
+        // The calls and the confidences are looked up by column name.
+        int callCol = FindGenotypeColumn(mchp, L"Call");
+        int confidenceCol = FindGenotypeColumn(mchp, L"Confidence");
+        if ((calls != NULL && callCol < 0) || (confidences != NULL && confidenceCol < 0))
+        {
+            delete mchp;
+            return "No 'Call' or 'Confidence' column in the genotype data of CHP file: " + fileName;
+        }
+        int n = (int)snpIndices.size();
+        if (calls != NULL && nsnps > 0)
+        {
+            vector<int32_t> values(nsnps);
+            mchp->GetColumnData(GenotypeMultiDataType, callCol, &values[0]);
+            for (int i=0; i<n; i++)
+                calls[i*stride] = values[snpIndices[i]];
+        }
+        if (confidences != NULL && nsnps > 0)
+        {
+            vector<double> values(nsnps);
+            mchp->GetColumnData(GenotypeMultiDataType, confidenceCol, &values[0]);
+            for (int i=0; i<n; i++)
+                confidences[i*stride] = values[snpIndices[i]];
+        }
+        delete mchp;
+    }
+    catch (...)
+    {
+        delete chp;
+        return "Could not read the genotype data of CHP file: " + fileName;
+    }
+    return "";
+}
+
+void FusionCHPMultiDataAccessor::ExtractData(const vector<int> &snpIndices, int32_t *calls, double *confidences, bool snpMajor, int nthreads, vector<string> &errors)
+{
+    int nchps = (int)chpFileNames.size();
+    int nsnps = snpNameIndex.GetCount();
+    size_t nrows = snpIndices.size();
+    errors.assign(nchps, "");
+    if (nthreads < 1)
+        nthreads = 1;
+
+    // Where the first value of each file goes, and the distance between the values of two SNPs.
+    size_t fileStep = (snpMajor ? 1 : nrows);
+    size_t stride = (snpMajor ? (size_t)nchps : 1);
+
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+#endif
+    for (int ichp=0; ichp<nchps; ichp++)
+    {
+        errors[ichp] = ExtractFileData(chpFileNames[ichp], nsnps, snpIndices,
+            (calls == NULL ? NULL : calls + ichp*fileStep),
+            (confidences == NULL ? NULL : confidences + ichp*fileStep), stride);
+    }
+}
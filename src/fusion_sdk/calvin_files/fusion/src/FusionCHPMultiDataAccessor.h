@@ -21,9 +21,9 @@
 #define _FusionCHPMultiDataAccessor_HEADER_
 
 #include <calvin_files/portability/src/AffymetrixBaseTypes.h>
+#include <calvin_files/utils/src/StringIndex.h>
 //
 #include <cstring>
-#include <map>
 #include <string>
 #include <vector>
 //
@@ -38,8 +38,8 @@ private:
     /*! The list of CHP file names to extract the data from. */
     std::vector<std::string> chpFileNames;
 
-    /*! A map of SNP name to CHP file index. */
-    std::map<std::string, int> snpNameIndexMap;
+    /*! The SNP names, in the order of the first CHP file, and their index. */
+    affymetrix_calvin_utilities::StringIndex snpNameIndex;
 
 public:
     /*! Constructor
@@ -54,12 +54,49 @@ public:
      */
     bool Initialize(const std::vector<std::string> &chps);
 
+    /*! Initialize the map of SNP names to indicies, using an index file. If the index file
+     * is up to date with the first CHP file, it is memory mapped instead of reading the SNP
+     * names. Otherwise it is written after the names are read.
+     * @param chps The list of CHP files to extract data from.
+     * @param indexFileName The name of the index file.
+     */
+    bool Initialize(const std::vector<std::string> &chps, const std::string &indexFileName);
+
     /*! Extract the calls and confidences for each input SNP.
      * @param snps The list of snps to extract data for.
      * @param calls A matrix to hold the calls.
      * @param confidences A matrix to hold the confidence values.
      */
     void ExtractData(const std::vector<std::string> &snps, std::vector<std::vector<u_int8_t> > &calls, std::vector<std::vector<float> > &confidences);
+
+    /*! Extract the calls and confidences for each input SNP into preallocated matrices, with one
+     * row or column per CHP file.  Several CHP files are read at the same time if compiled with
+     * OpenMP support, and the call and confidence columns of each file are read in bulk.
+     * The SNPs must be in the same order in all CHP files.
+     * @param snpIndices The indices of the SNPs to extract data for, see GetSnpIndex.
+     * @param calls A matrix to hold the calls, or NULL.
+     * @param confidences A matrix to hold the confidence values, or NULL.
+     * @param snpMajor If true, the values of a SNP are adjacent (a files x SNPs column-major matrix),
+     * otherwise those of a CHP file (a SNPs x files column-major matrix).
+     * @param nthreads The number of threads to read the CHP files with.
+     * @param errors An error message for each CHP file, empty if the file was read.
+     */
+    void ExtractData(const std::vector<int> &snpIndices, int32_t *calls, double *confidences, bool snpMajor, int nthreads, std::vector<std::string> &errors);
+
+    /*! Get the index of a SNP in the CHP files.
+     * @param snp The name of the SNP.
+     * @return The index of the SNP, -1 if not found.
+     */
+    int GetSnpIndex(const std::string &snp) const;
+
+    /*! The number of SNPs in the CHP files. */
+    int GetSnpCount() const { return snpNameIndex.GetCount(); }
+
+    /*! Get the name of a SNP.
+     * @param index The index of the SNP.
+     * @return The name of the SNP.
+     */
+    std::string GetSnpName(int index) const { return snpNameIndex.GetName(index); }
 };
 
 }
@@ -286,6 +286,31 @@ public:
      */
     std::wstring GetMetricColumnName(affymetrix_calvin_io::MultiDataType dataType, int colIndex) { return chpData.GetMetricColumnName(dataType, colIndex); }
 
+    /*! Get the number of columns of a data set, including the metric columns.
+     * @param dataType The data type
+     * @return The number of columns.
+     */
+    int32_t GetNumColumns(affymetrix_calvin_io::MultiDataType dataType) { return chpData.GetNumColumns(dataType); }
+
+    /*! Get the column information.
+     * @param dataType The data type
+     * @param col The column index (of all columns)
+     * @return The column information
+     */
+    affymetrix_calvin_io::ColumnInfo GetColumnInfo(affymetrix_calvin_io::MultiDataType dataType, int col) { return chpData.GetColumnInfo(dataType, col); }
+
+    /*! Get all values of a column of a data set.
+     * @param dataType The data type
+     * @param col The column index (of all columns)
+     * @param values The array to fill, with room for GetEntryCount(dataType) values.
+     * @return The number of values read.
+     */
+    int32_t GetColumnData(affymetrix_calvin_io::MultiDataType dataType, int col, int32_t *values) { return chpData.GetColumnData(dataType, col, values); }
+
+    int32_t GetColumnData(affymetrix_calvin_io::MultiDataType dataType, int col, double *values) { return chpData.GetColumnData(dataType, col, values); }
+
+    int32_t GetColumnData(affymetrix_calvin_io::MultiDataType dataType, int col, std::string *values) { return chpData.GetColumnData(dataType, col, values); }
+
 private:
 
 	/*! Reads the CHP file.
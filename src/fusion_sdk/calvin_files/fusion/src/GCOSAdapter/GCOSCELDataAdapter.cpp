@@ -242,6 +242,27 @@ int GCOSCELDataAdapter::GetIntensities(int index,std::vector<float>& intensities
 	return gcosCel.GetIntensities(index,intensities);
 }
 
+/*
+ */
+void GCOSCELDataAdapter::GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels)
+{
+	gcosCel.GetEntries(index, count, intensities, stdvs, pixels);
+}
+
+/*
+ */
+void GCOSCELDataAdapter::GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels)
+{
+	gcosCel.GetEntries(indices, count, intensities, stdvs, pixels);
+}
+
+/*
+ */
+bool GCOSCELDataAdapter::GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels)
+{
+	return gcosCel.GetRectangle(x, y, width, height, intensities, stdvs, pixels);
+}
+
 /*
  */
 float GCOSCELDataAdapter::GetIntensity(int x, int y)
@@ -306,6 +327,20 @@ bool GCOSCELDataAdapter::IsOutlier(int index)
 	return gcosCel.IsOutlier(index);
 }
 
+/*
+ */
+void GCOSCELDataAdapter::GetMaskedIndices(std::vector<int> &indices)
+{
+	gcosCel.GetMaskedIndices(indices);
+}
+
+/*
+ */
+void GCOSCELDataAdapter::GetOutlierIndices(std::vector<int> &indices)
+{
+	gcosCel.GetOutlierIndices(indices);
+}
+
 // For reading a file.
 /*
  */
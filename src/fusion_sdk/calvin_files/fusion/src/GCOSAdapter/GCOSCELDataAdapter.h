@@ -206,6 +206,33 @@ public:
   /// @param     intensities  vector to fill
   /// @return    non-zero on error.
 	int GetIntensities(int index,std::vector<float>& intensities);
+	/*! \brief Get intensities, standard deviations and pixels of a range of cells.
+	 *	\param index Index of the first cell.
+	 *	\param count Number of cells.
+	 *	\param intensities Buffer of count values to fill, or NULL to skip.
+	 *	\param stdvs Buffer of count values to fill, or NULL to skip.
+	 *	\param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	void GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels);
+	/*! \brief Get intensities, standard deviations and pixels of a set of cells.
+	 *	\param indices Indices of the cells.
+	 *	\param count Number of cells.
+	 *	\param intensities Buffer of count values to fill, or NULL to skip.
+	 *	\param stdvs Buffer of count values to fill, or NULL to skip.
+	 *	\param pixels Buffer of count values to fill, or NULL to skip.
+	 */
+	void GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels);
+	/*! \brief Get intensities, standard deviations and pixels of a rectangle of cells.
+	 *	\param x X coordinate of the upper left cell.
+	 *	\param y Y coordinate of the upper left cell.
+	 *	\param width Number of columns.
+	 *	\param height Number of rows.
+	 *	\param intensities Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\param stdvs Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\param pixels Buffer of width*height values to fill row by row, or NULL to skip.
+	 *	\return True if successful.
+	 */
+	bool GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels);
 	/*! \brief Get intensity by x, y position.
 	 *	\param x X position.
 	 *	\param y Y position.
@@ -258,6 +285,14 @@ public:
 	 *	\return Is index position an outlier.
 	 */
 	bool IsOutlier(int index);
+	/*! \brief Get the indices of all masked cells.
+	 *	\param indices The cell indices in increasing order.
+	 */
+	void GetMaskedIndices(std::vector<int> &indices);
+	/*! \brief Get the indices of all outlier cells.
+	 *	\param indices The cell indices in increasing order.
+	 */
+	void GetOutlierIndices(std::vector<int> &indices);
 
 	// For reading a file.
 	/*! Close the cell file. */
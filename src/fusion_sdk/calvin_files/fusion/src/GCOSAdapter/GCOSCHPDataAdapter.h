@@ -237,6 +237,9 @@ public:
 	/*! Returns the GenericData object associated with a Calvin file, NULL for GCOS files. */
 	affymetrix_calvin_io::GenericData *GetGenericData() { return NULL; }
 
+	/*! Returns the CCHPFileData object associated with a GCOS file, NULL for Calvin files. */
+	affxchp::CCHPFileData *GetGCOSData() { return &gcosChp; }
+
 protected:
 	/*! The underlying data access object */
 	affxchp::CCHPFileData gcosChp;
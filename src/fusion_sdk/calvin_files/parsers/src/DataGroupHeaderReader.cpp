@@ -29,6 +29,20 @@
 
 using namespace affymetrix_calvin_io;
 
+/*
+ * The next DataGroup follows the data of the last DataSet in the group.
+ * Only the start of that data is known unless the DataSetHeader was read fully.
+ */
+static void UnwrapNextGroupPos(DataGroupHeader& grpHdr)
+{
+	int32_t dataSetCnt = grpHdr.GetDataSetCnt();
+	if (dataSetCnt == 0)
+		return;
+	const DataSetHeader& dsh = grpHdr.GetDataSetConst(dataSetCnt-1);
+	u_int64_t minPos = dsh.GetDataStartFilePos() + dsh.GetDataSize();
+	grpHdr.SetNextGroupPos(UnwrapFilePos((u_int32_t) grpHdr.GetNextGroupPos(), minPos));
+}
+
 /*
  * Constructor
  */
@@ -42,7 +56,7 @@ DataGroupHeaderReader::DataGroupHeaderReader()
 void DataGroupHeaderReader::ReadAllMinimumInfo(std::ifstream& fileStream, FileHeader& fh, u_int32_t dataGroupCnt)
 {
 	// Get the first data group offset
-	u_int32_t nextDataGroupFilePos = fh.GetFirstDataGroupFilePos();
+	u_int64_t nextDataGroupFilePos = fh.GetFirstDataGroupFilePos();
 
 	for (u_int32_t i = 0; i < dataGroupCnt; ++i)
 	{
@@ -50,7 +64,7 @@ void DataGroupHeaderReader::ReadAllMinimumInfo(std::ifstream& fileStream, FileHe
 		DataGroupHeader dch;
 
 		// Move to the indicated position in the file
-		fileStream.seekg(nextDataGroupFilePos, std::ios_base::beg);
+		fileStream.seekg((std::streamoff) nextDataGroupFilePos, std::ios_base::beg);
 
 		nextDataGroupFilePos = ReadMinimumInfo(fileStream, dch);
 		fh.AddDataGroupHdr(dch);
@@ -63,7 +77,7 @@ void DataGroupHeaderReader::ReadAllMinimumInfo(std::ifstream& fileStream, FileHe
 void DataGroupHeaderReader::ReadAll(std::ifstream& fileStream, FileHeader& fh, u_int32_t dataGroupCnt)
 {
 	// Get the first data group offset
-	u_int32_t nextDataGroupFilePos = fh.GetFirstDataGroupFilePos();
+	u_int64_t nextDataGroupFilePos = fh.GetFirstDataGroupFilePos();
 
 	for (u_int32_t i = 0; i < dataGroupCnt; ++i)
 	{
@@ -71,7 +85,7 @@ void DataGroupHeaderReader::ReadAll(std::ifstream& fileStream, FileHeader& fh, u
 		DataGroupHeader dch;
 
 		// Move to the indicated position in the file
-		fileStream.seekg(nextDataGroupFilePos, std::ios_base::beg);
+		fileStream.seekg((std::streamoff) nextDataGroupFilePos, std::ios_base::beg);
 
 		nextDataGroupFilePos = Read(fileStream, dch);
 		fh.AddDataGroupHdr(dch);
@@ -81,7 +95,7 @@ void DataGroupHeaderReader::ReadAll(std::ifstream& fileStream, FileHeader& fh, u
 /*
  * Reads the DataGroupHeader and the minimum information for all DataSetHeaders associated with this DataGroupHeader from the file.
  */
-u_int32_t DataGroupHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, DataGroupHeader& grpHdr)
+u_int64_t DataGroupHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, DataGroupHeader& grpHdr)
 {
 	ReadDataGroupStartFilePos(fileStream, grpHdr);
 	u_int32_t dataSetCnt = ReadHeader(fileStream, grpHdr);
@@ -89,13 +103,14 @@ u_int32_t DataGroupHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, Data
 	// Read the DataSets
 	DataSetHeaderReader dphReader;
 	dphReader.ReadAllMinimumInfo(fileStream, grpHdr, dataSetCnt);
+	UnwrapNextGroupPos(grpHdr);
 	return grpHdr.GetNextGroupPos();
 }
 
 /*
  * Read the DataGroupHeader and all DataSetHeaders associated with this DataGroupHeader from the file.
  */
-u_int32_t DataGroupHeaderReader::Read(std::ifstream& fileStream, DataGroupHeader& grpHdr)
+u_int64_t DataGroupHeaderReader::Read(std::ifstream& fileStream, DataGroupHeader& grpHdr)
 {
 	ReadDataGroupStartFilePos(fileStream, grpHdr);
 	u_int32_t dataSetCnt = ReadHeader(fileStream, grpHdr);
@@ -103,6 +118,7 @@ u_int32_t DataGroupHeaderReader::Read(std::ifstream& fileStream, DataGroupHeader
 	// Read the DataSets
 	DataSetHeaderReader dphReader;
 	dphReader.ReadAll(fileStream, grpHdr, dataSetCnt);
+	UnwrapNextGroupPos(grpHdr);
 	return grpHdr.GetNextGroupPos();
 }
 
@@ -123,7 +139,7 @@ u_int32_t DataGroupHeaderReader::ReadHeader(std::ifstream& fileStream, DataGroup
  */
 void DataGroupHeaderReader::ReadDataGroupStartFilePos(std::ifstream& fileStream, DataGroupHeader& grpHdr)
 {
-	grpHdr.SetHeaderStartFilePos(fileStream.tellg());
+	grpHdr.SetHeaderStartFilePos((u_int64_t) (std::streamoff) fileStream.tellg());
 }
 
 /*
@@ -134,7 +150,7 @@ void DataGroupHeaderReader::ReadNextDataGroupFilePos(std::ifstream& fileStream,
 	//DEBUG
 	//u_int32_t z = fileStream.tellg();
 
-	dch.SetNextGroupPos(FileInput::ReadUInt32(fileStream));
+	dch.SetNextGroupPos(UnwrapFilePos(FileInput::ReadUInt32(fileStream), dch.GetHeaderStartFilePos()));
 }
 
 /*
@@ -145,7 +161,7 @@ void DataGroupHeaderReader::ReadFirstDataSetFilePos(std::ifstream& fileStream, D
 	//DEBUG
 	//u_int32_t z = fileStream.tellg();
 
-	dch.SetDataSetPos(FileInput::ReadUInt32(fileStream));
+	dch.SetDataSetPos(UnwrapFilePos(FileInput::ReadUInt32(fileStream), dch.GetHeaderStartFilePos()));
 }
 
 /*
@@ -69,7 +69,7 @@ public:
 	 *	@param dch DataGroupHeader object to fill.
 	 *	@return The file position of the next data group
 	 */
-	u_int32_t ReadMinimumInfo(std::ifstream& fileStream, DataGroupHeader& dch);
+	u_int64_t ReadMinimumInfo(std::ifstream& fileStream, DataGroupHeader& dch);
 
 	/*! Read the DataGroupHeader and all DataSetHeaders associated with this DataGroupHeader
 	 *	from the file.
@@ -77,7 +77,7 @@ public:
 	 *	@param dch DataGroupHeader object to fill.
 	 *	@return The file position of the next data group
 	 */
-	u_int32_t Read(std::ifstream& fileStream, DataGroupHeader& dch);
+	u_int64_t Read(std::ifstream& fileStream, DataGroupHeader& dch);
 
 	/*! Reads the DataGroupHeader from the file.  Doesn't read all DataSetHeader information.
 	 *	@param fileStream Open fstream positioned at the start of a DataGroupHeader in the file.
@@ -43,14 +43,14 @@ DataSetHeaderReader::DataSetHeaderReader()
 void DataSetHeaderReader::ReadAllMinimumInfo(std::ifstream& fileStream, DataGroupHeader& dch, u_int32_t dataSetCnt)
 {
 	// Get the first dataSet offset
-	u_int32_t nextDataSetFilePos = dch.GetDataSetPos();
+	u_int64_t nextDataSetFilePos = dch.GetDataSetPos();
 
 	for (u_int32_t i = 0; i < dataSetCnt; ++i)
 	{
 		DataSetHeader dph;
 
 		// Move to the indicated position in the file
-		fileStream.seekg(nextDataSetFilePos, std::ios_base::beg);
+		fileStream.seekg((std::streamoff) nextDataSetFilePos, std::ios_base::beg);
 
 		nextDataSetFilePos = ReadMinimumInfo(fileStream, dph);
 
@@ -65,14 +65,14 @@ void DataSetHeaderReader::ReadAllMinimumInfo(std::ifstream& fileStream, DataGrou
 void DataSetHeaderReader::ReadAll(std::ifstream& fileStream, DataGroupHeader& dch, u_int32_t dataSetCnt)
 {
 	// Get the first dataSet offset
-	u_int32_t nextDataSetFilePos = dch.GetDataSetPos();
+	u_int64_t nextDataSetFilePos = dch.GetDataSetPos();
 
 	for (u_int32_t i = 0; i < dataSetCnt; ++i)
 	{
 		DataSetHeader dph;
 
 		// Move to the indicated position in the file
-		fileStream.seekg(nextDataSetFilePos, std::ios_base::beg);
+		fileStream.seekg((std::streamoff) nextDataSetFilePos, std::ios_base::beg);
 
 		nextDataSetFilePos = Read(fileStream, dph);
 
@@ -84,11 +84,11 @@ void DataSetHeaderReader::ReadAll(std::ifstream& fileStream, DataGroupHeader& dc
 /*
 	* Reads the minimum DataSetHeader information.
 	*/
-u_int32_t DataSetHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, DataSetHeader& dsh)
+u_int64_t DataSetHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, DataSetHeader& dsh)
 {
 	ReadDataSetStartFilePos(fileStream, dsh);
 	ReadDataFilePos(fileStream, dsh);
-	u_int32_t nextDataSetFilePos = ReadNextDataSetFilePos(fileStream, dsh);
+	u_int64_t nextDataSetFilePos = ReadNextDataSetFilePos(fileStream, dsh);
 	ReadName(fileStream, dsh);
 	
 	return nextDataSetFilePos;
@@ -97,16 +97,20 @@ u_int32_t DataSetHeaderReader::ReadMinimumInfo(std::ifstream& fileStream, DataSe
 /*
  * Reads the complete DataSetHeader information.
  */
-u_int32_t DataSetHeaderReader::Read(std::ifstream& fileStream, DataSetHeader& dsh)
+u_int64_t DataSetHeaderReader::Read(std::ifstream& fileStream, DataSetHeader& dsh)
 {
 	ReadDataSetStartFilePos(fileStream, dsh);
 	ReadDataFilePos(fileStream, dsh);
-	u_int32_t nextDataSetFilePos = ReadNextDataSetFilePos(fileStream, dsh);
+	u_int64_t nextDataSetFilePos = ReadNextDataSetFilePos(fileStream, dsh);
 	ReadName(fileStream, dsh);
 	ReadParameters(fileStream, dsh);
 	ReadColumns(fileStream, dsh);
 	ReadRowCount(fileStream, dsh);
 
+	// The next DataSet follows the data, which may itself be larger than 4 GB.
+	nextDataSetFilePos = UnwrapFilePos((u_int32_t) nextDataSetFilePos, dsh.GetDataStartFilePos() + dsh.GetDataSize());
+	dsh.SetNextSetFilePos(nextDataSetFilePos);
+
 //	dph.SetDataStartFilePos(fileStream.tellg());	// set the offset to the start of the data
 
 	return nextDataSetFilePos;
@@ -117,7 +121,7 @@ u_int32_t DataSetHeaderReader::Read(std::ifstream& fileStream, DataSetHeader& ds
  */
 void DataSetHeaderReader::ReadDataSetStartFilePos(std::ifstream& fileStream, DataSetHeader& dsh)
 {
-	dsh.SetHeaderStartFilePos(fileStream.tellg());
+	dsh.SetHeaderStartFilePos((u_int64_t) (std::streamoff) fileStream.tellg());
 }
 
 /*
@@ -125,15 +129,17 @@ void DataSetHeaderReader::ReadDataSetStartFilePos(std::ifstream& fileStream, Dat
  */
 void DataSetHeaderReader::ReadDataFilePos(std::ifstream& fileStream, DataSetHeader& dsh)
 {
-	dsh.SetDataStartFilePos(FileInput::ReadUInt32(fileStream));
+	// The data follows the header.
+	dsh.SetDataStartFilePos(UnwrapFilePos(FileInput::ReadUInt32(fileStream), dsh.GetHeaderStartFilePos()));
 }
 
 /*
  * Read the file position to the next DataSet.
  */
-u_int32_t DataSetHeaderReader::ReadNextDataSetFilePos(std::ifstream& fileStream, DataSetHeader& dsh)
+u_int64_t DataSetHeaderReader::ReadNextDataSetFilePos(std::ifstream& fileStream, DataSetHeader& dsh)
 {
-	u_int32_t nextDataSetFilePos = FileInput::ReadUInt32(fileStream);
+	// The next DataSet follows the data.  This is refined by Read() once the data size is known.
+	u_int64_t nextDataSetFilePos = UnwrapFilePos(FileInput::ReadUInt32(fileStream), dsh.GetDataStartFilePos());
 	dsh.SetNextSetFilePos(nextDataSetFilePos);
 	return nextDataSetFilePos;
 }
@@ -67,14 +67,14 @@ public:
 	 *	@param dsh Reference to the DataSetHeader object to fill.
 	 *	@return The file position of the next DataSet.
 	 */
-	u_int32_t ReadMinimumInfo(std::ifstream& fileStream, DataSetHeader& dsh);
+	u_int64_t ReadMinimumInfo(std::ifstream& fileStream, DataSetHeader& dsh);
 
 	/*! Reads the complete DataSetHeader information.
 	 *	@param fileStream Open fstream positioned at the start of the DataSetHeader.
 	 *	@param dsh Reference to the DataSetHeader object to fill.
 	 *	@return The file position of the next DataSet.
 	 */
-	u_int32_t Read(std::ifstream& fileStream, DataSetHeader& dsh);
+	u_int64_t Read(std::ifstream& fileStream, DataSetHeader& dsh);
 
 protected:
 	/*! Read the file position of the start of the DataSet.
@@ -94,7 +94,7 @@ protected:
 	 *	@param dsh Reference to the DataSetHeader object to fill.
 	 *	@return The file position of the next data set.
 	 */
-	u_int32_t ReadNextDataSetFilePos(std::ifstream& fileStream, DataSetHeader& dsh);
+	u_int64_t ReadNextDataSetFilePos(std::ifstream& fileStream, DataSetHeader& dsh);
 
 	/*! Read the DataSetHeader name.
 	 *	@param fileStream Open fstream positioned at the start of the DataSetHeader name.
@@ -31,7 +31,7 @@ using namespace affymetrix_calvin_io;
 DataSetReader::DataSetReader(std::ifstream& is, DataSetHeader& dph) : fileStream(is), dataSetHdr(dph)
 {
 	// Position the file stream to the start of the DataSet
-	fileStream.seekg(dataSetHdr.GetDataStartFilePos());
+	fileStream.seekg((std::streamoff) dataSetHdr.GetDataStartFilePos());
 }
 
 /*
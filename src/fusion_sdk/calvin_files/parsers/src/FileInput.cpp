@@ -23,6 +23,8 @@
 
 #include "calvin_files/parsers/src/FileInput.h"
 //
+#include "file/FileIO.h"
+//
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -221,6 +223,116 @@ float FileInput::ReadFloat(char * &instr)
 	return fval;
 }
 
+/*
+ * Copy an array of 16 bit numbers from big endian to host order.
+ * Contiguous arrays are shuffled with the vectorized kernels of FileIO.
+ */
+static void CopyFromBigEndian16(const char *instr, int32_t count, char *values, int32_t stride)
+{
+	if (stride == sizeof(u_int16_t))
+	{
+#if BYTE_ORDER == BIG_ENDIAN
+		memcpy(values, instr, sizeof(u_int16_t)*(size_t)count);
+#else
+		affy_swap16_array(values, instr, count);
+#endif
+		return;
+	}
+	u_int16_t val;
+	for (int32_t i=0; i<count; i++)
+	{
+		memcpy(&val, instr + (size_t)stride*i, sizeof(val));
+#if BYTE_ORDER == LITTLE_ENDIAN
+		val = affy_swap16(val);
+#endif
+		memcpy(values + sizeof(u_int16_t)*(size_t)i, &val, sizeof(val));
+	}
+}
+
+/*
+ * Copy an array of 32 bit numbers from big endian to host order.
+ * Contiguous arrays are shuffled with the vectorized kernels of FileIO.
+ */
+static void CopyFromBigEndian32(const char *instr, int32_t count, char *values, int32_t stride)
+{
+	if (stride == sizeof(u_int32_t))
+	{
+#if BYTE_ORDER == BIG_ENDIAN
+		memcpy(values, instr, sizeof(u_int32_t)*(size_t)count);
+#else
+		affy_swap32_array(values, instr, count);
+#endif
+		return;
+	}
+	u_int32_t val;
+	for (int32_t i=0; i<count; i++)
+	{
+		memcpy(&val, instr + (size_t)stride*i, sizeof(val));
+#if BYTE_ORDER == LITTLE_ENDIAN
+		val = affy_swap32(val);
+#endif
+		memcpy(values + sizeof(u_int32_t)*(size_t)i, &val, sizeof(val));
+	}
+}
+
+/*
+ * Read an array of 8 bit numbers from a memory stream.
+ */
+void FileInput::ReadInt8Array(const char *instr, int32_t count, int8_t *values, int32_t stride)
+{
+	for (int32_t i=0; i<count; i++)
+		values[i] = *(const int8_t *)(instr + (size_t)stride*i);
+}
+
+/*
+ * Read an array of 8 bit unsigned numbers from a memory stream.
+ */
+void FileInput::ReadUInt8Array(const char *instr, int32_t count, u_int8_t *values, int32_t stride)
+{
+	for (int32_t i=0; i<count; i++)
+		values[i] = *(const u_int8_t *)(instr + (size_t)stride*i);
+}
+
+/*
+ * Read an array of 16 bit numbers from a memory stream.
+ */
+void FileInput::ReadInt16Array(const char *instr, int32_t count, int16_t *values, int32_t stride)
+{
+	CopyFromBigEndian16(instr, count, (char *)values, stride);
+}
+
+/*
+ * Read an array of 16 bit unsigned numbers from a memory stream.
+ */
+void FileInput::ReadUInt16Array(const char *instr, int32_t count, u_int16_t *values, int32_t stride)
+{
+	CopyFromBigEndian16(instr, count, (char *)values, stride);
+}
+
+/*
+ * Read an array of 32 bit numbers from a memory stream.
+ */
+void FileInput::ReadInt32Array(const char *instr, int32_t count, int32_t *values, int32_t stride)
+{
+	CopyFromBigEndian32(instr, count, (char *)values, stride);
+}
+
+/*
+ * Read an array of 32 bit unsigned numbers from a memory stream.
+ */
+void FileInput::ReadUInt32Array(const char *instr, int32_t count, u_int32_t *values, int32_t stride)
+{
+	CopyFromBigEndian32(instr, count, (char *)values, stride);
+}
+
+/*
+ * Read an array of 32 bit floating point values from a memory stream.
+ */
+void FileInput::ReadFloatArray(const char *instr, int32_t count, float *values, int32_t stride)
+{
+	CopyFromBigEndian32(instr, count, (char *)values, stride);
+}
+
 #ifndef AFFY_UNALIGNED_IN_SW  // If unaligned accesses to memory are allowed
 
 /*
@@ -135,6 +135,69 @@ public:
 	*/
 	static float ReadFloat(char * &instr);
 
+	/*! Reads an array of 8 bit integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadInt8Array(const char *instr, int32_t count, int8_t *values, int32_t stride=sizeof(int8_t));
+
+	/*! Reads an array of 8 bit unsigned integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadUInt8Array(const char *instr, int32_t count, u_int8_t *values, int32_t stride=sizeof(u_int8_t));
+
+	/*! Reads an array of 16 bit integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadInt16Array(const char *instr, int32_t count, int16_t *values, int32_t stride=sizeof(int16_t));
+
+	/*! Reads an array of 16 bit unsigned integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadUInt16Array(const char *instr, int32_t count, u_int16_t *values, int32_t stride=sizeof(u_int16_t));
+
+	/*! Reads an array of 32 bit integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadInt32Array(const char *instr, int32_t count, int32_t *values, int32_t stride=sizeof(int32_t));
+
+	/*! Reads an array of 32 bit unsigned integers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadUInt32Array(const char *instr, int32_t count, u_int32_t *values, int32_t stride=sizeof(u_int32_t));
+
+	/*! Reads an array of 32 bit floating point numbers from a big endian memory buffer.
+	*
+	* @param instr Pointer to the first value.
+	* @param count The number of values to read.
+	* @param values The array to receive the values.
+	* @param stride The number of bytes between consecutive values.
+	*/
+	static void ReadFloatArray(const char *instr, int32_t count, float *values, int32_t stride=sizeof(float));
+
 	/*! Reads a 16 bit unicode string of fixed size from a big endian file.
 	*
 	* @param instr The input file stream.
@@ -28,11 +28,14 @@
 #include <fcntl.h>
 #include <sstream>
 #include <string>
+#include <sys/stat.h>
 #include <sys/types.h>
 //
 
 #ifdef _WIN32
 #include <direct.h>
+#include <process.h>
+#define getpid _getpid
 #define 	S_ISDIR(m)   (((m) & S_IFMT) == S_IFDIR)
 #else
 #include <unistd.h>
@@ -53,6 +56,9 @@ using namespace std;
 
 static string LockFileExtension = ".lock";
 
+/*! The number of bytes at the start of a file that are checksummed by GetFileKey. */
+#define FILE_KEY_CHECKSUM_BYTES 4096
+
 /** Little template function to make string conversion easy. 
     this isn't the fastest way to do things, but it is easy. */
 template <class T> 
@@ -407,3 +413,53 @@ void FileUtils::RemovePath(const char *path)
 
 }
 
+bool FileUtils::GetFileKey(const char *fileName, FileKey &key)
+{
+	struct stat st;
+	if (stat(fileName, &st) != 0)
+		return false;
+	key.size = (u_int64_t)st.st_size;
+	key.mtime = (int64_t)st.st_mtime;
+
+	FILE *fp = fopen(fileName, "rb");
+	if (fp == NULL)
+		return false;
+	unsigned char buffer[FILE_KEY_CHECKSUM_BYTES];
+	size_t n = fread(buffer, 1, sizeof(buffer), fp);
+	fclose(fp);
+	u_int64_t hash = 14695981039346656037ULL;
+	for (size_t i=0; i<n; i++)
+	{
+		hash ^= buffer[i];
+		hash *= 1099511628211ULL;
+	}
+	key.checksum = hash;
+	return true;
+}
+
+FILE *FileUtils::OpenTempFile(const char *fileName, string &tmpFileName)
+{
+	char suffix[64];
+	sprintf(suffix, ".%d.tmp", (int)getpid());
+	tmpFileName = string(fileName) + suffix;
+	return fopen(tmpFileName.c_str(), "wb");
+}
+
+bool FileUtils::CommitTempFile(FILE *fp, bool ok, const string &tmpFileName, const char *fileName)
+{
+	ok = (fclose(fp) == 0) && ok;
+	return CommitTempFile(ok, tmpFileName, fileName);
+}
+
+bool FileUtils::CommitTempFile(bool ok, const string &tmpFileName, const char *fileName)
+{
+	if (ok && rename(tmpFileName.c_str(), fileName) != 0)
+	{
+		// On Windows, an existing (out of date) file is not replaced.
+		remove(fileName);
+		ok = (rename(tmpFileName.c_str(), fileName) == 0);
+	}
+	if (ok == false)
+		remove(tmpFileName.c_str());
+	return ok;
+}
@@ -24,6 +24,9 @@
 /*! \file FileUtils.h This file provides file utilities.
  */
 
+#include "calvin_files/portability/src/AffymetrixBaseTypes.h"
+//
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <list>
@@ -33,6 +36,28 @@
 namespace affymetrix_calvin_utilities
 {
 
+/*! Identifies the contents of a file by its size, its modification time and a
+ * checksum of its first bytes. Files derived from another file, e.g. caches and
+ * indices, hold the key of their source file to detect when it has changed.
+ */
+typedef struct _FileKey
+{
+	/*! The size of the file. */
+	u_int64_t size;
+
+	/*! The modification time of the file. */
+	int64_t mtime;
+
+	/*! The FNV-1a hash of the first bytes of the file, which hold its header. */
+	u_int64_t checksum;
+
+	/*! Compares two keys. */
+	bool operator==(const _FileKey &key) const
+	{
+		return size == key.size && mtime == key.mtime && checksum == key.checksum;
+	}
+} FileKey;
+
 /*! This class provides utility functions for files. */
 class FileUtils
 {
@@ -81,6 +106,47 @@ public:
 	 * @return True if the path was deleted.
 	 */
 	static void RemovePath(const char *path);
+
+	/*! Gets the key of a file.
+	 *
+	 * @param fileName The name of the file.
+	 * @param key The key of the file.
+	 * @return False if the file cannot be read.
+	 */
+	static bool GetFileKey(const char *fileName, FileKey &key);
+
+	/*! Opens a temporary file to write a file under. The file is later put in
+	 * place by CommitTempFile, so that concurrent readers and writers only ever
+	 * see complete files.
+	 *
+	 * @param fileName The name of the file to write.
+	 * @param tmpFileName The name of the temporary file, unique to the process.
+	 * @return The temporary file, or NULL if it cannot be created.
+	 */
+	static FILE *OpenTempFile(const char *fileName, std::string &tmpFileName);
+
+	/*! Closes a temporary file opened by OpenTempFile and, if it was written
+	 * successfully, renames it to the file, replacing an existing file.
+	 * Otherwise the temporary file is removed.
+	 *
+	 * @param fp The temporary file.
+	 * @param ok True if the temporary file was written successfully.
+	 * @param tmpFileName The name of the temporary file.
+	 * @param fileName The name of the file to write.
+	 * @return True if the file was written.
+	 */
+	static bool CommitTempFile(FILE *fp, bool ok, const std::string &tmpFileName, const char *fileName);
+
+	/*! Renames a temporary file that was written and closed, e.g. by another
+	 * writer that opened it by name, to the file, replacing an existing file.
+	 * If it was not written successfully, the temporary file is removed.
+	 *
+	 * @param ok True if the temporary file was written successfully.
+	 * @param tmpFileName The name of the temporary file.
+	 * @param fileName The name of the file to write.
+	 * @return True if the file was written.
+	 */
+	static bool CommitTempFile(bool ok, const std::string &tmpFileName, const char *fileName);
 };
 
 };
@@ -0,0 +1,458 @@
+////////////////////////////////////////////////////////////////
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License
+// (version 2.1) as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#include "calvin_files/utils/src/StringIndex.h"
+//
+#include "calvin_files/utils/src/FileUtils.h"
+//
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/types.h>
+//
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+//
+
+using namespace affymetrix_calvin_utilities;
+using namespace std;
+
+/*! Identifies an index file and its format version. */
+static const char STRING_INDEX_MAGIC[8] = { 'A','F','F','X','S','I','X','\0' };
+#define STRING_INDEX_VERSION 3
+#define STRING_INDEX_BYTE_ORDER 0x01020304
+
+/*! The header of an index file. It is followed by the offsets, the hash table,
+ * the sort order and the names, each padded to a multiple of eight bytes. */
+typedef struct _StringIndexHeader
+{
+	char magic[8];
+	u_int32_t version;
+	u_int32_t byteOrder;
+	u_int64_t sourceSize;
+	int64_t sourceMtime;
+	u_int64_t sourceChecksum;
+	int32_t count;
+	u_int32_t numSlots;
+	u_int64_t nameBytes;
+	int32_t firstOfEqualNames;
+} StringIndexHeader;
+
+/*
+ * FNV-1a hash of a sequence of bytes.
+ */
+static u_int64_t HashBytes(const char *p, size_t len)
+{
+	u_int64_t hash = 14695981039346656037ULL;
+	for (size_t i=0; i<len; i++)
+	{
+		hash ^= (unsigned char)p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static size_t Padded(size_t n)
+{
+	return (n + 7) & ~((size_t)7);
+}
+
+/*
+ * Fill in the size, modification time and checksum of the source file.
+ */
+static bool GetSourceKey(const string &fileName, StringIndexHeader &header)
+{
+	FileKey key;
+	if (FileUtils::GetFileKey(fileName.c_str(), key) == false)
+		return false;
+	header.sourceSize = key.size;
+	header.sourceMtime = key.mtime;
+	header.sourceChecksum = key.checksum;
+	return true;
+}
+
+/*
+ * The size of an index file.
+ */
+static u_int64_t GetFileSize(const StringIndexHeader &header)
+{
+	return Padded(sizeof(StringIndexHeader)) +
+		Padded(((size_t)header.count + 1)*sizeof(u_int32_t)) +
+		Padded((size_t)header.numSlots*sizeof(int32_t)) +
+		Padded((size_t)header.count*sizeof(int32_t)) +
+		Padded((size_t)header.nameBytes);
+}
+
+namespace
+{
+
+/*! Orders the indices of names by the bytes of the names, and equal names by index. */
+class NameOrder
+{
+public:
+	NameOrder(const u_int32_t *o, const char *n) : offsets(o), names(n) {}
+
+	bool operator()(int32_t i, int32_t j) const
+	{
+		u_int32_t leni = offsets[i+1] - offsets[i];
+		u_int32_t lenj = offsets[j+1] - offsets[j];
+		int cmp = memcmp(names + offsets[i], names + offsets[j], leni < lenj ? leni : lenj);
+		if (cmp != 0)
+			return cmp < 0;
+		if (leni != lenj)
+			return leni < lenj;
+		return i < j;
+	}
+
+private:
+	const u_int32_t *offsets;
+	const char *names;
+};
+
+}
+
+StringIndex::StringIndex(bool first) : firstOfEqualNames(first), count(0), numSlots(0), offsets(NULL), slots(NULL), names(NULL), order(NULL), map(NULL), mapLen(0)
+{
+	Clear();
+}
+
+StringIndex::~StringIndex()
+{
+	Clear();
+}
+
+void StringIndex::Clear()
+{
+	if (map != NULL)
+	{
+#ifdef _MSC_VER
+		delete[] (char *)map;
+#else
+		munmap(map, mapLen);
+#endif
+		map = NULL;
+		mapLen = 0;
+	}
+	count = 0;
+	numSlots = 0;
+	offsetData.assign(1, 0);
+	slotData.clear();
+	nameData.clear();
+	orderData.clear();
+	UpdatePointers();
+}
+
+void StringIndex::UpdatePointers()
+{
+	numSlots = (u_int32_t)slotData.size();
+	offsets = &offsetData[0];
+	slots = (slotData.empty() ? NULL : &slotData[0]);
+	names = (nameData.empty() ? "" : &nameData[0]);
+	order = (orderData.empty() ? NULL : &orderData[0]);
+}
+
+void StringIndex::Reserve(int32_t n, size_t nameBytes)
+{
+	Unmap();
+	offsetData.reserve(n + 1);
+	nameData.reserve(nameBytes);
+	u_int32_t m = 16;
+	while (m < 2*(u_int32_t)n)
+		m *= 2;
+	if (m > numSlots)
+		Rehash(m);
+}
+
+void StringIndex::Unmap()
+{
+	if (map == NULL)
+		return;
+	vector<u_int32_t> o(offsets, offsets + count + 1);
+	vector<int32_t> s(slots, slots + numSlots);
+	vector<char> c(names, names + offsets[count]);
+	vector<int32_t> r;
+	if (order != NULL)
+		r.assign(order, order + count);
+	int32_t n = count;
+	Clear();
+	count = n;
+	offsetData.swap(o);
+	slotData.swap(s);
+	nameData.swap(c);
+	orderData.swap(r);
+	UpdatePointers();
+}
+
+void StringIndex::Rehash(u_int32_t n)
+{
+	slotData.assign(n, -1);
+	const char *base = (nameData.empty() ? "" : &nameData[0]);
+	u_int32_t mask = n - 1;
+	for (int32_t i=0; i<count; i++)
+	{
+		u_int32_t len = offsetData[i+1] - offsetData[i];
+		u_int32_t slot = (u_int32_t)HashBytes(base + offsetData[i], len) & mask;
+		while (slotData[slot] >= 0)
+		{
+			// Only the first or the last of equal names is indexed.
+			int32_t j = slotData[slot];
+			if (offsetData[j+1] - offsetData[j] == len && memcmp(base + offsetData[j], base + offsetData[i], len) == 0)
+				break;
+			slot = (slot + 1) & mask;
+		}
+		if (slotData[slot] < 0 || firstOfEqualNames == false)
+			slotData[slot] = i;
+	}
+	UpdatePointers();
+}
+
+void StringIndex::Add(const char *name, size_t len)
+{
+	Unmap();
+	if (2*((u_int32_t)count + 1) > numSlots)
+		Rehash(numSlots < 16 ? 16 : 2*numSlots);
+
+	nameData.insert(nameData.end(), name, name + len);
+	offsetData.push_back((u_int32_t)nameData.size());
+	orderData.clear();
+	UpdatePointers();
+
+	u_int32_t mask = numSlots - 1;
+	u_int32_t slot = (u_int32_t)HashBytes(name, len) & mask;
+	while (slotData[slot] >= 0)
+	{
+		int32_t j = slotData[slot];
+		if (offsets[j+1] - offsets[j] == len && memcmp(names + offsets[j], name, len) == 0)
+			break;
+		slot = (slot + 1) & mask;
+	}
+	if (slotData[slot] < 0 || firstOfEqualNames == false)
+		slotData[slot] = count;
+	++count;
+}
+
+int32_t StringIndex::Find(const char *name, size_t len) const
+{
+	if (numSlots == 0)
+		return -1;
+	u_int32_t mask = numSlots - 1;
+	u_int32_t slot = (u_int32_t)HashBytes(name, len) & mask;
+	while (slots[slot] >= 0)
+	{
+		int32_t j = slots[slot];
+		if (offsets[j+1] - offsets[j] == len && memcmp(names + offsets[j], name, len) == 0)
+			return j;
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+void StringIndex::GetOrder(vector<int32_t> &o) const
+{
+	if (order != NULL)
+	{
+		o.assign(order, order + count);
+		return;
+	}
+	o.resize(count);
+	for (int32_t i=0; i<count; i++)
+		o[i] = i;
+	sort(o.begin(), o.end(), NameOrder(offsets, names));
+}
+
+void StringIndex::Sort()
+{
+	if (order != NULL || count == 0)
+		return;
+	Unmap();
+	GetOrder(orderData);
+	UpdatePointers();
+}
+
+int StringIndex::ComparePrefix(int32_t index, const char *prefix, size_t len) const
+{
+	size_t n = offsets[index+1] - offsets[index];
+	int cmp = memcmp(names + offsets[index], prefix, n < len ? n : len);
+	if (cmp != 0)
+		return cmp;
+	return (n < len ? -1 : 0);
+}
+
+void StringIndex::FindPrefix(const char *prefix, size_t len, vector<int32_t> &indices) const
+{
+	indices.clear();
+	if (order == NULL)
+	{
+		for (int32_t i=0; i<count; i++)
+		{
+			if (ComparePrefix(i, prefix, len) == 0)
+				indices.push_back(i);
+		}
+		return;
+	}
+
+	// The names with the prefix follow each other in the sort order.
+	int32_t lo = 0, hi = count;
+	while (lo < hi)
+	{
+		int32_t mid = lo + (hi - lo)/2;
+		if (ComparePrefix(order[mid], prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (int32_t i=lo; i<count && ComparePrefix(order[i], prefix, len) == 0; i++)
+		indices.push_back(order[i]);
+	sort(indices.begin(), indices.end());
+}
+
+bool StringIndex::Write(const string &fileName, const string &sourceFileName) const
+{
+	StringIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STRING_INDEX_MAGIC, sizeof(header.magic));
+	header.version = STRING_INDEX_VERSION;
+	header.byteOrder = STRING_INDEX_BYTE_ORDER;
+	if (GetSourceKey(sourceFileName, header) == false)
+		return false;
+	header.count = count;
+	header.numSlots = numSlots;
+	header.nameBytes = offsets[count];
+	header.firstOfEqualNames = (firstOfEqualNames ? 1 : 0);
+
+	vector<int32_t> sortOrder;
+	GetOrder(sortOrder);
+
+	string tmpFileName;
+	FILE *fp = FileUtils::OpenTempFile(fileName.c_str(), tmpFileName);
+	if (fp == NULL)
+		return false;
+
+	static const char padding[8] = { 0 };
+	const void *sections[5] = { &header, offsets, slots,
+		(sortOrder.empty() ? NULL : &sortOrder[0]), names };
+	size_t sizes[5] = { sizeof(header), ((size_t)count + 1)*sizeof(u_int32_t),
+		(size_t)numSlots*sizeof(int32_t), (size_t)count*sizeof(int32_t),
+		(size_t)header.nameBytes };
+	bool ok = true;
+	for (int i=0; i<5 && ok; i++)
+	{
+		size_t pad = Padded(sizes[i]) - sizes[i];
+		ok = (sizes[i] == 0 || fwrite(sections[i], 1, sizes[i], fp) == sizes[i]) &&
+			(fwrite(padding, 1, pad, fp) == pad);
+	}
+	return FileUtils::CommitTempFile(fp, ok, tmpFileName, fileName.c_str());
+}
+
+bool StringIndex::Map(const string &fileName, const string &sourceFileName)
+{
+	Clear();
+
+	StringIndexHeader key;
+	if (GetSourceKey(sourceFileName, key) == false)
+		return false;
+
+	struct stat st;
+	if (stat(fileName.c_str(), &st) != 0 || (u_int64_t)st.st_size < sizeof(StringIndexHeader))
+		return false;
+	size_t len = (size_t)st.st_size;
+	if ((u_int64_t)len != (u_int64_t)st.st_size)
+		return false;
+
+#ifdef _MSC_VER
+	// Read the whole file on Windows.
+	FILE *fp = fopen(fileName.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+	char *buffer = new char[len];
+	size_t n = fread(buffer, 1, len, fp);
+	fclose(fp);
+	if (n != len)
+	{
+		delete[] buffer;
+		return false;
+	}
+	void *m = buffer;
+#else
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	void *m = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED)
+		return false;
+#endif
+	map = m;
+	mapLen = len;
+
+	// Validate the header against the source file.
+	const StringIndexHeader *header = (const StringIndexHeader *)map;
+	if (memcmp(header->magic, STRING_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != STRING_INDEX_VERSION ||
+		header->byteOrder != STRING_INDEX_BYTE_ORDER ||
+		header->sourceSize != key.sourceSize ||
+		header->sourceMtime != key.sourceMtime ||
+		header->sourceChecksum != key.sourceChecksum ||
+		header->firstOfEqualNames != (firstOfEqualNames ? 1 : 0) ||
+		header->count < 0 || header->numSlots < 2*(u_int64_t)header->count ||
+		(header->numSlots & (header->numSlots - 1)) != 0 ||
+		GetFileSize(*header) != len)
+	{
+		Clear();
+		return false;
+	}
+
+	const char *p = (const char *)map + Padded(sizeof(StringIndexHeader));
+	const u_int32_t *o = (const u_int32_t *)p;
+	p += Padded(((size_t)header->count + 1)*sizeof(u_int32_t));
+	const int32_t *s = (const int32_t *)p;
+	p += Padded((size_t)header->numSlots*sizeof(int32_t));
+	const int32_t *r = (const int32_t *)p;
+	p += Padded((size_t)header->count*sizeof(int32_t));
+
+	// The offsets and the hash table must be within the data, and the
+	// table must have empty slots, so that lookups need no further checks.
+	bool ok = (o[0] == 0 && o[header->count] == header->nameBytes);
+	for (int32_t i=0; i<header->count && ok; i++)
+		ok = (o[i] <= o[i+1]);
+	u_int32_t numEmpty = 0;
+	for (u_int32_t i=0; i<header->numSlots && ok; i++)
+	{
+		ok = (s[i] >= -1 && s[i] < header->count);
+		if (s[i] < 0)
+			++numEmpty;
+	}
+	ok = ok && (header->numSlots == 0 || numEmpty > 0);
+	for (int32_t i=0; i<header->count && ok; i++)
+		ok = (r[i] >= 0 && r[i] < header->count);
+	if (ok == false)
+	{
+		Clear();
+		return false;
+	}
+
+	count = header->count;
+	numSlots = header->numSlots;
+	offsets = o;
+	slots = s;
+	order = (count > 0 ? r : NULL);
+	names = p;
+	return true;
+}
@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License
+// (version 2.1) as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _StringIndex_HEADER_
+#define _StringIndex_HEADER_
+
+#include "calvin_files/portability/src/AffymetrixBaseTypes.h"
+//
+#include <cstring>
+#include <string>
+#include <vector>
+//
+
+namespace affymetrix_calvin_utilities
+{
+
+/*! Maps names, e.g. probe set names, to their index in a list of names.
+ *
+ * The names are stored one after the other in a single buffer and are
+ * looked up in an open addressing hash table, which uses far less memory
+ * than a map of strings.  Once sorted, names can also be looked up by
+ * prefix.  The index can be written to a file and later be memory mapped
+ * from it, instead of building it again.
+ */
+class StringIndex
+{
+public:
+	/*! Constructor
+	 * @param first If true, a name that is added more than once
+	 * refers to its first index, as with match() in R. Otherwise it refers
+	 * to its last index, as with the assignment to a std::map.
+	 */
+	StringIndex(bool first = false);
+
+	/*! Destructor */
+	~StringIndex();
+
+	/*! Removes all names and unmaps the index file. */
+	void Clear();
+
+	/*! Allocates the storage for a number of names.
+	 * @param count The number of names.
+	 * @param nameBytes The total number of bytes of the names.
+	 */
+	void Reserve(int32_t count, size_t nameBytes);
+
+	/*! Adds a name. Its index is the number of names added before it. Whether a
+	 * name that was added before then refers to the new index is set by the
+	 * constructor.
+	 * @param name The name.
+	 * @param len The number of bytes of the name.
+	 */
+	void Add(const char *name, size_t len);
+
+	/*! Adds a name. */
+	void Add(const std::string &name) { Add(name.data(), name.size()); }
+
+	/*! Adds a name, which is indexed by its wide characters. */
+	void Add(const std::wstring &name) { Add((const char *)name.data(), name.size()*sizeof(wchar_t)); }
+
+	/*! Finds a name.
+	 * @param name The name.
+	 * @param len The number of bytes of the name.
+	 * @return The index of the name, -1 if not found.
+	 */
+	int32_t Find(const char *name, size_t len) const;
+
+	/*! Finds a name. */
+	int32_t Find(const std::string &name) const { return Find(name.data(), name.size()); }
+
+	/*! Finds a name that was added as a wide character string. */
+	int32_t Find(const std::wstring &name) const { return Find((const char *)name.data(), name.size()*sizeof(wchar_t)); }
+
+	/*! Sorts the names, such that FindPrefix() need not compare all names.
+	 * Names that are added afterwards clear the sort order.
+	 */
+	void Sort();
+
+	/*! Finds all names that start with a prefix.
+	 * @param prefix The prefix.
+	 * @param len The number of bytes of the prefix.
+	 * @param indices Receives the indices of the names, in increasing order.
+	 */
+	void FindPrefix(const char *prefix, size_t len, std::vector<int32_t> &indices) const;
+
+	/*! Finds all names that start with a prefix. */
+	void FindPrefix(const std::string &prefix, std::vector<int32_t> &indices) const { FindPrefix(prefix.data(), prefix.size(), indices); }
+
+	/*! The number of names. */
+	int32_t GetCount() const { return count; }
+
+	/*! Gets a name.
+	 * @param index The index of the name.
+	 * @return The name.
+	 */
+	std::string GetName(int32_t index) const { return std::string(names + offsets[index], offsets[index+1] - offsets[index]); }
+
+	/*! Writes the index, including its sort order, to a file, under a temporary
+	 * name that is then renamed.
+	 * @param fileName The name of the index file.
+	 * @param sourceFileName The name of the file that the names are from.
+	 * @return True if successful.
+	 */
+	bool Write(const std::string &fileName, const std::string &sourceFileName) const;
+
+	/*! Maps an index file, if it was written for the current version of its source file,
+	 * by an index that resolves equal names in the same way.
+	 * Names that are added afterwards are added to a copy of the index.
+	 * @param fileName The name of the index file.
+	 * @param sourceFileName The name of the file that the names are from.
+	 * @return True if the index file exists and is up to date.
+	 */
+	bool Map(const std::string &fileName, const std::string &sourceFileName);
+
+private:
+	/*! True if equal names refer to the first of them, false for the last. */
+	bool firstOfEqualNames;
+
+	/*! The number of names. */
+	int32_t count;
+
+	/*! The number of slots of the hash table, a power of two. */
+	u_int32_t numSlots;
+
+	/*! The start of each name in the name buffer; count+1 offsets. */
+	const u_int32_t *offsets;
+
+	/*! The hash table, holding the index of a name or -1 for an empty slot. */
+	const int32_t *slots;
+
+	/*! The names. */
+	const char *names;
+
+	/*! The indices of the names in byte order, or NULL if not sorted. */
+	const int32_t *order;
+
+	/*! The storage of an index that is built. */
+	std::vector<u_int32_t> offsetData;
+	std::vector<int32_t> slotData;
+	std::vector<char> nameData;
+	std::vector<int32_t> orderData;
+
+	/*! The mapped (or, on Windows, read) index file. */
+	void *map;
+	size_t mapLen;
+
+	/*! Copies a mapped index into the storage of an index that is built. */
+	void Unmap();
+
+	/*! Sets the pointers to the storage of an index that is built. */
+	void UpdatePointers();
+
+	/*! Rebuilds the hash table with a number of slots. */
+	void Rehash(u_int32_t n);
+
+	/*! Gets the indices of the names in byte order. */
+	void GetOrder(std::vector<int32_t> &o) const;
+
+	/*! Compares the index-th name with a prefix of the given length.
+	 * @return Less than, equal to or greater than zero if the start of the
+	 * name sorts before, is equal to or sorts after the prefix.
+	 */
+	int ComparePrefix(int32_t index, const char *prefix, size_t len) const;
+
+	StringIndex(const StringIndex &);
+	StringIndex &operator=(const StringIndex &);
+};
+
+}
+
+#endif // _StringIndex_HEADER_
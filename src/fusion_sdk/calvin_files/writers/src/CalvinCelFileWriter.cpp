@@ -19,6 +19,9 @@
 #include "calvin_files/writers/src/CalvinCelFileWriter.h"
 //
 #include "calvin_files/data/src/CELData.h"
+#include "file/FileIO.h"
+//
+#include <cstring>
 //
 
 using namespace affymetrix_calvin_io;
@@ -97,6 +100,53 @@ void CelFileWriter::WritePixels(const Int16Vector &v)
 	pixelPos = writer->GetFilePos();
 }
 
+void CelFileWriter::WriteIntensities(const float *v, int32_t count)
+{
+	writer->SeekFromBeginPos(intensityPos);
+	WriteArray(v, count, sizeof(float));
+	intensityPos = writer->GetFilePos();
+}
+
+void CelFileWriter::WriteStdDevs(const float *v, int32_t count)
+{
+	writer->SeekFromBeginPos(stdDevPos);
+	WriteArray(v, count, sizeof(float));
+	stdDevPos = writer->GetFilePos();
+}
+
+void CelFileWriter::WritePixels(const int16_t *v, int32_t count)
+{
+	writer->SeekFromBeginPos(pixelPos);
+	WriteArray(v, count, sizeof(int16_t));
+	pixelPos = writer->GetFilePos();
+}
+
+/*
+ * The number of values that are byte swapped and written at once.
+ */
+#define CEL_WRITER_BLOCK_SIZE 65536
+
+void CelFileWriter::WriteArray(const void *v, int32_t count, int32_t size)
+{
+	const char *p = (const char *)v;
+	buffer.resize((size_t)CEL_WRITER_BLOCK_SIZE*size);
+	while (count > 0)
+	{
+		int32_t n = (count < CEL_WRITER_BLOCK_SIZE ? count : CEL_WRITER_BLOCK_SIZE);
+#if BYTE_ORDER == BIG_ENDIAN
+		memcpy(&buffer[0], p, (size_t)n*size);
+#else
+		if (size == sizeof(u_int32_t))
+			affy_swap32_array(&buffer[0], p, n);
+		else
+			affy_swap16_array(&buffer[0], p, n);
+#endif
+		dataSetWriter->WriteBuffer(&buffer[0], n*size);
+		p += (size_t)n*size;
+		count -= n;
+	}
+}
+
 void CelFileWriter::WriteOutlierCoords(const XYCoordVector &v)
 {
 	writer->SeekFromBeginPos(outlierPos);
@@ -23,6 +23,7 @@
 #include "calvin_files/writers/src/GenericFileWriter.h"
 //
 #include <fstream>
+#include <vector>
 //
 
 #ifdef _MSC_VER
@@ -61,6 +62,24 @@ public:
 
 	void WritePixels(const Int16Vector &v);
 
+	/*! Writes the next intensities, following those written before.
+	 * @param v The intensities.
+	 * @param count The number of intensities.
+	 */
+	void WriteIntensities(const float *v, int32_t count);
+
+	/*! Writes the next standard deviations, following those written before.
+	 * @param v The standard deviations.
+	 * @param count The number of standard deviations.
+	 */
+	void WriteStdDevs(const float *v, int32_t count);
+
+	/*! Writes the next pixel counts, following those written before.
+	 * @param v The pixel counts.
+	 * @param count The number of pixel counts.
+	 */
+	void WritePixels(const int16_t *v, int32_t count);
+
 	void WriteOutlierCoords(const XYCoordVector &coords);
 
 	void WriteMaskCoords(const XYCoordVector &coords);
@@ -71,6 +90,17 @@ private:
 
 	void SetFilePositions();
 
+	/*! Writes an array of 32 or 16 bit values in big endian byte order, in
+	 * blocks that are byte swapped all at once.
+	 * @param v The values.
+	 * @param count The number of values.
+	 * @param size The size of each value, 4 or 2 bytes.
+	 */
+	void WriteArray(const void *v, int32_t count, int32_t size);
+
+	/*! The buffer of a block of byte swapped values. */
+	std::vector<char> buffer;
+
 };
 
 }
@@ -58,6 +58,85 @@ using namespace affxcdf;
 
 //////////////////////////////////////////////////////////////////////
 
+/*! Decodes the little endian values of an XDA CDF file from memory.
+ *  Reads past the end of the data give zeros, like a failed stream read,
+ *  so that a truncated file is never read outside of its memory map.
+ */
+class CDFMappedReader
+{
+private:
+    /*! The current position. */
+    const char *m_Ptr;
+
+    /*! The end of the data. */
+    const char *m_End;
+
+    /*! Advances over n bytes.
+     * @return The start of the n bytes or NULL if fewer bytes remain.
+     */
+    const char *Next(size_t n)
+    {
+        if ((size_t)(m_End - m_Ptr) < n)
+        {
+            m_Ptr = m_End;
+            return NULL;
+        }
+        const char *p = m_Ptr;
+        m_Ptr += n;
+        return p;
+    }
+
+public:
+    /*! Constructor
+     * @param data The start of the data.
+     * @param len The size of the data.
+     * @param pos The offset to start reading at.
+     */
+    CDFMappedReader(const char *data, size_t len, size_t pos) :
+        m_Ptr(data + (pos < len ? pos : len)),
+        m_End(data + len)
+    {
+    }
+
+    uint8_t ReadUInt8()
+    {
+        const char *p = Next(sizeof(uint8_t));
+        return (p == NULL ? 0 : MmGetUInt8((uint8_t *)p));
+    }
+
+    uint16_t ReadUInt16()
+    {
+        const char *p = Next(sizeof(uint16_t));
+        return (p == NULL ? 0 : MmGetUInt16_I((uint16_t *)p));
+    }
+
+    int32_t ReadInt32()
+    {
+        const char *p = Next(sizeof(int32_t));
+        return (p == NULL ? 0 : MmGetInt32_I((int32_t *)p));
+    }
+
+    uint32_t ReadUInt32()
+    {
+        const char *p = Next(sizeof(uint32_t));
+        return (p == NULL ? 0 : MmGetUInt32_I((uint32_t *)p));
+    }
+
+    /*! Reads a fixed length string, which ends at the first NULL character. */
+    void ReadFixedString(std::string &str, size_t len)
+    {
+        // A string cut short by the end of the data is kept, as with a stream.
+        size_t n = (size_t)(m_End - m_Ptr);
+        if (n > len)
+            n = len;
+        const char *p = Next(n);
+        const char *end = (const char *)memchr(p, 0, n);
+        str.assign(p, (end == NULL ? n : (size_t)(end - p)));
+    }
+};
+
+//////////////////////////////////////////////////////////////////////
+
 CCDFFileHeader::CCDFFileHeader() :
     m_Magic(0),
     m_Version(0),
@@ -70,8 +149,15 @@ CCDFFileHeader::CCDFFileHeader() :
 
 //////////////////////////////////////////////////////////////////////
 
-CCDFFileData::CCDFFileData()
+CCDFFileData::CCDFFileData() :
+    m_lpFileMap(NULL),
+    m_lpData(NULL),
+    m_MapLen(0)
 {
+#ifdef _MSC_VER
+    m_hFileMap = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -280,6 +366,13 @@ void CCDFProbeSetNames::SetName(int index, std::string name)
 
 std::string CCDFFileData::GetProbeSetName(int index)
 {
+  if (m_lpData != NULL) {
+    std::string name;
+    size_t loc = (size_t)(std::streamoff)probeSetNamePos + ((size_t)index*MAX_PROBE_SET_NAME_LENGTH);
+    CDFMappedReader reader(m_lpData, m_MapLen, loc);
+    reader.ReadFixedString(name, MAX_PROBE_SET_NAME_LENGTH);
+    return name;
+  }
   if (iteratorReader.is_open() == false) {
     return m_ProbeSetNames.GetName(index);
   }
@@ -297,6 +390,7 @@ void CCDFFileData::Close()
 {
     if (iteratorReader.is_open() == true)
         iteratorReader.close();
+    UnmapXDAFile();
     m_ProbeSets.clear();
     m_QCProbeSets.clear();
     m_ProbeSetNames.Clear();
@@ -465,6 +559,10 @@ bool CCDFFileData::ReadHeader()
 
 GeneChipProbeSetType CCDFFileData::GetProbeSetType(int index)
 {
+    if (m_lpData != NULL) {
+        CDFMappedReader reader(m_lpData, m_MapLen, m_ProbeSetPositions[index]);
+        return (GeneChipProbeSetType)(reader.ReadUInt16());
+    }
     if (iteratorReader.is_open() == false) {
         return m_ProbeSets[index].GetProbeSetType();
   }
@@ -489,6 +587,10 @@ GeneChipProbeSetType CCDFFileData::GetProbeSetType(int index)
 
 void CCDFFileData::GetProbeSetInformation(int index, CCDFProbeSetInformation & info)
 {
+    if (m_lpData != NULL) {
+        GetMappedProbeSetInformation(index, info);
+        return;
+    }
     if (iteratorReader.is_open() == false) {
         info.MakeShallowCopy(m_ProbeSets[index]);
     return;
@@ -630,7 +732,9 @@ void CCDFFileData::GetQCProbeSetInformation(GeneChipQCProbeSetType qcType, CCDFQ
 
 void CCDFFileData::GetQCProbeSetInformation(int index, CCDFQCProbeSetInformation & info)
 {
-    if (iteratorReader.is_open() == false)
+    if (m_lpData != NULL)
+        GetMappedQCProbeSetInformation(index, info);
+    else if (iteratorReader.is_open() == false)
         info.MakeShallowCopy(m_QCProbeSets[index]);
     else
     {
@@ -676,6 +780,101 @@ void CCDFFileData::GetQCProbeSetInformation(int index, CCDFQCProbeSetInformation
 
 //////////////////////////////////////////////////////////////////////
 
+void CCDFFileData::GetMappedProbeSetInformation(int index, CCDFProbeSetInformation & info)
+{
+    CDFMappedReader reader(m_lpData, m_MapLen, m_ProbeSetPositions[index]);
+
+    info.m_Index = index;
+    info.m_ProbeSetType = reader.ReadUInt16();
+    info.m_Direction = reader.ReadUInt8();
+    info.m_NumLists = reader.ReadInt32();
+    info.m_NumGroups = reader.ReadInt32();
+    info.m_NumCells = reader.ReadInt32();
+    info.m_ProbeSetNumber = reader.ReadInt32();
+    info.m_NumCellsPerList = reader.ReadUInt8();
+
+    // Read the Groups
+    CCDFProbeGroupInformation *pBlk;
+    info.m_Groups.resize(info.m_NumGroups);
+    info.m_pGroups = &info.m_Groups;
+    for (int j=0; j<info.m_NumGroups; j++)
+    {
+        pBlk = &info.m_Groups[j];
+        pBlk->m_GroupIndex = j;
+
+        // Group info
+        pBlk->m_NumLists = reader.ReadInt32();
+        pBlk->m_NumCells = reader.ReadInt32();
+        pBlk->m_NumCellsPerList = reader.ReadUInt8();
+        pBlk->m_Direction = reader.ReadUInt8();
+        pBlk->m_Start = reader.ReadInt32();
+        pBlk->m_Stop = reader.ReadInt32();
+        reader.ReadFixedString(pBlk->m_Name, MAX_PROBE_SET_NAME_LENGTH);
+        if (m_Header.m_Version >= 2)
+        {
+            pBlk->m_WobbleSituation = reader.ReadUInt16();
+            pBlk->m_AlleleCode = reader.ReadUInt16();
+        }
+        if (m_Header.m_Version >= 3)
+        {
+            pBlk->m_Channel = reader.ReadUInt8();
+            pBlk->m_RepType = reader.ReadUInt8();
+        }
+
+        // Read the cells
+        CCDFProbeInformation *pCell;
+        pBlk->m_Cells.resize(pBlk->m_NumCells);
+        pBlk->m_pCells = &pBlk->m_Cells;
+        for (int k=0; k<pBlk->m_NumCells; k++)
+        {
+            pCell = &pBlk->m_Cells[k];
+
+            // Cell info.
+            pCell->m_ListIndex = reader.ReadInt32();
+            pCell->m_X = reader.ReadUInt16();
+            pCell->m_Y = reader.ReadUInt16();
+            pCell->m_Expos = reader.ReadInt32();
+            pCell->m_PBase = reader.ReadUInt8();
+            pCell->m_TBase = reader.ReadUInt8();
+
+            if (k==0)
+                pBlk->m_Start = pCell->m_ListIndex;
+            else if (k == pBlk->m_NumCells-1)
+                pBlk->m_Stop = pCell->m_ListIndex;
+
+            if (m_Header.m_Version >= 2)
+            {
+                pCell->m_ProbeLength = reader.ReadUInt16();
+                pCell->m_ProbeGrouping = reader.ReadUInt16();
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void CCDFFileData::GetMappedQCProbeSetInformation(int index, CCDFQCProbeSetInformation & info)
+{
+    CDFMappedReader reader(m_lpData, m_MapLen, m_QCProbeSetPositions[index]);
+
+    info.m_QCProbeSetType = reader.ReadUInt16();
+    info.m_NumCells = reader.ReadInt32();
+    info.m_Cells.resize(info.m_NumCells);
+    info.m_pCells = &info.m_Cells;
+
+    // Read the cells
+    for (int j=0; j<info.m_NumCells; j++)
+    {
+        info.m_Cells[j].m_X = reader.ReadUInt16();
+        info.m_Cells[j].m_Y = reader.ReadUInt16();
+        info.m_Cells[j].m_PLen = reader.ReadUInt8();
+        info.m_Cells[j].m_PMProbe = reader.ReadUInt8();
+        info.m_Cells[j].m_Background = reader.ReadUInt8();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
 bool CCDFFileData::Read()
 {
     // Read the file
@@ -805,11 +1004,119 @@ bool CCDFFileData::ReadXDAFormat()
     // invalidate
     m_probeSetIndex_last_valid=0;
 
+    // When reading the whole file, decode the probe sets from a memory map
+    // of it instead. The stream remains in use if the file cannot be mapped.
+    if (readHeaderOnly == false && MapXDAFile() == true)
+        iteratorReader.close();
+
     return true;
 }
 
 //////////////////////////////////////////////////////////////////////
 
+bool CCDFFileData::MapXDAFile()
+{
+    // Get the file size
+    struct stat st;
+    if (stat(m_FileName.c_str(), &st) != 0 || st.st_size <= 0)
+        return false;
+    m_MapLen = (size_t)st.st_size;
+    if ((uint64_t)m_MapLen != (uint64_t)st.st_size)
+    {
+        m_MapLen = 0;
+        return false;
+    }
+
+    // Both index arrays must be within the file.
+    size_t qcIndexStart = (size_t)(std::streamoff)qcSetIndexPos;
+    size_t indexStart = (size_t)(std::streamoff)probeSetIndexPos;
+    if (m_Header.m_NumProbeSets < 0 || m_Header.m_NumQCProbeSets < 0 ||
+        indexStart > m_MapLen ||
+        (m_MapLen - indexStart) / sizeof(uint32_t) < (size_t)m_Header.m_NumProbeSets)
+    {
+        m_MapLen = 0;
+        return false;
+    }
+
+#ifdef _MSC_VER
+
+    // Map the file.
+    m_hFile = CreateFile(m_FileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        m_MapLen = 0;
+        return false;
+    }
+    m_hFileMap = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_hFileMap != NULL)
+        m_lpFileMap = MapViewOfFile(m_hFileMap, FILE_MAP_READ, 0, 0, 0);
+    if (m_lpFileMap == NULL)
+    {
+        UnmapXDAFile();
+        return false;
+    }
+
+#else
+
+    // Map the file. The map remains valid after the file is closed.
+    FILE *fp = fopen(m_FileName.c_str(), "rb");
+    if (fp == NULL)
+    {
+        m_MapLen = 0;
+        return false;
+    }
+    m_lpFileMap = mmap(NULL, m_MapLen, PROT_READ, MAP_SHARED, fileno(fp), 0);
+    fclose(fp);
+    if (m_lpFileMap == MAP_FAILED)
+    {
+        m_lpFileMap = NULL;
+        m_MapLen = 0;
+        return false;
+    }
+
+#endif
+
+    m_lpData = (char *)m_lpFileMap;
+
+    // Read the positions of the QC probe sets and probe sets once.
+    CDFMappedReader reader(m_lpData, m_MapLen, qcIndexStart);
+    m_QCProbeSetPositions.resize(m_Header.m_NumQCProbeSets);
+    for (int i=0; i<m_Header.m_NumQCProbeSets; i++)
+        m_QCProbeSetPositions[i] = reader.ReadUInt32();
+    m_ProbeSetPositions.resize(m_Header.m_NumProbeSets);
+    for (int i=0; i<m_Header.m_NumProbeSets; i++)
+        m_ProbeSetPositions[i] = reader.ReadUInt32();
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void CCDFFileData::UnmapXDAFile()
+{
+#ifdef _MSC_VER
+    if (m_lpFileMap != NULL)
+        UnmapViewOfFile(m_lpFileMap);
+    if (m_hFileMap != NULL)
+        CloseHandle(m_hFileMap);
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+    m_hFileMap = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if (m_lpFileMap != NULL)
+        munmap(m_lpFileMap, m_MapLen);
+#endif
+    m_lpFileMap = NULL;
+    m_lpData = NULL;
+    m_MapLen = 0;
+    m_ProbeSetPositions.clear();
+    m_QCProbeSetPositions.clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+
 bool CCDFFileData::ReadTextFormat()
 {
     // Open the file.
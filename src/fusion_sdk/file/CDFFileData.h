@@ -855,6 +855,51 @@ protected:
     /*! The file stream for the probe set information iterator. */
     std::ifstream iteratorReader;
 
+    /*! Pointer to the memory mapped XDA file. */
+    void *m_lpFileMap;
+
+    /*! Pointer to the data in the memory mapped file.
+     *  NULL unless the probe sets are decoded from the memory map.
+     */
+    char *m_lpData;
+
+    /*! The size of the memory mapped file. */
+    size_t m_MapLen;
+#ifdef _MSC_VER
+
+    /*! Windows handle to the file map. */
+    HANDLE m_hFileMap;
+
+    /*! Windows handle to the file. */
+    HANDLE m_hFile;
+#endif
+
+    /*! The file positions of the probe sets, read once from the index in the mapped file. */
+    std::vector<uint32_t> m_ProbeSetPositions;
+
+    /*! The file positions of the QC probe sets, read once from the index in the mapped file. */
+    std::vector<uint32_t> m_QCProbeSetPositions;
+
+    /*! Memory maps the XDA file and reads the probe set index arrays.
+     * @return True if successful.
+     */
+    bool MapXDAFile();
+
+    /*! Unmaps the XDA file. */
+    void UnmapXDAFile();
+
+    /*! Decodes a probe set from the memory mapped XDA file.
+     * @param index The zero-based index to the probe set of interest.
+     * @param info The probe set information.
+     */
+    void GetMappedProbeSetInformation(int index, CCDFProbeSetInformation & info);
+
+    /*! Decodes a QC probe set from the memory mapped XDA file.
+     * @param index The zero-based index to the QC probe set of interest.
+     * @param info The QC probe set information.
+     */
+    void GetMappedQCProbeSetInformation(int index, CCDFQCProbeSetInformation & info);
+
     /*! Flag to indicate that only the header part of the file is to be read. */
     bool readHeaderOnly;
 
@@ -26,6 +26,7 @@
 #include <cassert>
 #include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -891,7 +892,11 @@ bool CCELFileData::ReadXDABCel(bool bReadHeaderOnly)
 
 	// Read the remaining data.
 	if (bReadHeaderOnly)
+	{
+		m_nDataOffset = iHeaderBytes;
+		m_bPendingMaskedAndOutliers = true;
 		return true;
+	}
 
 #ifdef CELFILE_USE_MEMMAP
 
@@ -1056,7 +1061,7 @@ bool CCELFileData::ReadXDABCel(bool bReadHeaderOnly)
 			//x = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE), m_FileFormat);
 			y = ((int16_t)MmGetUInt16_I((uint16_t*)(m_lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE)));
 //			y = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE), m_FileFormat);
-			m_MaskedCells.insert(std::make_pair(y * m_HeaderData.GetCols() + x, true));
+			m_MaskedCells.Insert(y * m_HeaderData.GetCols() + x);
 		}
 	}
 		
@@ -1071,7 +1076,7 @@ bool CCELFileData::ReadXDABCel(bool bReadHeaderOnly)
 			y = ((int16_t)MmGetUInt16_I((uint16_t*)(m_lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE)));
 //			x = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE), m_FileFormat);
 //			y = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE), m_FileFormat);
-			m_Outliers.insert(std::make_pair(y * m_HeaderData.GetCols() + x, true));
+			m_Outliers.Insert(y * m_HeaderData.GetCols() + x);
 		}
 	}
 	else
@@ -1257,7 +1262,11 @@ bool CCELFileData::ReadTranscriptomeBCel(bool bReadHeaderOnly)
 
 	// Read the remaining data.
 	if (bReadHeaderOnly)
+	{
+		m_nDataOffset = iHeaderBytes;
+		m_bPendingMaskedAndOutliers = true;
 		return true;
+	}
 
 #ifdef CELFILE_USE_STDSTREAM
 	instr.close();
@@ -1377,7 +1386,7 @@ bool CCELFileData::ReadTranscriptomeBCel(bool bReadHeaderOnly)
 			// Read the coordinate.
 			x = MmGetUInt32_N((uint32_t*) (m_lpData + iOffset + iCell * 2 * UINT32_SIZE));
 			y = MmGetUInt32_N((uint32_t*) (m_lpData + iOffset + iCell * 2 * UINT32_SIZE + UINT32_SIZE));
-			m_MaskedCells.insert(std::make_pair(y * m_HeaderData.GetCols() + x, true));
+			m_MaskedCells.Insert(y * m_HeaderData.GetCols() + x);
 		}
 	}
 	iOffset += (m_HeaderData.GetMasked() * STRUCT_SIZE_XY_PAIR + UINT32_SIZE);
@@ -1395,7 +1404,7 @@ bool CCELFileData::ReadTranscriptomeBCel(bool bReadHeaderOnly)
 			// Read the coordinate.
 			x = MmGetUInt32_N((uint32_t*) (m_lpData + iOffset + iCell * 2 * UINT32_SIZE));
 			y = MmGetUInt32_N((uint32_t*) (m_lpData + iOffset + iCell * 2 * UINT32_SIZE + UINT32_SIZE));
-			m_Outliers.insert(std::make_pair(y * m_HeaderData.GetCols() + x, true));
+			m_Outliers.Insert(y * m_HeaderData.GetCols() + x);
 		}
 	}
 	else
@@ -1538,7 +1547,11 @@ bool CCELFileData::ReadCompactBCel(bool bReadHeaderOnly)
 
 	// Read the remaining data.
 	if (bReadHeaderOnly)
+	{
+		m_nDataOffset = iHeaderBytes;
+		m_bPendingMaskedAndOutliers = true;
 		return true;
+	}
 
 	// Memory map file
 #ifdef CELFILE_USE_MEMMAP
@@ -1643,7 +1656,7 @@ bool CCELFileData::ReadCompactBCel(bool bReadHeaderOnly)
 			//x = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE), m_FileFormat);
 			y = ((int16_t)MmGetUInt16_I((uint16_t*)(m_lpData + iOffset + iCell * 2 * USHORT_SIZE + USHORT_SIZE)));
 //			y = GetShort((short*) (m_lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE), m_FileFormat);
-			m_MaskedCells.insert(std::make_pair(y * m_HeaderData.GetCols() + x, true));
+			m_MaskedCells.Insert(y * m_HeaderData.GetCols() + x);
 		}
 	}
 	else
@@ -1715,6 +1728,185 @@ void CCELFileData::EnsureNotMmapped()
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///  CELTextLineReader
+///  \brief Reads the lines of a text CEL file from large blocks of a stream.
+///
+///  Returns the same lines as std::istream::getline() into a buffer of
+///  maxLineLength characters would, including failing on longer lines,
+///  but without a stream operation per line.
+///////////////////////////////////////////////////////////////////////////////
+class CELTextLineReader
+{
+public:
+	CELTextLineReader(std::istream &instr, int maxLineLength) :
+		m_Instr(instr), m_Buffer(BLOCK_SIZE + 1), m_Begin(0), m_End(0),
+		m_MaxLineLength(maxLineLength), m_Eof(false), m_Failed(false) {}
+
+	/// Returns the next line without its newline, or NULL at the end of the file.
+	/// The line is valid until the next call.
+	char *GetLine()
+	{
+		while (!m_Failed)
+		{
+			char *begin = &m_Buffer[0] + m_Begin;
+			char *newline = (char *) memchr(begin, '\n', m_End - m_Begin);
+			if (newline != NULL || m_Eof)
+			{
+				size_t len = (newline != NULL) ? (size_t) (newline - begin) : m_End - m_Begin;
+				if ((newline == NULL && len == 0) || len >= (size_t) m_MaxLineLength)
+				{
+					m_Failed = true;
+					break;
+				}
+				begin[len] = '\0';
+				m_Begin += len + (newline != NULL ? 1 : 0);
+				return begin;
+			}
+
+			// Keep the partial line and read the next block after it.
+			size_t partial = m_End - m_Begin;
+			memmove(&m_Buffer[0], begin, partial);
+			if (partial + BLOCK_SIZE + 1 > m_Buffer.size())
+				m_Buffer.resize(partial + BLOCK_SIZE + 1);
+			m_Instr.read(&m_Buffer[partial], BLOCK_SIZE);
+			size_t n = (size_t) m_Instr.gcount();
+			m_Begin = 0;
+			m_End = partial + n;
+			m_Eof = (n < BLOCK_SIZE);
+		}
+		return NULL;
+	}
+
+private:
+	static const size_t BLOCK_SIZE = 1 << 20;
+	std::istream &m_Instr;
+	std::vector<char> m_Buffer;
+	size_t m_Begin;
+	size_t m_End;
+	int m_MaxLineLength;
+	bool m_Eof;
+	bool m_Failed;
+};
+
+/// White space as matched by sscanf() in the "C" locale.
+static inline bool IsTextSpace(char c)
+{
+	return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
+/// Decimal digit.
+static inline bool IsTextDigit(char c)
+{
+	return (c >= '0' && c <= '9');
+}
+
+/// Powers of ten that are exact in single precision.
+static const double CELTextPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+
+///////////////////////////////////////////////////////////////////////////////
+///  ParseTextInt
+///  \brief Parse an integer field of a text CEL line the way sscanf("%d") does.
+///
+///  @param  p const char*&  Position in the line; advanced past the field
+///  @param  val int&  The value
+///  @return bool	false if the field is not a plain integer of at most 9 digits
+///////////////////////////////////////////////////////////////////////////////
+static inline bool ParseTextInt(const char *&p, int &val)
+{
+	while (IsTextSpace(*p))
+		++p;
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		++p;
+	int v = 0;
+	int digits = 0;
+	for (; digits < 9 && IsTextDigit(*p); ++digits, ++p)
+		v = v*10 + (*p - '0');
+	if (digits == 0 || IsTextDigit(*p))
+		return false;
+	val = (negative ? -v : v);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  ParseTextFloat
+///  \brief Parse a float field of a text CEL line the way sscanf("%f") does.
+///
+///  Decimals with at most 2^24 as mantissa and 10 decimal places are
+///  converted by a single division, in which both operands are exact
+///  floats.  Computed in double precision and rounded once to float, the
+///  result is the correctly rounded value, as from strtof().  Longer plain
+///  decimals are passed to strtof().
+///
+///  @param  p const char*&  Position in the line; advanced past the field
+///  @param  val float&  The value
+///  @return bool	false if the field is not a plain decimal number
+///////////////////////////////////////////////////////////////////////////////
+static inline bool ParseTextFloat(const char *&p, float &val)
+{
+	while (IsTextSpace(*p))
+		++p;
+	const char *start = p;
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		++p;
+	uint64_t m = 0;
+	int digits = 0;
+	int decimals = 0;
+	for (; IsTextDigit(*p); ++digits, ++p)
+		if (digits < 19)
+			m = m*10 + (*p - '0');
+	if (*p == '.')
+	{
+		for (++p; IsTextDigit(*p); ++digits, ++decimals, ++p)
+			if (digits < 19)
+				m = m*10 + (*p - '0');
+	}
+	// Leave exponents, infinities and the like to sscanf().
+	if (digits == 0 || *p == 'e' || *p == 'E')
+		return false;
+
+	if (digits > 19 || m > (1 << 24) || decimals > 10)
+	{
+		char *end;
+		val = strtof(start, &end);
+		return (end == p);
+	}
+	double d = (double) m / CELTextPow10[decimals];
+	val = (float) (negative ? -d : d);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  ParseTextCelEntry
+///  \brief Parse an "X Y MEAN STDV NPIXELS" line of a text CEL file.
+///
+///  Gives the same values as sscanf(line, "%d %d %f %f %d", ...).  Lines in
+///  any other form are rejected, leaving it to the caller to use sscanf().
+///
+///  @return bool	true if all fields were parsed
+///////////////////////////////////////////////////////////////////////////////
+static bool ParseTextCelEntry(const char *p, int &x, int &y, float &mean, float &stdv, int &pixels)
+{
+	return (ParseTextInt(p, x) && IsTextSpace(*p) &&
+	        ParseTextInt(p, y) && IsTextSpace(*p) &&
+	        ParseTextFloat(p, mean) && IsTextSpace(*p) &&
+	        ParseTextFloat(p, stdv) && IsTextSpace(*p) &&
+	        ParseTextInt(p, pixels));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  ParseTextCelCoordinates
+///  \brief Parse an "X Y" line of a text CEL file, as sscanf(line, "%d %d", ...).
+///
+///  @return bool	true if both fields were parsed
+///////////////////////////////////////////////////////////////////////////////
+static bool ParseTextCelCoordinates(const char *p, int &x, int &y)
+{
+	return (ParseTextInt(p, x) && IsTextSpace(*p) && ParseTextInt(p, y));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///  private  ReadTextCel
 ///  \brief Read text CEL file in memory
@@ -1888,6 +2080,11 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 	int t_x,t_y,t_pixels;
 	float t_mean,t_stdv;
 
+	// The body is read in large blocks and parsed without sscanf, except
+	// for lines which the fast parser does not accept.
+	CELTextLineReader reader(instr, MAXLINELENGTH);
+	char *line;
+
 	// Read v2 CEL files
 	if (m_HeaderData.GetVersion() == 2)
 	{
@@ -1895,13 +2092,19 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 		const char *strCellEntryFormat="%d %d %f %f %d";
 		for (int iCell=0; iCell < m_HeaderData.GetCells(); iCell++)
 		{
-			instr.getline(pszHeader, MAXLINELENGTH);
-			sscanf(pszHeader, strCellEntryFormat,          
-				&t_x,
-				&t_y,
-				&t_mean,
-				&t_stdv,
-				&t_pixels);
+			if ((line = reader.GetLine()) == NULL)
+			{
+				// As with getline(), there is an empty line past the end of the file
+				pszHeader[0] = '\0';
+				line = pszHeader;
+			}
+			if (!ParseTextCelEntry(line, t_x, t_y, t_mean, t_stdv, t_pixels))
+				sscanf(line, strCellEntryFormat,          
+					&t_x,
+					&t_y,
+					&t_mean,
+					&t_stdv,
+					&t_pixels);
 			SetIntensity(t_x,t_y,t_mean);
 			SetStdv(t_x,t_y,t_stdv);
 			SetPixels(t_x,t_y,t_pixels);
@@ -1914,13 +2117,13 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 		bool readMore=true;
 		while(readMore)
 		{
-			if (!instr.getline(pszHeader, MAXLINELENGTH))
+			if ((line = reader.GetLine()) == NULL)
 				return false;
-			if (strncmp(pszHeader,"[INTENSITY]",11)==0)
+			if (strncmp(line,"[INTENSITY]",11)==0)
 				readMore=false;
 		}
-  		instr.getline(pszHeader, MAXLINELENGTH);//Data starts at 2 lines past [Mean]
-  		instr.getline(pszHeader, MAXLINELENGTH);//Data starts at 2 lines past [Mean]
+  		reader.GetLine();//Data starts at 2 lines past [Mean]
+  		reader.GetLine();//Data starts at 2 lines past [Mean]
 
 		//Read the Mean data
 		int iCell=0;
@@ -1929,18 +2132,19 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 
 		while (readMore)
 		{
-			if (!instr.getline(pszHeader, MAXLINELENGTH)) //end of file
+			if ((line = reader.GetLine()) == NULL) //end of file
 				readMore=false;
-			else if (strlen(pszHeader) < MIN_CELLSTR )// blank line at end of data
+			else if (strlen(line) < MIN_CELLSTR )// blank line at end of data
 				readMore=false;
 			else
 			{
-				sscanf(pszHeader, strCellEntryFormat,          
-					&t_x,
-					&t_y,
-					&t_mean,
-					&t_stdv,
-					&t_pixels);
+				if (!ParseTextCelEntry(line, t_x, t_y, t_mean, t_stdv, t_pixels))
+					sscanf(line, strCellEntryFormat,          
+						&t_x,
+						&t_y,
+						&t_mean,
+						&t_stdv,
+						&t_pixels);
 				SetIntensity(t_x,t_y,t_mean);
 				SetStdv(t_x,t_y,t_stdv);
 				SetPixels(t_x,t_y,t_pixels);
@@ -1952,18 +2156,18 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 		readMore=true;
 		while(readMore)
 		{
-			if (!instr.getline(pszHeader, MAXLINELENGTH)) //end of file
+			if ((line = reader.GetLine()) == NULL) //end of file
 				return false;
-			if (strncmp(pszHeader,"[MASKS]",7)==0)
+			if (strncmp(line,"[MASKS]",7)==0)
 				readMore=false;
 		}
 		//Read number of masked cells
-		instr.getline(pszHeader, MAXLINELENGTH);
 		int nMasked=0;
-		sscanf(pszHeader, "NumberCells=%d", &nMasked);
+		if ((line = reader.GetLine()) != NULL)
+			sscanf(line, "NumberCells=%d", &nMasked);
 
 		m_HeaderData.SetMasked(nMasked);
-		instr.getline(pszHeader, MAXLINELENGTH);//skip over the header
+		reader.GetLine();//skip over the header
 
 		//Read the masked data
 		if (m_bReadMaskedCells)
@@ -1971,16 +2175,17 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 			readMore=true;
 			while (readMore)
 			{
-				if (!instr.getline(pszHeader, MAXLINELENGTH)) //end of file
+				if ((line = reader.GetLine()) == NULL) //end of file
 					readMore=false;
-				else if (strlen(pszHeader) < MIN_CELLSTR )// blank line at end of data
+				else if (strlen(line) < MIN_CELLSTR )// blank line at end of data
 					readMore=false;
 				else
 				{
 					int x, y, iCellEntry;
-					sscanf(pszHeader, "%d\t%d", &x, &y);
+					if (!ParseTextCelCoordinates(line, x, y))
+						sscanf(line, "%d\t%d", &x, &y);
 					iCellEntry = y * m_HeaderData.GetCols() + x;
-					m_MaskedCells.insert(std::make_pair(iCellEntry, true));
+					m_MaskedCells.Insert(iCellEntry);
 				}
 			}
 		}
@@ -1991,17 +2196,17 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 		readMore=true;
 		while(readMore)
 		{
-			if (!instr.getline(pszHeader, MAXLINELENGTH)) //end of file
+			if ((line = reader.GetLine()) == NULL) //end of file
 				return false;
-			if (strncmp(pszHeader,"[OUTLIERS]",10)==0)
+			if (strncmp(line,"[OUTLIERS]",10)==0)
 				readMore=false;
 		}
 		//Read number of outlier cells
-		instr.getline(pszHeader, MAXLINELENGTH);
 		int nOutliers=0;
-		sscanf(pszHeader, "NumberCells=%d", &nOutliers);
+		if ((line = reader.GetLine()) != NULL)
+			sscanf(line, "NumberCells=%d", &nOutliers);
 		m_HeaderData.SetOutliers(nOutliers);
-		instr.getline(pszHeader, MAXLINELENGTH);//skip over the header
+		reader.GetLine();//skip over the header
 
 		//Read the outlier data
 		if (m_bReadOutliers)
@@ -2009,16 +2214,17 @@ bool CCELFileData::ReadTextCel(bool bReadHeaderOnly)
 			readMore=true;
 			while (readMore)
 			{
-				if (!instr.getline(pszHeader, MAXLINELENGTH)) //end of file
+				if ((line = reader.GetLine()) == NULL) //end of file
 					readMore=false;
-				else if (strlen(pszHeader) < MIN_CELLSTR )// blank line at end of data
+				else if (strlen(line) < MIN_CELLSTR )// blank line at end of data
 					readMore=false;
 				else
 				{
 					int x, y, iCellEntry;
-					sscanf(pszHeader, "%d\t%d", &x, &y);
+					if (!ParseTextCelCoordinates(line, x, y))
+						sscanf(line, "%d\t%d", &x, &y);
 					iCellEntry = y * m_HeaderData.GetCols() + x;
-					m_Outliers.insert(std::make_pair(iCellEntry, true));
+					m_Outliers.Insert(iCellEntry);
 				}
 			}
 		}
@@ -2042,8 +2248,8 @@ void CCELFileData::Clear()
   Munmap();
 
 	m_HeaderData.Clear();
-	m_MaskedCells.clear();
-	m_Outliers.clear();
+	m_MaskedCells.Clear();
+	m_Outliers.Clear();
 
   delete [] m_pEntries; 
   m_pEntries=NULL;
@@ -2051,6 +2257,9 @@ void CCELFileData::Clear()
 	m_pTransciptomeEntries = NULL;
   delete [] m_pMeanIntensities; 
 	m_pMeanIntensities = NULL;
+
+	m_nDataOffset = 0;
+	m_bPendingMaskedAndOutliers = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2433,42 +2642,306 @@ float CCELFileData::GetIntensity(int index)
 
 int CCELFileData::GetIntensities(int index,std::vector<float>& intensities)
 {
-  int idx_start=index;
-  int idx_end=idx_start+intensities.size();
+  if (intensities.empty())
+    return 0;
   // the start and end indexes must be valid...
-	assert((idx_start >= 0) && (idx_end <= m_HeaderData.GetCells()));
+	assert((index >= 0) && (index + (int) intensities.size() <= m_HeaderData.GetCells()));
 
-  // determine the format once, then copy a vectors worth of data.
-	if (m_FileFormat == TEXT_CEL) 
+	GetEntries(index, (int) intensities.size(), &intensities[0], NULL, NULL);
+  return 0;
+}
+
+/// Adapts a contiguous range of cells to the indexing used by GetEntriesT().
+struct CELCellRange
+{
+	int start;
+	CELCellRange(int s) : start(s) {}
+	int operator[](int k) const { return start + k; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///  GetEntriesT
+///  \brief Copy intensities, stdvs and pixels of a set of cells into buffers.
+///
+///  The file format is resolved once for the whole set instead of per cell.
+///  Cells are given by idx[0], ..., idx[count-1], where idx is either a
+///  CELCellRange or a plain array of cell indices.
+///////////////////////////////////////////////////////////////////////////////
+template<class IndexType>
+static void GetEntriesT(int fileFormat,
+                        CELFileEntryType *pEntries,
+                        CELFileTranscriptomeEntryType *pTranscriptomeEntries,
+                        uint16_t *pMeanIntensities,
+                        const IndexType &idx, int count,
+                        float *intensities, float *stdvs, short *pixels)
+{
+	if (fileFormat == CCELFileData::TEXT_CEL || fileFormat == CCELFileData::XDA_BCEL)
+	{
+		if (intensities != NULL)
+			for (int k = 0; k < count; k++)
+				intensities[k] = MmGetFloat_I(&pEntries[idx[k]].Intensity);
+		if (stdvs != NULL)
+			for (int k = 0; k < count; k++)
+				stdvs[k] = MmGetFloat_I(&pEntries[idx[k]].Stdv);
+		if (pixels != NULL)
+			for (int k = 0; k < count; k++)
+				pixels[k] = MmGetInt16_I(&pEntries[idx[k]].Pixels);
+	}
+	else if (fileFormat == CCELFileData::TRANSCRIPTOME_BCEL)
+	{
+		if (intensities != NULL)
+			for (int k = 0; k < count; k++)
+				intensities[k] = MmGetUInt16_N(&pTranscriptomeEntries[idx[k]].Intensity);
+		if (stdvs != NULL)
+			for (int k = 0; k < count; k++)
+				stdvs[k] = MmGetUInt16_N(&pTranscriptomeEntries[idx[k]].Stdv);
+		if (pixels != NULL)
+			for (int k = 0; k < count; k++)
+				pixels[k] = MmGetUInt8(&pTranscriptomeEntries[idx[k]].Pixels);
+	}
+	else if (fileFormat == CCELFileData::COMPACT_BCEL)
+	{
+		if (intensities != NULL)
+			for (int k = 0; k < count; k++)
+				intensities[k] = MmGetUInt16_I(&pMeanIntensities[idx[k]]);
+		// Compact CEL files have neither stdvs nor pixels.
+		if (stdvs != NULL)
+			std::fill(stdvs, stdvs + count, 0.0f);
+		if (pixels != NULL)
+			std::fill(pixels, pixels + count, (short) 0);
+	}
+	else
 	{
-    for (int idx=idx_start;idx<idx_end;idx++) {
-      intensities[idx]=MmGetFloat_I(&m_pEntries[idx].Intensity);
-    }
-  }
-	else if (m_FileFormat == XDA_BCEL) 
+		assert(0);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  GetEntries
+///  \brief Retrieve intensities, stdvs and pixels of a range of cells
+///
+///  @param  index int  Index of the first cell
+///  @param  count int  Number of cells
+///  @param  intensities float*  Intensity buffer (NULL to skip)
+///  @param  stdvs float*  Standard deviation buffer (NULL to skip)
+///  @param  pixels short*  Pixel count buffer (NULL to skip)
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileData::GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels)
+{
+	assert((index >= 0) && (count >= 0) && (index + count <= m_HeaderData.GetCells()));
+
+	GetEntriesT(m_FileFormat, m_pEntries, m_pTransciptomeEntries, m_pMeanIntensities,
+	            CELCellRange(index), count, intensities, stdvs, pixels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  GetEntries
+///  \brief Retrieve intensities, stdvs and pixels of a set of cells
+///
+///  @param  indices const int*  Cell indices
+///  @param  count int  Number of cells
+///  @param  intensities float*  Intensity buffer (NULL to skip)
+///  @param  stdvs float*  Standard deviation buffer (NULL to skip)
+///  @param  pixels short*  Pixel count buffer (NULL to skip)
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileData::GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels)
+{
+	GetEntriesT(m_FileFormat, m_pEntries, m_pTransciptomeEntries, m_pMeanIntensities,
+	            indices, count, intensities, stdvs, pixels);
+}
+
+/// Returns the number of bytes per cell entry of a binary file format, or 0 otherwise.
+static int GetEntrySize(int fileFormat)
+{
+	switch (fileFormat)
 	{
-    for (int idx=idx_start;idx<idx_end;idx++) {
-      intensities[idx]=MmGetFloat_I(&m_pEntries[idx].Intensity);
-    }
+	case CCELFileData::XDA_BCEL:
+		return FLOAT_SIZE + FLOAT_SIZE + SHORT_SIZE;
+	case CCELFileData::TRANSCRIPTOME_BCEL:
+		return STRUCT_SIZE_FEATURE_DATA;
+	case CCELFileData::COMPACT_BCEL:
+		return USHORT_SIZE;
+	default:
+		return 0;
 	}
-	else if (m_FileFormat == TRANSCRIPTOME_BCEL) 
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  GetRectangle
+///  \brief Retrieve intensities, stdvs and pixels of a rectangle of cells
+///
+///  If only the header of a binary file has been read, each row of the
+///  rectangle is read from the file as one span of cell entries (or the whole
+///  rectangle at once if it spans all columns), so the rest of the file is
+///  never read.  Text files are read completely first.
+///
+///  @param  x int  X coordinate of the upper left cell
+///  @param  y int  Y coordinate of the upper left cell
+///  @param  width int  Number of columns
+///  @param  height int  Number of rows
+///  @param  intensities float*  Intensity buffer, row by row (NULL to skip)
+///  @param  stdvs float*  Standard deviation buffer, row by row (NULL to skip)
+///  @param  pixels short*  Pixel count buffer, row by row (NULL to skip)
+///  @return bool	true if success; false if fail
+///////////////////////////////////////////////////////////////////////////////
+bool CCELFileData::GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels)
+{
+	int cols = m_HeaderData.GetCols();
+	if (x < 0 || y < 0 || width < 0 || height < 0 ||
+	    x + width > cols || y + height > m_HeaderData.GetRows())
 	{
-    for (int idx=idx_start;idx<idx_end;idx++) {
-      intensities[idx]=MmGetUInt16_N(&m_pTransciptomeEntries[idx].Intensity);
-    }
+		SetError("The rectangle is not within the array.");
+		return false;
 	}
-	else if (m_FileFormat == COMPACT_BCEL) 
+	if (width == 0 || height == 0)
+		return true;
+
+	// A whole band of rows is one contiguous span of cells.
+	int spanWidth = width;
+	int spanRows = 1;
+	if (width == cols)
 	{
-    for (int idx=idx_start;idx<idx_end;idx++) {
-      intensities[idx]=MmGetUInt16_I(&m_pMeanIntensities[idx]);
-    }
+		spanWidth = width * height;
+		spanRows = height;
 	}
-	else {
-    // Opps - we dont know what the format was.
-    assert(0);
+
+	// The cell entries are in memory.
+	if (m_pEntries != NULL || m_pTransciptomeEntries != NULL || m_pMeanIntensities != NULL)
+	{
+		for (int row = 0; row < height; row += spanRows)
+		{
+			int k = row * width;
+			GetEntries((y + row) * cols + x, spanWidth,
+			           intensities == NULL ? NULL : intensities + k,
+			           stdvs == NULL ? NULL : stdvs + k,
+			           pixels == NULL ? NULL : pixels + k);
+		}
+		return true;
 	}
 
-  return 0;
+	int entrySize = GetEntrySize(m_FileFormat);
+	if (m_nDataOffset == 0 || entrySize == 0)
+	{
+		if (m_FileFormat != TEXT_CEL || Open() == false)
+		{
+			SetError("The cell entries have not been read.");
+			return false;
+		}
+		return GetRectangle(x, y, width, height, intensities, stdvs, pixels);
+	}
+
+	// Only the header has been read: read the span of each row.
+	std::ifstream instr(m_FileName.c_str(), std::ios::in | std::ios::binary);
+	if (!instr)
+	{
+		SetError("Unable to open the file.");
+		return false;
+	}
+	std::vector<char> buffer((size_t) spanWidth * entrySize);
+	for (int row = 0; row < height; row += spanRows)
+	{
+		std::streamoff pos = (std::streamoff) m_nDataOffset +
+			((std::streamoff) (y + row) * cols + x) * entrySize;
+		instr.seekg(pos, std::ios::beg);
+		instr.read(&buffer[0], (std::streamsize) buffer.size());
+		if (!instr)
+		{
+			SetError("Unable to read the cell entries.");
+			return false;
+		}
+		int k = row * width;
+		GetEntriesT(m_FileFormat, (CELFileEntryType *) &buffer[0],
+		            (CELFileTranscriptomeEntryType *) &buffer[0], (uint16_t *) &buffer[0],
+		            CELCellRange(0), spanWidth,
+		            intensities == NULL ? NULL : intensities + k,
+		            stdvs == NULL ? NULL : stdvs + k,
+		            pixels == NULL ? NULL : pixels + k);
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  private  ReadPendingMaskedAndOutliers
+///  \brief Read the masked and outlier cells after reading only the header
+///
+///  Their coordinates follow the cell entries of binary files, so only the
+///  end of the file is read.
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileData::ReadPendingMaskedAndOutliers()
+{
+	if (m_bPendingMaskedAndOutliers == false)
+		return;
+	m_bPendingMaskedAndOutliers = false;
+
+	std::ifstream instr(m_FileName.c_str(), std::ios::in | std::ios::binary);
+	std::streamoff start = (std::streamoff) m_nDataOffset +
+		(std::streamoff) m_HeaderData.GetCells() * GetEntrySize(m_FileFormat);
+	instr.seekg(0, std::ios::end);
+	std::streamoff end = instr.tellg();
+	if (!instr || end <= start)
+		return;
+	std::vector<char> tail((size_t) (end - start));
+	instr.seekg(start, std::ios::beg);
+	instr.read(&tail[0], (std::streamsize) tail.size());
+	if (!instr)
+		return;
+
+	const char *lpData = &tail[0];
+	size_t size = tail.size();
+	int cols = m_HeaderData.GetCols();
+	int iCell;
+	if (m_FileFormat == TRANSCRIPTOME_BCEL)
+	{
+		size_t iOffset = UINT32_SIZE;
+		if (iOffset + UINT32_SIZE > size)
+			return;
+		int nMasked = MmGetUInt32_N((uint32_t*)(lpData + iOffset)) / STRUCT_SIZE_XY_PAIR;
+		iOffset += (UINT32_SIZE + BCEL_CHUNK_NAME_SIZE);
+		if (iOffset + (size_t) nMasked * STRUCT_SIZE_XY_PAIR + UINT32_SIZE > size)
+			return;
+		for (iCell = 0; iCell < nMasked && m_bReadMaskedCells; iCell++)
+		{
+			uint32_t x = MmGetUInt32_N((uint32_t*) (lpData + iOffset + iCell * 2 * UINT32_SIZE));
+			uint32_t y = MmGetUInt32_N((uint32_t*) (lpData + iOffset + iCell * 2 * UINT32_SIZE + UINT32_SIZE));
+			m_MaskedCells.Insert(y * cols + x);
+		}
+		iOffset += (nMasked * STRUCT_SIZE_XY_PAIR + UINT32_SIZE);
+		if (iOffset + UINT32_SIZE > size)
+			return;
+		int nOutliers = MmGetUInt32_N((uint32_t*)(lpData + iOffset)) / STRUCT_SIZE_XY_PAIR;
+		iOffset += (UINT32_SIZE + BCEL_CHUNK_NAME_SIZE);
+		if (iOffset + (size_t) nOutliers * STRUCT_SIZE_XY_PAIR > size)
+			return;
+		for (iCell = 0; iCell < nOutliers && m_bReadOutliers; iCell++)
+		{
+			uint32_t x = MmGetUInt32_N((uint32_t*) (lpData + iOffset + iCell * 2 * UINT32_SIZE));
+			uint32_t y = MmGetUInt32_N((uint32_t*) (lpData + iOffset + iCell * 2 * UINT32_SIZE + UINT32_SIZE));
+			m_Outliers.Insert(y * cols + x);
+		}
+		m_HeaderData.SetMasked(m_bReadMaskedCells ? nMasked : 0);
+		m_HeaderData.SetOutliers(m_bReadOutliers ? nOutliers : 0);
+	}
+	else
+	{
+		// The masked cells followed by the outliers (XDA only), as pairs of shorts.
+		int nMasked = m_HeaderData.GetMasked();
+		int nOutliers = (m_FileFormat == XDA_BCEL) ? m_HeaderData.GetOutliers() : 0;
+		if ((size_t) (nMasked + nOutliers) * 2 * SHORT_SIZE > size)
+			return;
+		for (iCell = 0; iCell < nMasked && m_bReadMaskedCells; iCell++)
+		{
+			int16_t x = ((int16_t)MmGetUInt16_I((uint16_t*)(lpData + iCell * 2 * SHORT_SIZE)));
+			int16_t y = ((int16_t)MmGetUInt16_I((uint16_t*)(lpData + iCell * 2 * SHORT_SIZE + SHORT_SIZE)));
+			m_MaskedCells.Insert(y * cols + x);
+		}
+		size_t iOffset = (size_t) nMasked * 2 * SHORT_SIZE;
+		for (iCell = 0; iCell < nOutliers && m_bReadOutliers; iCell++)
+		{
+			int16_t x = ((int16_t)MmGetUInt16_I((uint16_t*)(lpData + iOffset + iCell * 2 * SHORT_SIZE)));
+			int16_t y = ((int16_t)MmGetUInt16_I((uint16_t*)(lpData + iOffset + iCell * 2 * SHORT_SIZE + SHORT_SIZE)));
+			m_Outliers.Insert(y * cols + x);
+		}
+	}
 }
 
 
@@ -2590,11 +3063,7 @@ bool CCELFileData::IsMasked(int index)
 {
 	assert((index >= 0) && (index < m_HeaderData.GetCells()));
 
-	bool bReturn = false;
-	std::map<int, bool>::iterator pos = m_MaskedCells.find(index);
-	if (pos != m_MaskedCells.end())
-		bReturn = true;
-	return bReturn;
+	return m_MaskedCells.Contains(index);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2624,11 +3093,7 @@ bool CCELFileData::IsOutlier(int index)
 {
 	assert((index >= 0) && (index < m_HeaderData.GetCells()));
 
-	bool bReturn = false;
-	std::map<int, bool>::iterator pos = m_Outliers.find(index);
-	if (pos != m_Outliers.end())
-		bReturn = true;
-	return bReturn;
+	return m_Outliers.Contains(index);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2869,6 +3334,78 @@ unsigned short CCELFileData::RoundNumber(float f)
 	return us;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///  public  CCELCellSet::Clear
+///  \brief Remove all cells and deallocate the bitmap
+///
+///  @return void	
+///////////////////////////////////////////////////////////////////////////////
+void CCELCellSet::Clear()
+{
+	std::vector<uint32_t>().swap(m_Bits);
+	m_nCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  CCELCellSet::Insert
+///  \brief Add a cell to the set
+///
+///  @param  index int  	Cell index
+///  @return bool	true if the cell was added; false if already in the set
+///////////////////////////////////////////////////////////////////////////////
+bool CCELCellSet::Insert(int index)
+{
+	if (index < 0)
+		return false;
+	size_t word = ((size_t) index) >> 5;
+	if (word >= m_Bits.size())
+		m_Bits.resize(std::max(word + 1, 2 * m_Bits.size()), 0);
+	uint32_t bit = 1u << (index & 31);
+	if (m_Bits[word] & bit)
+		return false;
+	m_Bits[word] |= bit;
+	m_nCount++;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  CCELCellSet::Erase
+///  \brief Remove a cell from the set
+///
+///  @param  index int  	Cell index
+///  @return bool	true if the cell was removed; false if not in the set
+///////////////////////////////////////////////////////////////////////////////
+bool CCELCellSet::Erase(int index)
+{
+	if (Contains(index) == false)
+		return false;
+	m_Bits[((size_t) index) >> 5] &= ~(1u << (index & 31));
+	m_nCount--;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  CCELCellSet::GetIndices
+///  \brief Retrieve the cells in the set in increasing order
+///
+///  @param  indices std::vector<int> &  	Cell indices (output)
+///  @return void	
+///////////////////////////////////////////////////////////////////////////////
+void CCELCellSet::GetIndices(std::vector<int> &indices) const
+{
+	indices.clear();
+	indices.reserve(m_nCount);
+	for (size_t word = 0; word < m_Bits.size(); word++)
+	{
+		uint32_t bits = m_Bits[word];
+		for (int bit = 0; bits != 0; bit++, bits >>= 1)
+		{
+			if (bits & 1u)
+				indices.push_back((int) (word * 32 + bit));
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///  public constructor  CCELFileData
 ///  \brief Default constructor
@@ -2888,6 +3425,8 @@ CCELFileData::CCELFileData()
 	m_bReadMaskedCells = true;
 	m_bReadOutliers = true;
 	m_nReadState = CEL_ALL;
+	m_nDataOffset = 0;
+	m_bPendingMaskedAndOutliers = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3015,19 +3554,7 @@ void CCELFileData::SetFileFormat(int i)
 ///////////////////////////////////////////////////////////////////////////////
 void CCELFileData::SetDimensions(int rows, int cols)
 {
-	m_HeaderData.SetRows(rows);
-	m_HeaderData.SetCols(cols);
-	m_HeaderData.SetCells(rows * cols);
-	GridCoordinatesType grid;
-	grid.upperleft.x = 1;
-	grid.upperleft.y = 1;
-	grid.upperright.x = cols;
-	grid.upperright.y = 1;
-	grid.lowerleft.x = 1;
-	grid.lowerleft.y = rows;
-	grid.lowerright.x = cols;
-	grid.lowerright.y = rows;
-	m_HeaderData.SetGridCorners(grid);
+	SetHeaderDimensions(rows, cols);
 
   /// @todo UnMap
   // delete [] m_lpData;
@@ -3045,6 +3572,30 @@ void CCELFileData::SetDimensions(int rows, int cols)
 		m_pMeanIntensities = new unsigned short[rows*cols];
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///  public  SetHeaderDimensions
+///  \brief Set the dimensions and grid corners in the header
+///  @param  rows int  	Number of rows
+///  @param  cols int  	Number of columns
+///  @return void	
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileData::SetHeaderDimensions(int rows, int cols)
+{
+	m_HeaderData.SetRows(rows);
+	m_HeaderData.SetCols(cols);
+	m_HeaderData.SetCells(rows * cols);
+	GridCoordinatesType grid;
+	grid.upperleft.x = 1;
+	grid.upperleft.y = 1;
+	grid.upperright.x = cols;
+	grid.upperright.y = 1;
+	grid.lowerleft.x = 1;
+	grid.lowerleft.y = rows;
+	grid.lowerright.x = cols;
+	grid.lowerright.y = rows;
+	m_HeaderData.SetGridCorners(grid);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///  public  SetChipType
 ///  \brief Set chip type and regenerate header string
@@ -3327,17 +3878,13 @@ void CCELFileData::SetMask(int index, bool masked)
 
 	if (masked)
 	{
-		m_MaskedCells.insert(std::make_pair(index, true));
+		m_MaskedCells.Insert(index);
 		m_HeaderData.IncrementMasked();
 	}
 	else
 	{
-		std::map<int, bool>::iterator pos = m_MaskedCells.find(index);
-		if (pos != m_MaskedCells.end())
-		{
-			m_MaskedCells.erase(pos);
+		if (m_MaskedCells.Erase(index))
 			m_HeaderData.DecrementMasked();
-		}
 	}
 }
 
@@ -3372,17 +3919,13 @@ void CCELFileData::SetOutlier(int index, bool outlier)
 
 	if (outlier)
 	{
-		m_Outliers.insert(std::make_pair(index, true));
+		m_Outliers.Insert(index);
 		m_HeaderData.IncrementOutliers();
 	}
 	else
 	{
-		std::map<int, bool>::iterator pos = m_Outliers.find(index);
-		if (pos != m_Outliers.end())
-		{
-			m_Outliers.erase(pos);
+		if (m_Outliers.Erase(index))
 			m_HeaderData.DecrementOutliers();
-		}
 	}
 }
 
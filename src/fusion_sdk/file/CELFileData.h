@@ -39,6 +39,7 @@
 #include <cstring>
 #include <map>
 #include <string>
+#include <vector>
 //
 #ifdef CELFILE_USE_ZLIB
 #ifndef FILEIO_WITH_ZLIB
@@ -505,6 +506,64 @@ public:
 
 //////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+///  affxcel::CCELCellSet
+///
+///  @brief Set of cell indices stored as a dense bitmap
+///
+///  Used for the masked and outlier cells. Membership tests are a single
+///  bit lookup and the members are enumerated in increasing index order.
+///  The bitmap grows on demand, so it may be used before the number of
+///  cells is known.
+///////////////////////////////////////////////////////////////////////////////
+class CCELCellSet
+{
+public:
+	/*! Constructor */
+	CCELCellSet() : m_nCount(0) {}
+
+	/*! Removes all cells from the set and deallocates the bitmap. */
+	void Clear();
+
+	/*! Adds a cell to the set.
+	 * @param index The cell index.
+	 * @return True if the cell was not already in the set.
+	 */
+	bool Insert(int index);
+
+	/*! Removes a cell from the set.
+	 * @param index The cell index.
+	 * @return True if the cell was in the set.
+	 */
+	bool Erase(int index);
+
+	/*! Checks if a cell is in the set.
+	 * @param index The cell index.
+	 * @return True if the cell is in the set.
+	 */
+	bool Contains(int index) const
+	{
+		unsigned int word = ((unsigned int) index) >> 5;
+		return word < m_Bits.size() && (m_Bits[word] & (1u << (index & 31))) != 0;
+	}
+
+	/*! The number of cells in the set. */
+	int Count() const { return m_nCount; }
+
+	/*! Retrieves the cells in the set.
+	 * @param indices The cell indices in increasing order.
+	 */
+	void GetIndices(std::vector<int> &indices) const;
+
+private:
+	/// One bit per cell
+	std::vector<uint32_t> m_Bits;
+	/// Number of bits set
+	int m_nCount;
+};
+
+//////////////////////////////////////////////////////////////////////
+
 ///////////////////////////////////////////////////////////////////////////////
 ///  affxcel::CCELFileData
 ///
@@ -577,10 +636,10 @@ protected:
 	/// Pointer to intensity entries for each cell (used for compact cel format)
 	unsigned short *m_pMeanIntensities;
 
-	/// STL map for masked cell coordinates
-	std::map<int, bool> m_MaskedCells;
-	/// STL map for outlier coordinates
-	std::map<int, bool> m_Outliers;
+	/// Masked cell indices
+	CCELCellSet m_MaskedCells;
+	/// Outlier cell indices
+	CCELCellSet m_Outliers;
 
 	/// CEL file reading state
 	int m_nReadState;
@@ -606,6 +665,16 @@ protected:
 	/// Pointer to memory mapping file view
 	void  *m_lpFileMap;
 
+	/// File position of the cell entries after reading only the header of a binary file, otherwise 0
+	int m_nDataOffset;
+	/// Flag indicating that the masked and outlier cells have not been read yet
+	bool m_bPendingMaskedAndOutliers;
+
+	/*! Reads the masked and outlier cells, if only the header has been read.
+	 * These follow the cell entries, so the entries themselves are not read.
+	 */
+	void ReadPendingMaskedAndOutliers();
+
 	/*! Opens the file.
 	 * @param bReadHeaderOnly Flag indicating if the header is only to be read.
 	 * @return True if successful.
@@ -896,6 +965,38 @@ public:
   /// @return    non-zero on error
 	int GetIntensities(int index,std::vector<float>& intensities);
 
+	/*! Retrieves the intensities, stdv values and pixel counts for a range of cells.
+	 * @param index The index of the first cell.
+	 * @param count The number of cells.
+	 * @param intensities Buffer of count elements to fill, or NULL to skip the intensities.
+	 * @param stdvs Buffer of count elements to fill, or NULL to skip the stdv values.
+	 * @param pixels Buffer of count elements to fill, or NULL to skip the pixel counts.
+	 */
+	void GetEntries(int index, int count, float *intensities, float *stdvs, short *pixels);
+
+	/*! Retrieves the intensities, stdv values and pixel counts for a set of cells.
+	 * @param indices The indices of the cells (need not be sorted).
+	 * @param count The number of cells.
+	 * @param intensities Buffer of count elements to fill, or NULL to skip the intensities.
+	 * @param stdvs Buffer of count elements to fill, or NULL to skip the stdv values.
+	 * @param pixels Buffer of count elements to fill, or NULL to skip the pixel counts.
+	 */
+	void GetEntries(const int *indices, int count, float *intensities, float *stdvs, short *pixels);
+
+	/*! Retrieves the intensities, stdv values and pixel counts for a rectangle of cells.
+	 * If only the header of a binary file has been read, only the spans of the rows
+	 * of the rectangle are read from the file.
+	 * @param x The X coordinate of the upper left cell.
+	 * @param y The Y coordinate of the upper left cell.
+	 * @param width The number of columns of the rectangle.
+	 * @param height The number of rows of the rectangle.
+	 * @param intensities Buffer of width*height elements to fill row by row, or NULL to skip the intensities.
+	 * @param stdvs Buffer of width*height elements to fill row by row, or NULL to skip the stdv values.
+	 * @param pixels Buffer of width*height elements to fill row by row, or NULL to skip the pixel counts.
+	 * @return True if successful.
+	 */
+	bool GetRectangle(int x, int y, int width, int height, float *intensities, float *stdvs, short *pixels);
+
 	/*! Retrieves a CEL file intensity.
 	 * @param x The X coordinate.
 	 * @param y The Y coordinate.
@@ -955,6 +1056,16 @@ public:
 	 */
 	bool IsOutlier(int index);
 
+	/*! Retrieves the indices of all masked cells.
+	 * @param indices The cell indices in increasing order.
+	 */
+	void GetMaskedIndices(std::vector<int> &indices) { ReadPendingMaskedAndOutliers(); m_MaskedCells.GetIndices(indices); }
+
+	/*! Retrieves the indices of all outlier cells.
+	 * @param indices The cell indices in increasing order.
+	 */
+	void GetOutlierIndices(std::vector<int> &indices) { ReadPendingMaskedAndOutliers(); m_Outliers.GetIndices(indices); }
+
 
 	// For reading a file.
 
@@ -1070,6 +1181,18 @@ public:
 	 */
 	void SetDimensions(int rows, int cols);
 
+	/*! Sets dimensions (rows/cols) of the CEL file in the header only,
+	 * without allocating the cell entries, e.g. for writing them in chunks.
+	 * @param rows The number of rows.
+	 * @param cols The number of columns.
+	 */
+	void SetHeaderDimensions(int rows, int cols);
+
+	/*! Sets the DAT header.
+	 * @param str The DAT header.
+	 */
+	void SetDatHeader(const char *str) { m_HeaderData.SetDatHeader(str); }
+
 	/*! Sets probe array (chip) type.
 	 * @param str The probe array type.
 	 */
@@ -24,6 +24,7 @@
 //
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -126,7 +127,7 @@ using namespace affxcel;
 ///
 ///  @return void
 ///////////////////////////////////////////////////////////////////////////////
-CCELFileWriter::CCELFileWriter() : CCELFileData()
+CCELFileWriter::CCELFileWriter() : CCELFileData(), m_nXDABEntries(0)
 {
 }
 
@@ -231,9 +232,11 @@ bool CCELFileWriter::WriteTextCel()
 	newCelFile.write(szBuffer, length);
 	length = snprintf(szBuffer,sizeof(szBuffer), "CellHeader=X\tY%s", LINE_SEPARATOR);
 	newCelFile.write(szBuffer, length);
-	for(std::map<int, bool>::iterator pos = m_MaskedCells.begin(); pos != m_MaskedCells.end(); pos++)
+	std::vector<int> maskedIndices;
+	GetMaskedIndices(maskedIndices);
+	for(std::vector<int>::iterator pos = maskedIndices.begin(); pos != maskedIndices.end(); pos++)
 	{
-		length = snprintf(szBuffer,sizeof(szBuffer), "%d\t%d%s", IndexToX(pos->first), IndexToY(pos->first), LINE_SEPARATOR);
+		length = snprintf(szBuffer,sizeof(szBuffer), "%d\t%d%s", IndexToX(*pos), IndexToY(*pos), LINE_SEPARATOR);
 		newCelFile.write(szBuffer, length);
 	}
 	length = snprintf(szBuffer,sizeof(szBuffer), "%s", LINE_SEPARATOR);
@@ -246,9 +249,11 @@ bool CCELFileWriter::WriteTextCel()
 	newCelFile.write(szBuffer, length);
 	length = snprintf(szBuffer,sizeof(szBuffer), "CellHeader=X\tY%s", LINE_SEPARATOR);
 	newCelFile.write(szBuffer, length);
-	for(std::map<int, bool>::iterator pos = m_Outliers.begin(); pos != m_Outliers.end(); pos++)
+	std::vector<int> outlierIndices;
+	GetOutlierIndices(outlierIndices);
+	for(std::vector<int>::iterator pos = outlierIndices.begin(); pos != outlierIndices.end(); pos++)
 	{
-		length = snprintf(szBuffer,sizeof(szBuffer), "%d\t%d%s", IndexToX(pos->first), IndexToY(pos->first), LINE_SEPARATOR);
+		length = snprintf(szBuffer,sizeof(szBuffer), "%d\t%d%s", IndexToX(*pos), IndexToY(*pos), LINE_SEPARATOR);
 		newCelFile.write(szBuffer, length);
 	}
 
@@ -296,6 +301,36 @@ bool CCELFileWriter::WriteXDABCel()
 		return false;
 	}
 
+	WriteXDABHeader(newCelFile);
+
+	// Write the Mean data
+	for (int iCell=0; iCell < m_HeaderData.GetCells(); iCell++) 
+	{
+		int   t_x=IndexToX(iCell);
+		int   t_y=IndexToY(iCell);
+		float t_mean=GetIntensity(t_x,t_y);
+		float t_stdv=GetStdv(t_x,t_y);
+		uint16_t t_pixel=GetPixels(t_x,t_y);
+
+		WriteFloatLowPrecision(newCelFile,t_mean);
+		WriteFloatLowPrecision(newCelFile,t_stdv);
+		WriteUInt16_I(newCelFile,t_pixel);
+	}
+
+	WriteXDABMaskedAndOutliers(newCelFile);
+
+	// Close the file and check the status.
+	newCelFile.close();
+
+	return !newCelFile.fail();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  private  WriteXDABHeader
+///  \brief Write the header of a CEL file in xda binary format
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileWriter::WriteXDABHeader(std::ofstream &newCelFile)
+{
 	m_HeaderData.SetDatHeader();
 
 	// Write the header.
@@ -315,39 +350,151 @@ bool CCELFileWriter::WriteXDABCel()
 	WriteUInt32_I(newCelFile, m_HeaderData.GetOutliers());
 	WriteUInt32_I(newCelFile, m_HeaderData.GetMasked());
 	WriteUInt32_I(newCelFile, 0);
+}
 
-	// Write the Mean data
-	for (int iCell=0; iCell < m_HeaderData.GetCells(); iCell++) 
+///////////////////////////////////////////////////////////////////////////////
+///  private  WriteXDABMaskedAndOutliers
+///  \brief Write the masked and outlier cells of a CEL file in xda binary format
+///////////////////////////////////////////////////////////////////////////////
+void CCELFileWriter::WriteXDABMaskedAndOutliers(std::ofstream &newCelFile)
+{
+	// Write the mask data
+	std::vector<int> maskedIndices;
+	GetMaskedIndices(maskedIndices);
+	for(std::vector<int>::iterator pos = maskedIndices.begin(); pos != maskedIndices.end(); pos++)
 	{
-		int   t_x=IndexToX(iCell);
-		int   t_y=IndexToY(iCell);
-		float t_mean=GetIntensity(t_x,t_y);
-		float t_stdv=GetStdv(t_x,t_y);
-		uint16_t t_pixel=GetPixels(t_x,t_y);
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(*pos));
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(*pos));
+	}
 
-		WriteFloatLowPrecision(newCelFile,t_mean);
-		WriteFloatLowPrecision(newCelFile,t_stdv);
-		WriteUInt16_I(newCelFile,t_pixel);
+	// Write the outlier data
+	std::vector<int> outlierIndices;
+	GetOutlierIndices(outlierIndices);
+	for(std::vector<int>::iterator pos = outlierIndices.begin(); pos != outlierIndices.end(); pos++)
+	{
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(*pos));
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(*pos));
 	}
+}
 
-	// Write the mask data
-	for(std::map<int, bool>::iterator pos = m_MaskedCells.begin(); pos != m_MaskedCells.end(); pos++)
+///////////////////////////////////////////////////////////////////////////////
+///  public  OpenXDABCel
+///  \brief Start writing a CEL file in xda binary format, one block of cell
+///         entries at a time
+///
+///  @return bool	true if success; false otherwise
+///////////////////////////////////////////////////////////////////////////////
+bool CCELFileWriter::OpenXDABCel()
+{
+	if (m_FileName.length() == 0)
 	{
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(pos->first));
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(pos->first));
+		SetError("No file name is set for file creation.");
+		return false;
 	}
 
-	// Write the outlier data
-	for(std::map<int, bool>::iterator pos = m_Outliers.begin(); pos != m_Outliers.end(); pos++)
+	m_XDABFile.open(m_FileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_XDABFile)
 	{
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(pos->first));
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(pos->first));
+		SetError("Unable to open the file.");
+		return false;
 	}
+	m_nXDABEntries = 0;
+	WriteXDABHeader(m_XDABFile);
+	return !m_XDABFile.fail();
+}
 
-	// Close the file and check the status.
-	newCelFile.close();
+/// The number of cell entries that are packed and written at once.
+#define XDAB_ENTRY_BLOCK_SIZE 65536
 
-	return !newCelFile.fail();
+/// The size of a cell entry of an xda binary CEL file.
+#define XDAB_ENTRY_SIZE 10
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  WriteXDABEntries
+///  \brief Write the next cell entries of a CEL file in xda binary format
+///
+///  @param  intensities const float *	The intensities, or NULL for zeros
+///  @param  stdvs const float *	The standard deviations, or NULL for zeros
+///  @param  pixels const int16_t *	The pixel counts, or NULL for zeros
+///  @param  count int	The number of cells
+///  @return bool	true if success; false otherwise
+///
+///  \remark The entries are packed in blocks, which are written at once.
+///////////////////////////////////////////////////////////////////////////////
+bool CCELFileWriter::WriteXDABEntries(const float *intensities, const float *stdvs, const int16_t *pixels, int count)
+{
+	if (!m_XDABFile.is_open())
+	{
+		SetError("The file is not open for writing.");
+		return false;
+	}
+	if (count > m_HeaderData.GetCells() - m_nXDABEntries)
+	{
+		SetError("More cell entries than cells in the array.");
+		return false;
+	}
+
+	m_XDABBuffer.resize(XDAB_ENTRY_BLOCK_SIZE*XDAB_ENTRY_SIZE);
+	for (int start=0; start<count; start+=XDAB_ENTRY_BLOCK_SIZE)
+	{
+		int n = (count - start < XDAB_ENTRY_BLOCK_SIZE ? count - start : XDAB_ENTRY_BLOCK_SIZE);
+		char *p = &m_XDABBuffer[0];
+		for (int i=start; i<start+n; i++)
+		{
+			float mean = (intensities == NULL ? 0.0f : intensities[i]);
+			float stdv = (stdvs == NULL ? 0.0f : stdvs[i]);
+			uint32_t x;
+			uint16_t pixel = (uint16_t) (pixels == NULL ? 0 : pixels[i]);
+			memcpy(&x, &mean, sizeof(x));
+			x = htoil(x);
+			memcpy(p, &x, sizeof(x));
+			memcpy(&x, &stdv, sizeof(x));
+			x = htoil(x);
+			memcpy(p + 4, &x, sizeof(x));
+			pixel = htois(pixel);
+			memcpy(p + 8, &pixel, sizeof(pixel));
+			p += XDAB_ENTRY_SIZE;
+		}
+		m_XDABFile.write(&m_XDABBuffer[0], (std::streamsize)n*XDAB_ENTRY_SIZE);
+	}
+	m_nXDABEntries += count;
+	return !m_XDABFile.fail();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///  public  CloseXDABCel
+///  \brief Complete and close a CEL file in xda binary format
+///
+///  @return bool	true if success and all cell entries were written; false otherwise
+///
+///  \remark A file that could not be completed is removed.
+///////////////////////////////////////////////////////////////////////////////
+bool CCELFileWriter::CloseXDABCel()
+{
+	if (!m_XDABFile.is_open())
+	{
+		SetError("The file is not open for writing.");
+		return false;
+	}
+
+	bool complete = (m_nXDABEntries == m_HeaderData.GetCells());
+	if (complete)
+		WriteXDABMaskedAndOutliers(m_XDABFile);
+	m_XDABFile.close();
+	m_XDABBuffer.clear();
+	if (m_XDABFile.fail())
+	{
+		SetError("Unable to write the file.");
+		remove(m_FileName.c_str());
+		return false;
+	}
+	if (!complete)
+	{
+		SetError("Not all cell entries were written.");
+		remove(m_FileName.c_str());
+		return false;
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -462,20 +609,24 @@ bool CCELFileWriter::WriteTranscriptomeBCel()
 	// Write the mask data
 	WriteUInt32_N(newCelFile,(uint32_t)(m_HeaderData.GetMasked() * STRUCT_SIZE_XY_PAIR));
 	WriteFixedString(newCelFile, BCEL_CHUNK_MASK, BCEL_CHUNK_NAME_SIZE);
-	for(std::map<int, bool>::iterator pos = m_MaskedCells.begin(); pos != m_MaskedCells.end(); pos++)
+	std::vector<int> maskedIndices;
+	GetMaskedIndices(maskedIndices);
+	for(std::vector<int>::iterator pos = maskedIndices.begin(); pos != maskedIndices.end(); pos++)
 	{
-		WriteUInt32_N(newCelFile, (uint32_t) IndexToX(pos->first));
-		WriteUInt32_N(newCelFile, (uint32_t) IndexToY(pos->first));
+		WriteUInt32_N(newCelFile, (uint32_t) IndexToX(*pos));
+		WriteUInt32_N(newCelFile, (uint32_t) IndexToY(*pos));
 	}
 	WriteUInt32_N(newCelFile, 0);
 
 	// Write the outlier data
 	WriteUInt32_N(newCelFile, (uint32_t) (m_HeaderData.GetOutliers() * STRUCT_SIZE_XY_PAIR));
 	WriteFixedString(newCelFile, BCEL_CHUNK_OUTL, BCEL_CHUNK_NAME_SIZE);
-	for(std::map<int, bool>::iterator pos = m_Outliers.begin(); pos != m_Outliers.end(); pos++)
+	std::vector<int> outlierIndices;
+	GetOutlierIndices(outlierIndices);
+	for(std::vector<int>::iterator pos = outlierIndices.begin(); pos != outlierIndices.end(); pos++)
 	{
-		WriteUInt32_N(newCelFile, (uint32_t) IndexToX(pos->first));
-		WriteUInt32_N(newCelFile, (uint32_t) IndexToY(pos->first));
+		WriteUInt32_N(newCelFile, (uint32_t) IndexToX(*pos));
+		WriteUInt32_N(newCelFile, (uint32_t) IndexToY(*pos));
 	}
 	WriteUInt32_N(newCelFile, 0);
 
@@ -544,10 +695,12 @@ bool CCELFileWriter::WriteCompactBCel()
 	}
 
 	// Write the mask data
-	for(std::map<int, bool>::iterator pos = m_MaskedCells.begin(); pos != m_MaskedCells.end(); pos++)
+	std::vector<int> maskedIndices;
+	GetMaskedIndices(maskedIndices);
+	for(std::vector<int>::iterator pos = maskedIndices.begin(); pos != maskedIndices.end(); pos++)
 	{
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(pos->first));
-		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(pos->first));
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToX(*pos));
+		WriteUInt16_I(newCelFile, (uint16_t) IndexToY(*pos));
 	}
 
 	// Close the file and check the status.
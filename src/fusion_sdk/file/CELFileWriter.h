@@ -25,6 +25,9 @@
 
 #include "file/CELFileData.h"
 //
+#include <fstream>
+#include <vector>
+//
 
 namespace affxcel
 {
@@ -84,6 +87,30 @@ public:
 	 */
 	bool WriteXDABCel();
 
+	/*! Starts writing an XDA binary CEL file by writing its header. The cell
+	 * entries are then written in order by WriteXDABEntries() and the file
+	 * is completed by CloseXDABCel(). Unlike WriteXDABCel(), the entries are
+	 * not held in memory and the values are stored at full precision.
+	 * @return True if successful
+	 */
+	bool OpenXDABCel();
+
+	/*! Writes the next cell entries of an XDA binary CEL file.
+	 * @param intensities The intensities, or NULL for zeros.
+	 * @param stdvs The standard deviations, or NULL for zeros.
+	 * @param pixels The pixel counts, or NULL for zeros.
+	 * @param count The number of cells.
+	 * @return True if successful
+	 */
+	bool WriteXDABEntries(const float *intensities, const float *stdvs, const int16_t *pixels, int count);
+
+	/*! Completes an XDA binary CEL file by writing the masked and outlier
+	 * cells, and closes it. If not all cell entries were written, or the file
+	 * could not be written, the file is removed.
+	 * @return True if successful and all cell entries were written.
+	 */
+	bool CloseXDABCel();
+
 	/*! Writes a transcriptome binary CEL file.
 	 * @return True if successful
 	 */
@@ -93,6 +120,22 @@ public:
 	 * @return True if successful
 	 */
 	bool WriteCompactBCel();
+
+private:
+	/*! Writes the header of an XDA binary CEL file. */
+	void WriteXDABHeader(std::ofstream &newCelFile);
+
+	/*! Writes the masked and outlier cells of an XDA binary CEL file. */
+	void WriteXDABMaskedAndOutliers(std::ofstream &newCelFile);
+
+	/*! The XDA binary CEL file that is written by WriteXDABEntries(). */
+	std::ofstream m_XDABFile;
+
+	/*! The number of cell entries written to the XDA binary CEL file. */
+	int m_nXDABEntries;
+
+	/*! The buffer of a block of cell entries. */
+	std::vector<char> m_XDABBuffer;
 };
 
 //////////////////////////////////////////////////////////////////////
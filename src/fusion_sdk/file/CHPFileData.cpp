@@ -251,22 +251,18 @@ void CCHPFileData::Clear()
 	m_Header.Clear();
 	m_FileName = "";
 	m_strError = "";
-	int n = (int) m_ProbeSetResults.size();
-	for (int i=0; i<n; i++)
-	{
-		delete m_ProbeSetResults[i];
-		m_ProbeSetResults[i]=NULL;
-	}
-	m_ProbeSetResults.erase(m_ProbeSetResults.begin(), m_ProbeSetResults.end());
+	std::vector<CExpressionProbeSetResults>().swap(m_ExpressionResults);
+	std::vector<CGenotypeProbeSetResults>().swap(m_GenotypingResults);
+	std::vector<CUniversalProbeSetResults>().swap(m_UniversalResults);
 }
 
 //////////////////////////////////////////////////////////////////////
 
 CExpressionProbeSetResults *CCHPFileData::GetExpressionResults(int index)
 {
-	if (index < m_Header.GetNumProbeSets() && m_Header.GetAssayType() == CCHPFileHeader::Expression)
+	if (index >= 0 && index < (int) m_ExpressionResults.size() && m_Header.GetAssayType() == CCHPFileHeader::Expression)
 	{
-		return (CExpressionProbeSetResults *) m_ProbeSetResults[index];
+		return &m_ExpressionResults[index];
 	}
 	return NULL;
 }
@@ -275,9 +271,9 @@ CExpressionProbeSetResults *CCHPFileData::GetExpressionResults(int index)
 
 CGenotypeProbeSetResults *CCHPFileData::GetGenotypingResults(int index)
 {
-	if (index < m_Header.GetNumProbeSets() && m_Header.GetAssayType() == CCHPFileHeader::Genotyping)
+	if (index >= 0 && index < (int) m_GenotypingResults.size() && m_Header.GetAssayType() == CCHPFileHeader::Genotyping)
 	{
-		return (CGenotypeProbeSetResults *) m_ProbeSetResults[index];
+		return &m_GenotypingResults[index];
 	}
 	return NULL;
 }
@@ -293,16 +289,16 @@ CResequencingResults *CCHPFileData::GetResequencingResults()
 
 CUniversalProbeSetResults *CCHPFileData::GetUniversalResults(int index)
 {
-	if (index < m_Header.GetNumProbeSets() && m_Header.GetAssayType() == CCHPFileHeader::Universal)
+	if (index >= 0 && index < (int) m_UniversalResults.size() && m_Header.GetAssayType() == CCHPFileHeader::Universal)
 	{
-		return (CUniversalProbeSetResults *) m_ProbeSetResults[index];
+		return &m_UniversalResults[index];
 	}
 	return NULL;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-CUniversalProbeSetResults CUniversalProbeSetResults::operator = (CUniversalProbeSetResults &src)
+CUniversalProbeSetResults CUniversalProbeSetResults::operator = (const CUniversalProbeSetResults &src)
 {
 	SetBackground(src.GetBackground());
 	return *this;
@@ -334,7 +330,7 @@ std::string CGenotypeProbeSetResults::GetAlleleCallString()
 
 //////////////////////////////////////////////////////////////////////
 
-CGenotypeProbeSetResults CGenotypeProbeSetResults::operator = (CGenotypeProbeSetResults &src)
+CGenotypeProbeSetResults CGenotypeProbeSetResults::operator = (const CGenotypeProbeSetResults &src)
 {
 	AlleleCall = src.AlleleCall;
 	Confidence = src.Confidence;
@@ -415,7 +411,7 @@ std::string CExpressionProbeSetResults::GetChangeString()
 
 //////////////////////////////////////////////////////////////////////
 
-CExpressionProbeSetResults CExpressionProbeSetResults::operator = (CExpressionProbeSetResults &src)
+CExpressionProbeSetResults CExpressionProbeSetResults::operator = (const CExpressionProbeSetResults &src)
 {
 	DetectionPValue = src.DetectionPValue;
 	Signal = src.Signal; 
@@ -635,7 +631,7 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		// Read the probe set data
 		if (m_Header.m_AssayType == CCHPFileHeader::Expression)
 		{
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_ExpressionResults.resize(m_Header.m_NumProbeSets);
 			// Get the type of analysis
 			ReadUInt8(instr, ucval); // EXPRESSION_ABSOLUTE_STAT_ANALYSIS or EXPRESSION_COMPARISON_STAT_ANALYSIS
 			ReadInt32_I(instr, ival);
@@ -650,8 +646,7 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 			// Read each probe set result.
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CExpressionProbeSetResults * pResults = new CExpressionProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CExpressionProbeSetResults * pResults = &m_ExpressionResults[iset];
 
 				// Read the absolute data.
 				ReadUInt8(instr, ucval);
@@ -699,14 +694,13 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		}
 		else if (m_Header.m_AssayType == CCHPFileHeader::Genotyping)
 		{
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_GenotypingResults.resize(m_Header.m_NumProbeSets);
 			const int DM_ALG_RESULT_SIZE = 21;
 			int32_t dataSize=0;
 			ReadInt32_I(instr, dataSize);
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CGenotypeProbeSetResults * pResults = new CGenotypeProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CGenotypeProbeSetResults * pResults = &m_GenotypingResults[iset];
 
 				// Read probe set result.
 				ReadUInt8(instr, ucval);
@@ -735,14 +729,13 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		}
 		else if (m_Header.m_AssayType == CCHPFileHeader::Universal)
 		{
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_UniversalResults.resize(m_Header.m_NumProbeSets);
 			int32_t dataSize=0;
 			float bg;
 			ReadInt32_I(instr, dataSize);
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CUniversalProbeSetResults * pResults = new CUniversalProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CUniversalProbeSetResults * pResults = &m_UniversalResults[iset];
 
 				// Read probe set result.
 				ReadFloat_I(instr, bg);
@@ -756,7 +749,6 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 			int8_t call;
 			int32_t pos;
 			uint8_t reason;
-			float  score;
 			int index;
 
 			// Read the data size
@@ -772,10 +764,12 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 				ReadInt8(instr, call);
 				m_ReseqResults.SetCalledBase(index, (char)call);
 			}
-			for (index=0; index<dataSize; index++)
+			if (dataSize > 0)
 			{
-				ReadFloat_I(instr, score);
-				m_ReseqResults.SetScore(index, score);
+				std::vector<float> scores(dataSize);
+				ReadFloatArray_I(instr, &scores[0], dataSize);
+				for (index=0; index<dataSize; index++)
+					m_ReseqResults.SetScore(index, scores[index]);
 			}
 
 			// Read the force and original calls.
@@ -973,11 +967,10 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		if (m_Header.m_AssayType == CCHPFileHeader::Expression)
 		{
 			// Read each probe set result.
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_ExpressionResults.resize(m_Header.m_NumProbeSets);
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CExpressionProbeSetResults * pResults = new CExpressionProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CExpressionProbeSetResults * pResults = &m_ExpressionResults[iset];
 
 				ReadInt32_I(instr, ival);
 				pResults->NumPairs = ival;
@@ -1106,11 +1099,10 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		}
 		else if (m_Header.m_AssayType == CCHPFileHeader::Genotyping)
 		{
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_GenotypingResults.resize(m_Header.m_NumProbeSets);
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CGenotypeProbeSetResults * pResults = new CGenotypeProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CGenotypeProbeSetResults * pResults = &m_GenotypingResults[iset];
 
 				// Unused data
 				int ngroups=0;
@@ -1228,7 +1220,7 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 		}
 		else if (m_Header.m_AssayType == CCHPFileHeader::Universal)
 		{
-			m_ProbeSetResults.resize(m_Header.m_NumProbeSets);
+			m_UniversalResults.resize(m_Header.m_NumProbeSets);
 			int32_t unused_32;
 			uint16_t unused_u16;
 			int8_t unused_8;
@@ -1239,8 +1231,7 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 			// Read each probe set result.
 			for (int iset=0; iset<m_Header.m_NumProbeSets; iset++)
 			{
-				CUniversalProbeSetResults * pResults = new CUniversalProbeSetResults;
-				m_ProbeSetResults[iset] = pResults;
+				CUniversalProbeSetResults * pResults = &m_UniversalResults[iset];
 
 				// unused (wildtype) length(int), string(len)
 				int ibase;
@@ -1301,7 +1292,6 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 			int32_t i32;
 			int8_t i8;
 			int16_t i16;
-			float  score;
 			int index;
 			std::string str;
 
@@ -1343,10 +1333,12 @@ bool CCHPFileData::Open(bool bReadHeaderOnly)
 					ReadFixedString(instr, str, i32);
 			}
 
-			for (index=0; index<dataSize; index++)
+			if (dataSize > 0)
 			{
-				ReadFloat_I(instr, score);
-				m_ReseqResults.SetScore(index, score);
+				std::vector<float> scores(dataSize);
+				ReadFloatArray_I(instr, &scores[0], dataSize);
+				for (index=0; index<dataSize; index++)
+					m_ReseqResults.SetScore(index, scores[index]);
 			}
 		}
 		retVal = true;
@@ -405,10 +405,10 @@ public:
 	 * @param src The object to copy
 	 * @return The copied object
 	 */
-	CExpressionProbeSetResults operator=(CExpressionProbeSetResults &src);
+	CExpressionProbeSetResults operator=(const CExpressionProbeSetResults &src);
 
 	/*! Constructor */
-	CExpressionProbeSetResults() { m_HasCompResults = false; }
+	CExpressionProbeSetResults() { m_HasCompResults = false; ChangePValue=SignalLogRatio=SignalLogRatioLow=SignalLogRatioHigh=0; NumCommonPairs=0; Change=0; }
 
 	/*! Destructor */
 	~CExpressionProbeSetResults() {}
@@ -465,7 +465,7 @@ public:
 	 * @param src The object to copy
 	 * @return The copied object
 	 */
-	CGenotypeProbeSetResults operator=(CGenotypeProbeSetResults &src);
+	CGenotypeProbeSetResults operator=(const CGenotypeProbeSetResults &src);
 
 	/*! Constructor */
 	CGenotypeProbeSetResults() {Confidence=RAS1=RAS2=pvalue_AA=pvalue_AB=pvalue_BB=pvalue_NoCall=0;}
@@ -498,7 +498,7 @@ public:
 	 * @param src The object to copy
 	 * @return The copied object
 	 */
-	CUniversalProbeSetResults operator=(CUniversalProbeSetResults &src);
+	CUniversalProbeSetResults operator=(const CUniversalProbeSetResults &src);
 
 	/*! Constructor */
 	CUniversalProbeSetResults() { background=0; }
@@ -715,8 +715,14 @@ protected:
 	/*! A string to hold an error message associated with a read operation */
 	std::string m_strError;
 
-	/*! The vector of probe set results */
-	std::vector<CProbeSetResults *> m_ProbeSetResults;
+	/*! The expression probe set results, stored contiguously. */
+	std::vector<CExpressionProbeSetResults> m_ExpressionResults;
+
+	/*! The genotyping probe set results, stored contiguously. */
+	std::vector<CGenotypeProbeSetResults> m_GenotypingResults;
+
+	/*! The universal (tag array) probe set results, stored contiguously. */
+	std::vector<CUniversalProbeSetResults> m_UniversalResults;
 
 	/*! The resequencing results. */
 	CResequencingResults m_ReseqResults;
@@ -751,6 +757,58 @@ public:
 	 */
 	CUniversalProbeSetResults *GetUniversalResults(int index);
 
+	/*! Copies a member of the expression probe set results to an array, e.g.
+	 * GetExpressionColumn(&CExpressionProbeSetResults::Signal, 0, n, values).
+	 * @param column The member of CExpressionProbeSetResults to copy.
+	 * @param start The index of the first probe set.
+	 * @param count The number of probe sets.
+	 * @param values The array to copy the values to.
+	 * @return False if not an expression file or the probe sets are out of range.
+	 */
+	template <typename T, typename U>
+	bool GetExpressionColumn(T CExpressionProbeSetResults::*column, int start, int count, U *values) const
+	{
+		if (start < 0 || count < 0 || start + count > (int) m_ExpressionResults.size())
+			return false;
+		for (int i=0; i<count; i++)
+			values[i] = (U) (m_ExpressionResults[start+i].*column);
+		return true;
+	}
+
+	/*! Copies a member of the genotyping probe set results to an array, e.g.
+	 * GetGenotypingColumn(&CGenotypeProbeSetResults::Confidence, 0, n, values).
+	 * @param column The member of CGenotypeProbeSetResults to copy.
+	 * @param start The index of the first probe set.
+	 * @param count The number of probe sets.
+	 * @param values The array to copy the values to.
+	 * @return False if not a genotyping file or the probe sets are out of range.
+	 */
+	template <typename T, typename U>
+	bool GetGenotypingColumn(T CGenotypeProbeSetResults::*column, int start, int count, U *values) const
+	{
+		if (start < 0 || count < 0 || start + count > (int) m_GenotypingResults.size())
+			return false;
+		for (int i=0; i<count; i++)
+			values[i] = (U) (m_GenotypingResults[start+i].*column);
+		return true;
+	}
+
+	/*! Copies the background values of the universal (tag array) probe set results to an array.
+	 * @param start The index of the first probe set.
+	 * @param count The number of probe sets.
+	 * @param values The array to copy the values to.
+	 * @return False if not a universal file or the probe sets are out of range.
+	 */
+	template <typename U>
+	bool GetUniversalBackgrounds(int start, int count, U *values) const
+	{
+		if (start < 0 || count < 0 || start + count > (int) m_UniversalResults.size())
+			return false;
+		for (int i=0; i<count; i++)
+			values[i] = (U) m_UniversalResults[start+i].GetBackground();
+		return true;
+	}
+
 	/*! Returns the resequencing results.
 	 * @return The resequencing results.
 	 */
@@ -130,32 +130,27 @@ void CCHPFileWriter::InitializeForWriting(int numRows, int numCols, int numProbe
 		return;
 
 	// Allocate memory for probe set results
-	m_ProbeSetResults.clear();
+	m_ExpressionResults.clear();
+	m_GenotypingResults.clear();
+	m_UniversalResults.clear();
 	if (allocateMemory == true)
 	{
-		m_ProbeSetResults.resize(numProbeSets);
-		CProbeSetResults *pResults;
-		for (int iset=0; iset<numProbeSets; iset++)
+		switch (probeSetType)
 		{
-			switch (probeSetType)
-			{
-				case affxcdf::ExpressionProbeSetType:
-					pResults = new CExpressionProbeSetResults;
-					break;
-
-				case affxcdf::GenotypingProbeSetType:
-					pResults = new CGenotypeProbeSetResults;
-					break;
-
-				case affxcdf::TagProbeSetType:
-					pResults = new CUniversalProbeSetResults;
-					break;
-
-				default:
-					pResults = NULL;
-					break;
-			}
-			m_ProbeSetResults[iset] = pResults;
+			case affxcdf::ExpressionProbeSetType:
+				m_ExpressionResults.resize(numProbeSets);
+				break;
+
+			case affxcdf::GenotypingProbeSetType:
+				m_GenotypingResults.resize(numProbeSets);
+				break;
+
+			case affxcdf::TagProbeSetType:
+				m_UniversalResults.resize(numProbeSets);
+				break;
+
+			default:
+				break;
 		}
 	}
 }
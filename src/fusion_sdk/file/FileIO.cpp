@@ -59,8 +59,201 @@
 #define AFFY_UNALIGNED_IN_SW
 #endif
 
+// Vector instructions for shuffling arrays.  On x86 the kernels are
+// compiled for their instruction set and picked at run time.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AFFY_SWAP_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__ARM_NEON))
+#define AFFY_SWAP_NEON
+#include <arm_neon.h>
+#endif
+
 using namespace std;
 
+//====================
+//
+// Array shuffling
+//
+
+typedef void (*affy_swap_array_fn)(void* dst, const void* src, size_t count);
+
+static void
+affy_swap32_array_scalar(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  uint32_t v;
+  for (size_t i=0; i<count; i++) {
+    memcpy(&v,s+i*sizeof(v),sizeof(v));
+    v=affy_swap32(v);
+    memcpy(d+i*sizeof(v),&v,sizeof(v));
+  }
+}
+
+static void
+affy_swap16_array_scalar(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  uint16_t v;
+  for (size_t i=0; i<count; i++) {
+    memcpy(&v,s+i*sizeof(v),sizeof(v));
+    v=affy_swap16(v);
+    memcpy(d+i*sizeof(v),&v,sizeof(v));
+  }
+}
+
+#ifdef AFFY_SWAP_X86
+
+__attribute__((target("sse2"))) static void
+affy_swap32_array_sse2(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  size_t i=0;
+  for (; i+4<=count; i+=4) {
+    __m128i v=_mm_loadu_si128((const __m128i*)(s+i*4));
+    // swap the bytes of each 16 bit half, then the halves
+    v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));
+    v=_mm_shufflehi_epi16(_mm_shufflelo_epi16(v,0xB1),0xB1);
+    _mm_storeu_si128((__m128i*)(d+i*4),v);
+  }
+  affy_swap32_array_scalar(d+i*4,s+i*4,count-i);
+}
+
+__attribute__((target("sse2"))) static void
+affy_swap16_array_sse2(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  size_t i=0;
+  for (; i+8<=count; i+=8) {
+    __m128i v=_mm_loadu_si128((const __m128i*)(s+i*2));
+    v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));
+    _mm_storeu_si128((__m128i*)(d+i*2),v);
+  }
+  affy_swap16_array_scalar(d+i*2,s+i*2,count-i);
+}
+
+__attribute__((target("avx2"))) static void
+affy_swap32_array_avx2(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  const __m256i shuffle=_mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                                         3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+  size_t i=0;
+  for (; i+8<=count; i+=8) {
+    __m256i v=_mm256_loadu_si256((const __m256i*)(s+i*4));
+    _mm256_storeu_si256((__m256i*)(d+i*4),_mm256_shuffle_epi8(v,shuffle));
+  }
+  affy_swap32_array_scalar(d+i*4,s+i*4,count-i);
+}
+
+__attribute__((target("avx2"))) static void
+affy_swap16_array_avx2(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  const __m256i shuffle=_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                         1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  size_t i=0;
+  for (; i+16<=count; i+=16) {
+    __m256i v=_mm256_loadu_si256((const __m256i*)(s+i*2));
+    _mm256_storeu_si256((__m256i*)(d+i*2),_mm256_shuffle_epi8(v,shuffle));
+  }
+  affy_swap16_array_scalar(d+i*2,s+i*2,count-i);
+}
+
+#endif
+
+#ifdef AFFY_SWAP_NEON
+
+static void
+affy_swap32_array_neon(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  size_t i=0;
+  for (; i+4<=count; i+=4) {
+    vst1q_u8((uint8_t*)(d+i*4),vrev32q_u8(vld1q_u8((const uint8_t*)(s+i*4))));
+  }
+  affy_swap32_array_scalar(d+i*4,s+i*4,count-i);
+}
+
+static void
+affy_swap16_array_neon(void* dst, const void* src, size_t count)
+{
+  const char* s=(const char*)src;
+  char* d=(char*)dst;
+  size_t i=0;
+  for (; i+8<=count; i+=8) {
+    vst1q_u8((uint8_t*)(d+i*2),vrev16q_u8(vld1q_u8((const uint8_t*)(s+i*2))));
+  }
+  affy_swap16_array_scalar(d+i*2,s+i*2,count-i);
+}
+
+#endif
+
+// Pick the fastest kernel this CPU supports.
+static affy_swap_array_fn
+affy_select_swap32_array()
+{
+#if defined(AFFY_SWAP_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return affy_swap32_array_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return affy_swap32_array_sse2;
+#elif defined(AFFY_SWAP_NEON)
+  return affy_swap32_array_neon;
+#endif
+  return affy_swap32_array_scalar;
+}
+
+static affy_swap_array_fn
+affy_select_swap16_array()
+{
+#if defined(AFFY_SWAP_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return affy_swap16_array_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return affy_swap16_array_sse2;
+#elif defined(AFFY_SWAP_NEON)
+  return affy_swap16_array_neon;
+#endif
+  return affy_swap16_array_scalar;
+}
+
+void
+affy_swap32_array(void* dst, const void* src, size_t count)
+{
+  static const affy_swap_array_fn fn=affy_select_swap32_array();
+  fn(dst,src,count);
+}
+
+void
+affy_swap16_array(void* dst, const void* src, size_t count)
+{
+  static const affy_swap_array_fn fn=affy_select_swap16_array();
+  fn(dst,src,count);
+}
+
+// Read count values of the given size; values which could not be read are zero,
+// as with the single value functions.
+static void
+ReadArray(IFSTREAM& instr, void* vals, uint32_t count, size_t size)
+{
+  size_t len=count*size;
+  instr.read((char*)vals,len);
+  size_t got=(size_t)instr.gcount();
+  if (got<len) {
+    memset((char*)vals+got,0,len-got);
+  }
+}
+
 void
 ReadUInt32_I(IFSTREAM& instr, uint32_t& val) 
 {
@@ -92,6 +285,39 @@ ReadInt16_I(IFSTREAM& instr,int16_t& val)
   ReadUInt16_I(instr,(uint16_t&)val);
 }
 
+void
+ReadUInt32Array_I(IFSTREAM& instr, uint32_t* vals, uint32_t count)
+{
+  ReadArray(instr,vals,count,sizeof(uint32_t));
+#if BYTE_ORDER == BIG_ENDIAN
+  affy_swap32_array(vals,vals,count);
+#endif
+}
+void
+ReadInt32Array_I(IFSTREAM& instr, int32_t* vals, uint32_t count)
+{
+  ReadUInt32Array_I(instr,(uint32_t*)vals,count);
+}
+void
+ReadFloatArray_I(IFSTREAM& instr, float* vals, uint32_t count)
+{
+  ReadUInt32Array_I(instr,(uint32_t*)vals,count);
+}
+//
+void
+ReadUInt16Array_I(IFSTREAM& instr, uint16_t* vals, uint32_t count)
+{
+  ReadArray(instr,vals,count,sizeof(uint16_t));
+#if BYTE_ORDER == BIG_ENDIAN
+  affy_swap16_array(vals,vals,count);
+#endif
+}
+void
+ReadInt16Array_I(IFSTREAM& instr, int16_t* vals, uint32_t count)
+{
+  ReadUInt16Array_I(instr,(uint16_t*)vals,count);
+}
+
 // No byte swapping needed.
 void
 ReadUInt8(IFSTREAM& instr, uint8_t& val) 
@@ -140,6 +366,39 @@ ReadInt16_N(IFSTREAM& instr, int16_t& val)
   ReadUInt16_N(instr,(uint16_t&)val);
 }
 
+void
+ReadUInt32Array_N(IFSTREAM& instr, uint32_t* vals, uint32_t count)
+{
+  ReadArray(instr,vals,count,sizeof(uint32_t));
+#if BYTE_ORDER == LITTLE_ENDIAN
+  affy_swap32_array(vals,vals,count);
+#endif
+}
+void
+ReadInt32Array_N(IFSTREAM& instr, int32_t* vals, uint32_t count)
+{
+  ReadUInt32Array_N(instr,(uint32_t*)vals,count);
+}
+void
+ReadFloatArray_N(IFSTREAM& instr, float* vals, uint32_t count)
+{
+  ReadUInt32Array_N(instr,(uint32_t*)vals,count);
+}
+//
+void
+ReadUInt16Array_N(IFSTREAM& instr, uint16_t* vals, uint32_t count)
+{
+  ReadArray(instr,vals,count,sizeof(uint16_t));
+#if BYTE_ORDER == LITTLE_ENDIAN
+  affy_swap16_array(vals,vals,count);
+#endif
+}
+void
+ReadInt16Array_N(IFSTREAM& instr, int16_t* vals, uint32_t count)
+{
+  ReadUInt16Array_N(instr,(uint16_t*)vals,count);
+}
+
 // When the old BPMAP files were written, the output 
 // values were mangled in this way:
 // * Start with a float value.
@@ -67,6 +67,22 @@ affy_swap16(uint16_t x) {
   return ((((x) >> 8) & 0xff) | (((x) & 0xff) << 8));
 }
 
+/*! Shuffles an array of 32 bit values.
+ * Uses SSE2, AVX2 or NEON instructions when the CPU supports them.
+ * @param dst The destination array, which may be the same as src
+ * @param src The source array
+ * @param count The number of values
+ */
+void affy_swap32_array(void* dst, const void* src, size_t count);
+
+/*! Shuffles an array of 16 bit values.
+ * Uses SSE2, AVX2 or NEON instructions when the CPU supports them.
+ * @param dst The destination array, which may be the same as src
+ * @param src The source array
+ * @param count The number of values
+ */
+void affy_swap16_array(void* dst, const void* src, size_t count);
+
 // Do we need to define our "to little-endian" operators?
 #if BYTE_ORDER == BIG_ENDIAN
 
@@ -133,6 +149,41 @@ void ReadUInt16_I(IFSTREAM& instr, uint16_t& val);
  */
 void ReadInt16_I(IFSTREAM& instr, int16_t& val);
 
+/*! Reads an array of unsigned 32 bit integers from a little endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadUInt32Array_I(IFSTREAM& instr, uint32_t* vals, uint32_t count);
+
+/*! Reads an array of signed 32 bit integers from a little endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadInt32Array_I(IFSTREAM& instr, int32_t* vals, uint32_t count);
+
+/*! Reads an array of floats from a little endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadFloatArray_I(IFSTREAM& instr, float* vals, uint32_t count);
+
+/*! Reads an array of unsigned 16 bit integers from a little endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadUInt16Array_I(IFSTREAM& instr, uint16_t* vals, uint32_t count);
+
+/*! Reads an array of signed 16 bit integers from a little endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadInt16Array_I(IFSTREAM& instr, int16_t* vals, uint32_t count);
+
 /*! Reads a string from a little endian file
  * @param instr The input file stream
  * @param str The returned value
@@ -194,6 +245,41 @@ void ReadUInt16_N(IFSTREAM& instr, uint16_t& val);
  */
 void ReadInt16_N(IFSTREAM& instr, int16_t& val);
 
+/*! Reads an array of unsigned 32 bit integers from a big endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadUInt32Array_N(IFSTREAM& instr, uint32_t* vals, uint32_t count);
+
+/*! Reads an array of signed 32 bit integers from a big endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadInt32Array_N(IFSTREAM& instr, int32_t* vals, uint32_t count);
+
+/*! Reads an array of floats from a big endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadFloatArray_N(IFSTREAM& instr, float* vals, uint32_t count);
+
+/*! Reads an array of unsigned 16 bit integers from a big endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadUInt16Array_N(IFSTREAM& instr, uint16_t* vals, uint32_t count);
+
+/*! Reads an array of signed 16 bit integers from a big endian file
+ * @param instr The input file stream
+ * @param vals The returned values
+ * @param count The number of values to read
+ */
+void ReadInt16Array_N(IFSTREAM& instr, int16_t* vals, uint32_t count);
+
 /*! Reads a string from a big endian file
  * @param instr The input file stream
  * @param str The returned value